@@ -0,0 +1,818 @@
+/**
+ * Host benchmark of crypto_func and crypto_func_decrypt.
+ *
+ * Built once against present_ref and once against present_bs, so the blocks per call follow BITSLICE_WIDTH when it is
+ * defined by crypto.h.
+ *
+ * Usage: bench_ref|bench_bs [calls]
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "platform.h"
+#include "instrument.h"
+
+#include "crypto.h"
+
+#ifdef PRESENT_BS_FIXED_KEY
+#include "present_bs_fixed_key.h"
+#endif
+
+#ifdef BITSLICE_WIDTH
+#define BENCH_BLOCKS BITSLICE_WIDTH
+#else
+#define BENCH_BLOCKS 1
+#endif
+
+#define BENCH_DEFAULT_CALLS 10000
+
+// Batches per call when comparing the split of one batch with whole batches per core.
+#define BENCH_BATCHES 16
+
+// Message length of the CMAC benchmark, two blocks.
+#define BENCH_CMAC_LEN 16
+
+// Fragment length of the scatter-gather benchmark, not a multiple of the block size.
+#define BENCH_FRAGMENT 13
+
+// Unknown key bits of the key search benchmark, and the rounds of its reduced-round part.
+#define BENCH_KEYSEARCH_BITS 20
+#define BENCH_KEYSEARCH_ROUNDS 5
+
+// Testvector 0: all-zero key and plaintext.
+static const uint8_t tv_ct[CRYPTO_OUT_SIZE] = {0x45, 0x84, 0x22, 0x7B, 0x38, 0xC1, 0x79, 0x55};
+// Same with PRESENT-128
+static const uint8_t tv_ct_128[CRYPTO_OUT_SIZE] = {0xAF, 0x00, 0x69, 0x2E, 0x2A, 0x70, 0xDB, 0x96};
+
+static uint8_t pt[CRYPTO_IN_SIZE * BENCH_BLOCKS];
+static uint8_t key[CRYPTO_KEY_SIZE];
+static uint8_t key_128[CRYPTO_KEY_SIZE_128];
+
+#ifdef BITSLICE_WIDTH
+// Blocks of the counter mode check, three batches and a few more.
+#define BENCH_CTR_BLOCKS (3 * BITSLICE_WIDTH + 5)
+
+/**
+ * @brief Compare the keystream of present_ctr_update with present_encrypt_blocks on counter blocks built one by one.
+ *
+ * The stream is taken in chunks of the given lengths, repeated until all BENCH_CTR_BLOCKS blocks are done, so chunks
+ * end inside blocks and batches and the keystream has to go on from one call to the next.
+ *
+ * @param key key
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ * @param counter first counter block as integer
+ * @param chunks chunk lengths in bytes
+ * @param chunk_count number of chunk lengths
+ *
+ * @return whether both keystreams are the same
+ */
+static bool ctr_matches(const uint8_t *key, uint8_t key_size, uint64_t counter, const size_t *chunks, size_t chunk_count)
+{
+    static present_ctr_t ctx;
+    static present_expanded_key_t expanded;
+    static uint8_t expected[CRYPTO_IN_SIZE * BENCH_CTR_BLOCKS];
+    static uint8_t stream[CRYPTO_IN_SIZE * BENCH_CTR_BLOCKS];
+    size_t off = 0;
+
+    for (uint32_t n = 0; n < BENCH_CTR_BLOCKS; n++)
+    {
+        for (uint8_t i = 0; i < CRYPTO_IN_SIZE; i++)
+        {
+            expected[n * CRYPTO_IN_SIZE + i] = (uint8_t)((counter + n) >> (8 * i));
+        }
+    }
+
+    // Block 0 is the IV.
+    if (key_size == CRYPTO_KEY_SIZE_128)
+    {
+        present_ctr_init_128(&ctx, key, expected);
+        present_expand_key_128(&expanded, key);
+    }
+    else
+    {
+        present_ctr_init(&ctx, key, expected);
+        present_expand_key(&expanded, key);
+    }
+
+    present_encrypt_blocks(&expanded, expected, expected, BENCH_CTR_BLOCKS);
+
+    memset(stream, 0u, sizeof(stream));
+
+    for (size_t c = 0; off < sizeof(stream); c++)
+    {
+        size_t len = chunks[c % chunk_count];
+
+        if (len > sizeof(stream) - off)
+        {
+            len = sizeof(stream) - off;
+        }
+
+        present_ctr_update(&ctx, stream + off, len);
+        off += len;
+    }
+
+    return memcmp(stream, expected, sizeof(stream)) == 0;
+}
+
+// Message lengths of the CMAC check, empty, partial, whole and longer blocks next to each other in one batch.
+static const size_t cmac_check_lens[] = {0, 7, 8, 9, 16, 1, 24, 33};
+#define BENCH_CMAC_MAX_LEN 33
+
+// Messages of the CMAC check, more than a batch so present_cmac splits them.
+#define BENCH_CMAC_MESSAGES (BITSLICE_WIDTH + 3)
+
+/**
+ * @brief CMAC of one message with present_encrypt_block, block after block.
+ *
+ * The subkeys are doubled byte by byte, as the little-endian 64-bit integers of present_cmac_t, and the last block
+ * is padded with 0x80 after its last byte, so nothing is shared with the lanes of present_cmac but the expanded key.
+ *
+ * @param expanded expanded key
+ * @param msg message
+ * @param len length of message in bytes
+ * @param tag Output: tag
+ */
+static void cmac_reference(const present_expanded_key_t *expanded, const uint8_t *msg, size_t len,
+                           uint8_t tag[CRYPTO_OUT_SIZE])
+{
+    uint8_t subkeys[3][CRYPTO_IN_SIZE] = {{0u}};
+    size_t blocks = len == 0 ? 1 : (len + CRYPTO_IN_SIZE - 1) / CRYPTO_IN_SIZE;
+
+    // L, then k1 = 2 L and k2 = 4 L.
+    present_encrypt_block(expanded, subkeys[0]);
+
+    for (uint8_t s = 1; s < 3; s++)
+    {
+        for (uint8_t i = 0; i < CRYPTO_IN_SIZE; i++)
+        {
+            subkeys[s][i] = (uint8_t)(subkeys[s - 1][i] << 1 | (i > 0 ? subkeys[s - 1][i - 1] >> 7 : 0));
+        }
+
+        if (subkeys[s - 1][CRYPTO_IN_SIZE - 1] & 0x80)
+        {
+            subkeys[s][0] ^= 0x1B;
+        }
+    }
+
+    memset(tag, 0u, CRYPTO_OUT_SIZE);
+
+    for (size_t j = 0; j < blocks; j++)
+    {
+        size_t n = len - j * CRYPTO_IN_SIZE < CRYPTO_IN_SIZE ? len - j * CRYPTO_IN_SIZE : CRYPTO_IN_SIZE;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            tag[i] ^= msg[j * CRYPTO_IN_SIZE + i];
+        }
+
+        if (j == blocks - 1)
+        {
+            const uint8_t *subkey = subkeys[1];
+
+            if (n < CRYPTO_IN_SIZE)
+            {
+                tag[n] ^= 0x80;
+                subkey = subkeys[2];
+            }
+
+            for (uint8_t i = 0; i < CRYPTO_IN_SIZE; i++)
+            {
+                tag[i] ^= subkey[i];
+            }
+        }
+
+        present_encrypt_block(expanded, tag);
+    }
+}
+
+/**
+ * @brief Compare present_cmac on messages of mixed lengths with cmac_reference.
+ *
+ * All messages go into one call, so lanes finish in different passes and present_cmac has to mask each tag in the
+ * pass of its last block, and the last BENCH_CMAC_MESSAGES - BITSLICE_WIDTH messages make a partial second batch.
+ *
+ * @param key key
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ *
+ * @return whether all tags are the same
+ */
+static bool cmac_matches(const uint8_t *key, uint8_t key_size)
+{
+    static present_cmac_t ctx;
+    static uint8_t messages[BENCH_CMAC_MESSAGES][BENCH_CMAC_MAX_LEN];
+    static const uint8_t *msgs[BENCH_CMAC_MESSAGES];
+    static size_t lens[BENCH_CMAC_MESSAGES];
+    static uint8_t tags[CRYPTO_OUT_SIZE * BENCH_CMAC_MESSAGES];
+    uint8_t expected[CRYPTO_OUT_SIZE];
+
+    if (key_size == CRYPTO_KEY_SIZE_128)
+    {
+        present_cmac_init_128(&ctx, key);
+    }
+    else
+    {
+        present_cmac_init(&ctx, key);
+    }
+
+    for (uint32_t i = 0; i < BENCH_CMAC_MESSAGES; i++)
+    {
+        for (uint32_t b = 0; b < BENCH_CMAC_MAX_LEN; b++)
+        {
+            messages[i][b] = (uint8_t)(i * 31 + b);
+        }
+
+        msgs[i] = messages[i];
+        lens[i] = cmac_check_lens[i % (sizeof(cmac_check_lens) / sizeof(cmac_check_lens[0]))];
+    }
+
+    present_cmac(&ctx, msgs, lens, BENCH_CMAC_MESSAGES, tags);
+
+    for (uint32_t i = 0; i < BENCH_CMAC_MESSAGES; i++)
+    {
+        cmac_reference(&ctx.expanded, msgs[i], lens[i], expected);
+
+        if (memcmp(tags + i * CRYPTO_OUT_SIZE, expected, CRYPTO_OUT_SIZE) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+#endif
+
+#ifdef INSTRUMENT
+/**
+ * @brief Print the cycles per stage recorded since the last call, then start over.
+ */
+static void print_stages(void)
+{
+    printf("[+] %-16s %10s %12s %8s %8s %8s %8s\n", "stage", "count", "total", "min", "median", "p99", "max");
+
+    for (uint8_t s = 0; s < INSTRUMENT_STAGE_NUM; s++)
+    {
+        instrument_stats_t stats;
+
+        instrument_stats((instrument_stage_t)s, &stats);
+        printf("[+] %-16s %10llu %12llu %8llu %8llu %8llu %8llu\n", instrument_stage_name((instrument_stage_t)s),
+               (unsigned long long)stats.count, (unsigned long long)stats.total, (unsigned long long)stats.min,
+               (unsigned long long)stats.median, (unsigned long long)stats.p99, (unsigned long long)stats.max);
+    }
+
+    instrument_reset();
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    uint32_t calls = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_CALLS;
+    uint64_t begin, end, duration;
+
+    // Check the result once before timing anything.
+    memset(pt, 0u, sizeof(pt));
+    memset(key, 0u, sizeof(key));
+    crypto_func(pt, key);
+
+    for (uint32_t i = 0; i < BENCH_BLOCKS; i++)
+    {
+        if (memcmp(pt + i * CRYPTO_IN_SIZE, tv_ct, CRYPTO_OUT_SIZE) != 0)
+        {
+            printf("[FAILED] Wrong ciphertext in block %u\n", i);
+            return 1;
+        }
+    }
+
+#ifdef INSTRUMENT
+    instrument_reset();
+#endif
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        // crypto_func may update the key in place.
+        memset(key, 0u, sizeof(key));
+        crypto_func(pt, key);
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] %u calls x %u blocks\n", calls, BENCH_BLOCKS);
+    printf("[+] Cycle count per call = %.1f\n", (double)duration / calls);
+    printf("[+] Cycle count per block = %.1f\n", (double)duration / calls / BENCH_BLOCKS);
+
+#ifdef INSTRUMENT
+    // Stages of the encryption above, as seen by core0. The measurement itself is part of the cycle counts.
+    print_stages();
+#endif
+
+    // Decryption, with the key register after the last round prepared once like for encryption above.
+    static uint8_t dec_key[CRYPTO_KEY_SIZE];
+
+    memset(dec_key, 0u, sizeof(dec_key));
+    crypto_decryption_key(dec_key);
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        // crypto_func_decrypt may update the key in place as well.
+        memcpy(key, dec_key, sizeof(key));
+        crypto_func_decrypt(pt, key);
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] Decryption cycle count per block = %.1f\n", (double)duration / calls / BENCH_BLOCKS);
+
+    // Key schedule alone, crypto_decryption_key runs it once through all rounds.
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        crypto_decryption_key(dec_key);
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] Key schedule cycle count per round = %.1f\n", (double)duration / calls / 31);
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        crypto_decryption_key_128(key_128);
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] PRESENT-128 key schedule cycle count per round = %.1f\n", (double)duration / calls / 31);
+
+    // PRESENT-128 only differs in the key schedule.
+    memset(pt, 0u, sizeof(pt));
+    memset(key_128, 0u, sizeof(key_128));
+    crypto_func_128(pt, key_128);
+
+    for (uint32_t i = 0; i < BENCH_BLOCKS; i++)
+    {
+        if (memcmp(pt + i * CRYPTO_IN_SIZE, tv_ct_128, CRYPTO_OUT_SIZE) != 0)
+        {
+            printf("[FAILED] Wrong PRESENT-128 ciphertext in block %u\n", i);
+            return 1;
+        }
+    }
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        memset(key_128, 0u, sizeof(key_128));
+        crypto_func_128(pt, key_128);
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] PRESENT-128 cycle count per block = %.1f\n", (double)duration / calls / BENCH_BLOCKS);
+
+#ifdef BITSLICE_WIDTH
+    // Many batches under one key: the key schedule runs only once.
+    static present_expanded_key_t expanded;
+
+    present_expand_key(&expanded, key);
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        present_encrypt_expanded(&expanded, pt);
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] Cycle count per block with expanded key = %.1f\n", (double)duration / calls / BENCH_BLOCKS);
+
+    // Same again with the second core launched once per session instead of once per call.
+    uint64_t duration_per_call = duration;
+
+    present_worker_start();
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        present_encrypt_expanded(&expanded, pt);
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] Cycle count per block with expanded key and persistent worker = %.1f\n", (double)duration / calls / BENCH_BLOCKS);
+    printf("[+] Launch overhead per call = %.1f\n", ((double)duration_per_call - (double)duration) / calls);
+
+    // BENCH_BATCHES batches per call, each one split inside every round or whole batches per core.
+    static uint8_t batches[CRYPTO_IN_SIZE * BITSLICE_WIDTH * BENCH_BATCHES];
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        for (uint32_t j = 0; j < BENCH_BATCHES; j++)
+        {
+            present_encrypt_expanded(&expanded, batches + j * CRYPTO_IN_SIZE * BITSLICE_WIDTH);
+        }
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] Cycle count per block with %u batches split inside each round = %.1f\n", BENCH_BATCHES,
+           (double)duration / calls / BENCH_BATCHES / BENCH_BLOCKS);
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        present_encrypt_batches(&expanded, batches, BENCH_BATCHES);
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] Cycle count per block with %u batches as whole batches per core = %.1f\n", BENCH_BATCHES,
+           (double)duration / calls / BENCH_BATCHES / BENCH_BLOCKS);
+
+    // present_encrypt_blocks for counts that end in both kinds of tail, against whole batches.
+    static uint8_t blocks_in[CRYPTO_IN_SIZE * BITSLICE_WIDTH * 2];
+    static uint8_t blocks_out[CRYPTO_IN_SIZE * BITSLICE_WIDTH * 2];
+    const size_t counts[] = {1, present_tail_blocks(&expanded), BITSLICE_WIDTH + 1, 2 * BITSLICE_WIDTH - 1,
+                             2 * BITSLICE_WIDTH};
+
+    for (uint32_t i = 0; i < sizeof(blocks_in); i++)
+    {
+        batches[i] = blocks_in[i] = (uint8_t)(i * 7);
+    }
+
+    present_encrypt_batches(&expanded, batches, 2);
+
+    for (uint32_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        memset(blocks_out, 0u, sizeof(blocks_out));
+        present_encrypt_blocks(&expanded, blocks_in, blocks_out, counts[i]);
+
+        if (memcmp(blocks_out, batches, counts[i] * CRYPTO_IN_SIZE) != 0)
+        {
+            printf("[FAILED] Wrong ciphertext of present_encrypt_blocks with %u blocks\n", (unsigned)counts[i]);
+            return 1;
+        }
+    }
+
+    // The same blocks in fragments of BENCH_FRAGMENT bytes, so most fragments end inside a block.
+    static present_iovec_t src_iov[sizeof(blocks_in) / BENCH_FRAGMENT + 1];
+    static present_iovec_t dst_iov[sizeof(blocks_in) / BENCH_FRAGMENT + 1];
+    size_t fragments = 0;
+
+    for (size_t off = 0; off < sizeof(blocks_in); off += BENCH_FRAGMENT, fragments++)
+    {
+        size_t len = sizeof(blocks_in) - off < BENCH_FRAGMENT ? sizeof(blocks_in) - off : BENCH_FRAGMENT;
+
+        src_iov[fragments] = (present_iovec_t){blocks_in + off, len};
+        dst_iov[fragments] = (present_iovec_t){blocks_out + off, len};
+    }
+
+    memset(blocks_out, 0u, sizeof(blocks_out));
+    present_encrypt_iov(&expanded, src_iov, fragments, dst_iov, fragments);
+
+    if (memcmp(blocks_out, batches, sizeof(blocks_out)) != 0)
+    {
+        printf("[FAILED] Wrong ciphertext of present_encrypt_iov\n");
+        return 1;
+    }
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        present_encrypt_iov(&expanded, src_iov, fragments, dst_iov, fragments);
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] Cycle count per block from and to %u-byte fragments = %.1f\n", BENCH_FRAGMENT,
+           (double)duration / calls / 2 / BENCH_BLOCKS);
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        present_encrypt_blocks(&expanded, blocks_in, blocks_out, 2 * BITSLICE_WIDTH);
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] Cycle count per block out of place = %.1f\n", (double)duration / calls / 2 / BENCH_BLOCKS);
+
+    // Tails one block at a time against one batch. A batch costs the same for all tails that fill as many tiles, so
+    // each is timed once, and the crossover is the first tail where it is cheaper than that many blocks. It should be
+    // close to what present_tail_blocks measured with fewer runs.
+    double single, batch = 0;
+    uint32_t crossover = BITSLICE_WIDTH;
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        for (uint32_t j = 0; j < BITSLICE_WIDTH; j++)
+        {
+            present_encrypt_block(&expanded, blocks_out + j * CRYPTO_IN_SIZE);
+        }
+    }
+    end = platform_cpucycles();
+
+    single = (double)((end - begin) & PLATFORM_CYCLES_MASK) / calls / BITSLICE_WIDTH;
+
+    for (uint32_t n = 1; n < BITSLICE_WIDTH && crossover == BITSLICE_WIDTH; n++)
+    {
+        if (n % BS_WORD_BITS == 1)
+        {
+            begin = platform_cpucycles();
+            for (uint32_t i = 0; i < calls; i++)
+            {
+                present_encrypt_tail(&expanded, blocks_out, n);
+            }
+            end = platform_cpucycles();
+
+            batch = (double)((end - begin) & PLATFORM_CYCLES_MASK) / calls;
+        }
+
+        if (batch <= n * single)
+        {
+            crossover = n;
+        }
+    }
+
+    printf("[+] Tail crossover = %u blocks, %.1f cycles per block one at a time, %.1f per batch there"
+           " (present_tail_blocks is %u)\n", crossover, single, batch, (unsigned)present_tail_blocks(&expanded));
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        present_decrypt_expanded(&expanded, pt);
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] Decryption cycle count per block with expanded key = %.1f\n", (double)duration / calls / BENCH_BLOCKS);
+
+    // One key per block, all zero so testvector 0 comes out again.
+    static uint8_t lane_keys[CRYPTO_KEY_SIZE * BITSLICE_WIDTH];
+
+    memset(pt, 0u, sizeof(pt));
+    crypto_func_lane_keys(pt, lane_keys);
+
+    if (memcmp(pt + (BITSLICE_WIDTH - 1) * CRYPTO_IN_SIZE, tv_ct, CRYPTO_OUT_SIZE) != 0)
+    {
+        printf("[FAILED] Wrong ciphertext with lane keys\n");
+        return 1;
+    }
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        crypto_func_lane_keys(pt, lane_keys);
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] Cycle count per block with one key per block = %.1f\n", (double)duration / calls / BENCH_BLOCKS);
+
+    // Counter mode over the same number of blocks. Key 0 and counter block 0 give testvector 0 again.
+    static present_ctr_t ctr;
+    static uint8_t zero_key[CRYPTO_KEY_SIZE];
+    static uint8_t iv[CRYPTO_IN_SIZE];
+
+    present_ctr_init(&ctr, zero_key, iv);
+
+    memset(pt, 0u, sizeof(pt));
+    present_ctr_update(&ctr, pt, sizeof(pt));
+
+    if (memcmp(pt, tv_ct, CRYPTO_OUT_SIZE) != 0)
+    {
+        printf("[FAILED] Wrong keystream\n");
+        return 1;
+    }
+
+    // Counters that carry into the upper half in the middle of a batch and that wrap around at 2^64 in the first or
+    // second batch, in chunks of all lengths from one byte to almost a batch, with both key sizes.
+    static const uint8_t ctr_key[CRYPTO_KEY_SIZE_128] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                                                         0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF};
+    static const uint64_t ctr_starts[] = {0, 0xFFFFFFFFull - BITSLICE_WIDTH + 3, UINT64_MAX - BITSLICE_WIDTH - 2, UINT64_MAX - 2};
+    static const size_t ctr_chunks[][3] = {
+        {CRYPTO_IN_SIZE * BENCH_CTR_BLOCKS, 0, 0},
+        {1, 0, 0},
+        {7, 8, 9},
+        {CRYPTO_IN_SIZE * BITSLICE_WIDTH - 3, 13, CRYPTO_IN_SIZE},
+    };
+
+    for (uint32_t i = 0; i < sizeof(ctr_starts) / sizeof(ctr_starts[0]); i++)
+    {
+        for (uint32_t j = 0; j < sizeof(ctr_chunks) / sizeof(ctr_chunks[0]); j++)
+        {
+            size_t chunk_count = ctr_chunks[j][1] == 0 ? 1 : 3;
+
+            for (uint8_t size = CRYPTO_KEY_SIZE; size <= CRYPTO_KEY_SIZE_128; size += CRYPTO_KEY_SIZE_128 - CRYPTO_KEY_SIZE)
+            {
+                if (!ctr_matches(ctr_key, size, ctr_starts[i], ctr_chunks[j], chunk_count))
+                {
+                    printf("[FAILED] Wrong keystream with %u-bit keys from counter 0x%016llX in chunks of %u bytes\n",
+                           size * 8, (unsigned long long)ctr_starts[i], (unsigned)ctr_chunks[j][0]);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        present_ctr_update(&ctr, pt, sizeof(pt));
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] Counter mode cycle count per block = %.1f\n", (double)duration / calls / BENCH_BLOCKS);
+
+    // CMAC of BITSLICE_WIDTH short messages, one per lane, against the same messages one after the other.
+    static present_cmac_t cmac;
+    static uint8_t messages[BITSLICE_WIDTH][BENCH_CMAC_LEN];
+    static const uint8_t *msgs[BITSLICE_WIDTH];
+    static size_t lens[BITSLICE_WIDTH];
+    static uint8_t tags[CRYPTO_OUT_SIZE * BITSLICE_WIDTH];
+    static uint8_t tags_one[CRYPTO_OUT_SIZE * BITSLICE_WIDTH];
+
+    for (uint8_t size = CRYPTO_KEY_SIZE; size <= CRYPTO_KEY_SIZE_128; size += CRYPTO_KEY_SIZE_128 - CRYPTO_KEY_SIZE)
+    {
+        if (!cmac_matches(ctr_key, size))
+        {
+            printf("[FAILED] Wrong CMAC tags with %u-bit keys\n", size * 8);
+            return 1;
+        }
+    }
+
+    present_cmac_init(&cmac, zero_key);
+
+    for (uint32_t i = 0; i < BITSLICE_WIDTH; i++)
+    {
+        memset(messages[i], i, BENCH_CMAC_LEN);
+        msgs[i] = messages[i];
+        lens[i] = BENCH_CMAC_LEN;
+    }
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        present_cmac(&cmac, msgs, lens, BITSLICE_WIDTH, tags);
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] CMAC cycle count per %u-byte message, one message per lane = %.1f\n", BENCH_CMAC_LEN, (double)duration / calls / BITSLICE_WIDTH);
+
+    // Each message costs the passes of a whole batch here, so the loop runs BITSLICE_WIDTH times less often to take
+    // about as long as the one above.
+    uint32_t cmac_calls = calls / BITSLICE_WIDTH > 0 ? calls / BITSLICE_WIDTH : 1;
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < cmac_calls; i++)
+    {
+        for (uint32_t j = 0; j < BITSLICE_WIDTH; j++)
+        {
+            present_cmac(&cmac, msgs + j, lens + j, 1, tags_one + j * CRYPTO_OUT_SIZE);
+        }
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] CMAC cycle count per %u-byte message, one message at a time = %.1f\n", BENCH_CMAC_LEN, (double)duration / cmac_calls / BITSLICE_WIDTH);
+
+    if (memcmp(tags, tags_one, sizeof(tags)) != 0)
+    {
+        printf("[FAILED] CMAC tags of one message per lane and one message at a time differ\n");
+        return 1;
+    }
+
+    // Key search with BENCH_KEYSEARCH_BITS unknown bits at both ends of the key register, once with all rounds and
+    // 80-bit keys and once reduced to BENCH_KEYSEARCH_ROUNDS rounds with 128-bit keys. The key has to be among the matches.
+    static present_keysearch_t search;
+    static const uint8_t search_pt[CRYPTO_IN_SIZE] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+
+    for (uint8_t size = CRYPTO_KEY_SIZE; size <= CRYPTO_KEY_SIZE_128; size += CRYPTO_KEY_SIZE_128 - CRYPTO_KEY_SIZE)
+    {
+        uint8_t rounds = size == CRYPTO_KEY_SIZE ? CRYPTO_ROUNDS : BENCH_KEYSEARCH_ROUNDS;
+        uint8_t search_key[CRYPTO_KEY_SIZE_128];
+        uint8_t search_mask[CRYPTO_KEY_SIZE_128] = {0u};
+        uint8_t search_ct[CRYPTO_OUT_SIZE];
+        bool found = false;
+
+        for (uint8_t i = 0; i < size; i++)
+        {
+            search_key[i] = (uint8_t)(0x5A + 37 * i);
+        }
+
+        for (uint8_t k = 0; k < BENCH_KEYSEARCH_BITS; k++)
+        {
+            uint8_t bit = k % 2 ? size * 8 - 1 - k / 2 : k / 2;
+
+            search_mask[bit / 8] |= 1u << (bit % 8);
+        }
+
+        if (size == CRYPTO_KEY_SIZE_128)
+        {
+            present_expand_key_128(&expanded, search_key);
+        }
+        else
+        {
+            present_expand_key(&expanded, search_key);
+        }
+
+        memcpy(search_ct, search_pt, CRYPTO_IN_SIZE);
+        present_encrypt_block_rounds(&expanded, search_ct, rounds);
+
+        if (size == CRYPTO_KEY_SIZE_128)
+        {
+            present_keysearch_init_128(&search, search_key, search_mask, search_pt, search_ct, rounds);
+        }
+        else
+        {
+            present_keysearch_init(&search, search_key, search_mask, search_pt, search_ct, rounds);
+        }
+
+        begin = platform_cpucycles();
+        while (present_keysearch_run(&search, BENCH_BATCHES))
+        {
+        }
+        end = platform_cpucycles();
+
+        duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+        for (uint32_t i = 0; i < search.found_count && i < PRESENT_KEYSEARCH_FOUND; i++)
+        {
+            found |= memcmp(search.found[i], search_key, size) == 0;
+        }
+
+        if (!found || search.keys_tested != (uint64_t)1 << BENCH_KEYSEARCH_BITS)
+        {
+            printf("[FAILED] Key search with %u-bit keys and %u rounds did not find the key\n", size * 8, rounds);
+            return 1;
+        }
+
+        printf("[+] Key search with %u-bit keys and %u rounds = %.0f keys per second, %.1f cycles per key, %u matches\n",
+               size * 8, rounds, present_keysearch_keys_per_second(&search), (double)duration / search.keys_tested,
+               (unsigned)search.found_count);
+    }
+
+#ifdef PRESENT_BS_FIXED_KEY
+    // Kernel with the key of gen_kernels.py folded in, checked against the expanded key. It runs on one core only.
+    static const uint8_t fixed_key[PRESENT_BS_FIXED_KEY_SIZE] = PRESENT_BS_FIXED_KEY_BYTES;
+    static uint8_t fixed_pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH];
+
+    for (uint32_t i = 0; i < sizeof(pt); i++)
+    {
+        pt[i] = fixed_pt[i] = (uint8_t)i;
+    }
+
+#if PRESENT_BS_FIXED_KEY_SIZE == CRYPTO_KEY_SIZE_128
+    present_expand_key_128(&expanded, fixed_key);
+#else
+    present_expand_key(&expanded, fixed_key);
+#endif
+
+    present_encrypt_expanded(&expanded, pt);
+    present_encrypt_fixed_key(fixed_pt);
+
+    if (memcmp(pt, fixed_pt, sizeof(pt)) != 0)
+    {
+        printf("[FAILED] Wrong ciphertext with the fixed key\n");
+        return 1;
+    }
+
+    begin = platform_cpucycles();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        present_encrypt_fixed_key(pt);
+    }
+    end = platform_cpucycles();
+
+    duration = (end - begin) & PLATFORM_CYCLES_MASK;
+
+    printf("[+] Cycle count per block with the fixed key = %.1f\n", (double)duration / calls / BENCH_BLOCKS);
+#endif
+
+    present_worker_stop();
+#endif
+
+    return 0;
+}
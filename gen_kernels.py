@@ -0,0 +1,266 @@
+"""
+Generate the straight-line kernels of present_bs for one BITSLICE_WIDTH, as a build step of CMakeLists.txt.
+
+present_bs_transpose.h
+    transpose_kernel, the Eklundh transposition of transpose with both loops unrolled, so every SWAPMOVE has constant
+    rows, shift and mask for the BS_WORD_BITS of the width.
+
+present_bs_rounds.h
+    encrypt_rounds_kernel, all 31 rounds of encrypt_rounds unrolled. Each slice index is resolved through fix_index
+    here, so the kernel is a list of XORs with round key masks and sbox_slices calls on constant registers. With
+    OPTIMIZATION_MULTICORE there is one list per core, with a barrier after each round like encrypt_rounds.
+
+    With --key, also encrypt_rounds_fixed_key, where the key schedule is run here and its masks are folded in: a key bit
+    of 1 becomes a NOT of the slice and a key bit of 0 nothing, so there are no loads of round keys at all.
+
+present_bs_fixed_key.h, only with --key
+    The key as PRESENT_BS_FIXED_KEY_BYTES and PRESENT_BS_FIXED_KEY_SIZE, to check encrypt_rounds_fixed_key against
+    the normal key schedule.
+
+Keys are given as hex in the byte order of crypto_func, 10 bytes for PRESENT-80 or 16 bytes for PRESENT-128.
+
+Usage: python3 gen_kernels.py --width W [--key HEX] OUTDIR
+"""
+
+import argparse
+import os
+
+SBOX = [0xC, 0x5, 0x6, 0xB, 0x9, 0x0, 0xA, 0xD, 0x3, 0xE, 0xF, 0x8, 0x4, 0x7, 0x1, 0x2]
+
+WIDTHS = [32, 64, 128, 256, 512]
+
+ROUNDS = 31
+
+BLOCK_BITS = 64
+
+# Like MULTICORE_FOR in present_bs/crypto.c, core c does S-boxes 8 * c to 8 * c + 7 of each round.
+SBOXES = 16
+CORES = 2
+
+
+def pbox(i):
+    return i // 4 + (i % 4) * 16
+
+
+def pbox_inv(i):
+    return (i % 16) * 4 + i // 16
+
+
+def fix_index(i, phase):
+    """Index in state_bs of the ith slice in the slice order of phase, like fix_index in present_bs/crypto.c."""
+    if phase == 1:
+        return pbox_inv(i)
+
+    if phase == 2:
+        return pbox(i)
+
+    return i
+
+
+def round_keys(key):
+    """The 32 round keys of a key, as 64-bit integers. Bit i of a round key is slice i."""
+    bits = len(key) * 8
+    k = int.from_bytes(key, 'little')
+    mask = (1 << bits) - 1
+    keys = []
+
+    for r in range(1, ROUNDS + 2):
+        keys.append(k >> (bits - BLOCK_BITS))
+
+        if r > ROUNDS:
+            break
+
+        k = ((k << 61) | (k >> (bits - 61))) & mask
+
+        if bits == 128:
+            top = (SBOX[k >> 124] << 4) | SBOX[(k >> 120) & 0xF]
+            k = (k & ((1 << 120) - 1)) | (top << 120)
+            k ^= r << 62
+        else:
+            k = (k & ((1 << 76) - 1)) | (SBOX[k >> 76] << 76)
+            k ^= r << 15
+
+    return keys
+
+
+def transpose_lines(word_bits):
+    """SWAPMOVE statements of transpose for a square matrix of word_bits rows."""
+    lines = []
+    mask = (1 << (word_bits // 2)) - 1
+    h = word_bits // 2
+    full = (1 << word_bits) - 1
+    digits = word_bits // 4
+    suffix = 'u' if word_bits == 32 else 'ull'
+
+    while h:
+        lines.append(f'// Blocks of {h} x {h} bits')
+
+        for k in range(word_bits // 2):
+            r = ((k & ~(h - 1)) << 1) | (k & (h - 1))
+            lines.append(f'SWAPMOVE(m[{r}], m[{r + h}], 0x{mask:0{digits}X}{suffix}, {h});')
+
+        h >>= 1
+        mask = (mask ^ (mask << h)) & full
+
+    return lines
+
+
+def round_lines(first, last, barrier, key_bits=None):
+    """
+    Statements of all rounds for S-boxes first to last - 1, in phase 0 to FIX_PHASE(ROUNDS).
+
+    Without key_bits, the round keys are XORed from rk. With key_bits, the round keys of round_keys are folded in.
+    """
+    lines = []
+
+    def add_round_key(r):
+        phase = r % 3
+
+        for s in range(first, last):
+            for j in range(4):
+                k = fix_index(s * 4 + j, phase)
+
+                if key_bits is None:
+                    lines.append(f'state_bs[{k}] ^= rk[{r}][{k}];')
+                elif (key_bits[r] >> (s * 4 + j)) & 1:
+                    lines.append(f'state_bs[{k}] = ~state_bs[{k}];')
+
+    for r in range(ROUNDS):
+        lines.append(f'// Round {r + 1}, phase {r % 3}')
+        add_round_key(r)
+
+        for s in range(first, last):
+            args = ', '.join(f'&state_bs[{fix_index(s * 4 + j, r % 3)}]' for j in range(4))
+            lines.append(f'sbox_slices({args});')
+
+        if barrier:
+            lines.append('MULTICORE_BARRIER();')
+
+    lines.append(f'// Last round key, phase {ROUNDS % 3}')
+    add_round_key(ROUNDS)
+
+    return lines
+
+
+def function(signature, body, prologue=()):
+    return '\n'.join([signature, '{'] + ['    ' + line for line in list(prologue) + body] + ['}', ''])
+
+
+def guard(name, condition, message):
+    return f'#ifndef {name}\n#define {name}\n\n#if {condition}\n#error "{message}"\n#endif\n\n'
+
+
+def write_transpose(path, width):
+    word_bits = 32 if width == 32 else 64
+    text = guard('__PRESENT_BS_TRANSPOSE_H', f'BS_WORD_BITS != {word_bits}',
+                 f'present_bs_transpose.h was generated for BS_WORD_BITS {word_bits}')
+    text += '// Generated by gen_kernels.py, included by present_bs/crypto.c.\n\n'
+    text += '/**\n * @brief transpose with both loops unrolled.\n *\n * @param m rows of the matrix\n */\n'
+    text += function('static void transpose_kernel(bs_word_t m[BS_WORD_BITS])', transpose_lines(word_bits))
+    text += '\n#endif\n'
+
+    with open(path, 'w') as f:
+        f.write(text)
+
+
+def write_rounds(path, width, key):
+    rk = ['const bs_reg_t (*rk)[CRYPTO_IN_SIZE_BIT] = expanded->round_key_bs;', '']
+    signature = 'static void {}(bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], const present_expanded_key_t *expanded)'
+    per_core = SBOXES // CORES
+
+    text = guard('__PRESENT_BS_ROUNDS_H', f'BITSLICE_WIDTH != {width}',
+                 f'present_bs_rounds.h was generated for BITSLICE_WIDTH {width}')
+    text += '// Generated by gen_kernels.py, included by present_bs/crypto.c.\n\n'
+
+    text += '/**\n * @brief All rounds of encrypt_rounds on one core, unrolled.\n *\n'
+    text += ' * @param state_bs bitsliced state in phase 0, ends in phase FIX_PHASE(CRYPTO_ROUNDS)\n'
+    text += ' * @param expanded expanded key\n */\n'
+    text += function(signature.format('encrypt_rounds_all'), round_lines(0, SBOXES, False), rk)
+
+    text += '\n#ifdef OPTIMIZATION_MULTICORE\n'
+
+    for core in range(CORES):
+        text += f'\n/**\n * @brief The part of core{core} of encrypt_rounds_all, with a barrier after each round.\n *\n'
+        text += ' * @param state_bs bitsliced state shared by both cores\n * @param expanded expanded key\n */\n'
+        text += function(signature.format(f'encrypt_rounds_core{core}'),
+                         round_lines(core * per_core, (core + 1) * per_core, True), rk)
+
+    text += '#endif\n'
+
+    text += '''
+/**
+ * @brief encrypt_rounds with all rounds unrolled.
+ *
+ * @param state_bs bitsliced state in phase 0, ends in phase FIX_PHASE(CRYPTO_ROUNDS)
+ * @param expanded expanded key
+ * @param core_id id of core only available when OPTIMIZATION_MULTICORE
+ */
+static void encrypt_rounds_kernel(bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], const present_expanded_key_t *expanded
+#ifdef OPTIMIZATION_MULTICORE
+                                 ,uint8_t core_id
+#endif
+)
+{
+#ifdef OPTIMIZATION_MULTICORE
+    if (core_id == CORE0)
+    {
+        encrypt_rounds_core0(state_bs, expanded);
+        return;
+    }
+
+    if (core_id == CORE1)
+    {
+        encrypt_rounds_core1(state_bs, expanded);
+        return;
+    }
+#endif
+
+    encrypt_rounds_all(state_bs, expanded);
+}
+'''
+
+    if key is not None:
+        text += '\n/**\n * @brief encrypt_rounds_all with the round keys of the key given to gen_kernels.py folded in.\n *\n'
+        text += ' * @param state_bs bitsliced state in phase 0, ends in phase FIX_PHASE(CRYPTO_ROUNDS)\n */\n'
+        text += function('static void encrypt_rounds_fixed_key(bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT])',
+                         round_lines(0, SBOXES, False, round_keys(key)))
+
+    text += '\n#endif\n'
+
+    with open(path, 'w') as f:
+        f.write(text)
+
+
+def write_fixed_key(path, key):
+    text = '#ifndef __PRESENT_BS_FIXED_KEY_H\n#define __PRESENT_BS_FIXED_KEY_H\n\n'
+    text += '// Generated by gen_kernels.py, the key folded into encrypt_rounds_fixed_key.\n'
+    text += f'#define PRESENT_BS_FIXED_KEY_SIZE {len(key)}\n'
+    text += '#define PRESENT_BS_FIXED_KEY_BYTES {' + ', '.join(f'0x{b:02X}' for b in key) + '}\n'
+    text += '\n#endif\n'
+
+    with open(path, 'w') as f:
+        f.write(text)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Generate the straight-line kernels of present_bs')
+    parser.add_argument('--width', type=int, choices=WIDTHS, required=True, help='BITSLICE_WIDTH')
+    parser.add_argument('--key', help='key to fold into encrypt_rounds_fixed_key, as hex in the byte order of crypto_func')
+    parser.add_argument('outdir', help='directory of the generated headers')
+    args = parser.parse_args()
+
+    key = None
+
+    if args.key:
+        key = bytes.fromhex(args.key)
+
+        if len(key) not in (10, 16):
+            parser.error('the key must have 10 or 16 bytes')
+
+    os.makedirs(args.outdir, exist_ok=True)
+
+    write_transpose(os.path.join(args.outdir, 'present_bs_transpose.h'), args.width)
+    write_rounds(os.path.join(args.outdir, 'present_bs_rounds.h'), args.width, key)
+
+    if key is not None:
+        write_fixed_key(os.path.join(args.outdir, 'present_bs_fixed_key.h'), key)
@@ -0,0 +1,432 @@
+"""
+Search a small bitsliced circuit of the PRESENT S-box or its inverse and print it as C.
+
+Every signal is a truth table of 16 bits, bit v being its value for the input v = x3 x2 x1 x0, so a circuit that
+gives the truth tables of the four output bits computes the S-box for all 16 inputs at once.
+
+Both S-boxes need 4 nonlinear gates (AND, OR or ANDN = a & ~b), the rest are XOR and NOT. So the search has two steps:
+
+1. Nonlinear gates. Each one combines two XORs of the signals so far. All sequences of 4 such gates are enumerated
+   after which each output is an XOR of inputs, gate outputs and maybe the constant 1. Only the new part of a gate
+   matters for that, so gates that differ by XORs of the signals so far are tried once.
+
+2. XOR and NOT gates. For each sequence, the cheapest few variants of each gate are tried, and the XORs that feed the
+   gates and give the outputs are built by a greedy that shares as many partial sums as possible (Boyar-Peralta
+   distances), a few times with random ties. NOT is an XOR with the constant 1.
+
+Step 2 is a heuristic, so the result is small but not proven minimal. It is checked against all 16 inputs before it
+is printed.
+
+With --header, both circuits are printed as the macros SBOX_CIRCUIT and INV_SBOX_CIRCUIT of present_bs/sbox_circuit.h,
+which present_bs/crypto.c and host/present_engine.h include instead of copies of the gates. The search takes a minute
+or so, so the header is checked in rather than generated by the build:
+
+    python3 gen_sbox_circuit.py --header > present_bs/sbox_circuit.h
+
+Usage: python3 gen_sbox_circuit.py [--inverse | --header] [--no-andn] [--variants N] [--restarts N] [--seed N]
+"""
+
+import argparse
+import random
+import sys
+
+SBOX = [0xC, 0x5, 0x6, 0xB, 0x9, 0x0, 0xA, 0xD, 0x3, 0xE, 0xF, 0x8, 0x4, 0x7, 0x1, 0x2]
+
+MASK = 0xFFFF
+
+NONLINEAR_GATES = 4
+
+# Names of the inputs and outputs in the emitted code, like sbox_slices of present_bs/crypto.c.
+INPUT_NAMES = ['a', 'b', 'c', 'd']
+OUTPUT_NAMES = ['*x0', '*x1', '*x2', '*x3']
+
+# The same in the macros of --header. The trailing _ keeps them apart from the names of the arguments.
+MACRO_INPUT_NAMES = ['a_', 'b_', 'c_', 'd_']
+MACRO_OUTPUT_NAMES = ['(x0)', '(x1)', '(x2)', '(x3)']
+
+
+def inverse(sbox):
+    inv = [0] * len(sbox)
+
+    for x, y in enumerate(sbox):
+        inv[y] = x
+
+    return inv
+
+
+def input_tables():
+    return [sum(((v >> i) & 1) << v for v in range(16)) for i in range(4)]
+
+
+def output_tables(sbox):
+    return [sum(((sbox[v] >> j) & 1) << v for v in range(16)) for j in range(4)]
+
+
+def popcount(x):
+    return bin(x).count('1')
+
+
+def gate_ops(andn):
+    """Nonlinear gates as (C operator, function, symmetric)."""
+    ops = [
+        ('&', lambda a, b: a & b, True),
+        ('|', lambda a, b: a | b, True),
+    ]
+
+    if andn:
+        ops.append(('& ~', lambda a, b: a & ~b & MASK, False))
+
+    return ops
+
+
+class Basis:
+    """Echelon basis of a space of truth tables, with the XOR of signals that gives each basis vector."""
+
+    def __init__(self, vectors=()):
+        self.rows = []
+
+        for v, m in vectors:
+            self.add(v, m)
+
+    def reduce(self, v, m=0):
+        for pivot, row, row_m in self.rows:
+            if (v >> pivot) & 1:
+                v ^= row
+                m ^= row_m
+
+        return v, m
+
+    def add(self, v, m=0):
+        v, m = self.reduce(v, m)
+
+        if v == 0:
+            return False
+
+        self.rows.append((v.bit_length() - 1, v, m))
+
+        return True
+
+    def copy(self):
+        b = Basis()
+        b.rows = list(self.rows)
+
+        return b
+
+
+def xor_span(signals):
+    """All nonzero XORs of signals, as (mask of the signals used, truth table)."""
+    span = [(0, 0)]
+
+    for i, s in enumerate(signals):
+        span += [(m | (1 << i), v ^ s) for m, v in span]
+
+    return span[1:]
+
+
+def nonlinear_gates(signals, ops):
+    """All gates of two XORs of signals, as (operator, mask of a, mask of b, truth table)."""
+    span = xor_span(signals)
+
+    for i, (ma, a) in enumerate(span):
+        for j, (mb, b) in enumerate(span):
+            for name, f, symmetric in ops:
+                if i == j or (symmetric and j < i):
+                    continue
+
+                yield name, ma, mb, f(a, b)
+
+
+def affine_basis(signals):
+    """Basis of the XORs of signals and the constant 1. The constant is signal number len(signals)."""
+    return Basis([(MASK, 1 << len(signals))] + [(s, 1 << i) for i, s in enumerate(signals)])
+
+
+def skeletons(sbox, ops, gates_left=NONLINEAR_GATES):
+    """
+    Step 1: sequences of nonlinear gates after which all outputs are XORs of signals and the constant.
+
+    Each sequence is given as the new parts of its gates. The outputs left over must span no more dimensions than
+    there are gates left, which prunes almost everything.
+    """
+    targets = output_tables(sbox)
+    found = []
+
+    def search(signals, basis, sequence, left):
+        rest = Basis()
+        rank = sum(1 for y in targets if rest.add(basis.reduce(y)[0]))
+
+        if rank == 0:
+            found.append(list(sequence))
+            return
+
+        if rank > left:
+            return
+
+        tried = set()
+
+        for _, _, _, o in nonlinear_gates(signals, ops):
+            new = basis.reduce(o)[0]
+
+            if new == 0 or new in tried:
+                continue
+
+            tried.add(new)
+
+            next_basis = basis.copy()
+            next_basis.add(o)
+
+            sequence.append(new)
+            search(signals + [o], next_basis, sequence, left - 1)
+            sequence.pop()
+
+    inputs = input_tables()
+    search(inputs, affine_basis(inputs), [], gates_left)
+
+    return found
+
+
+def distance(t, avail, sums):
+    """Lower estimate of the XORs needed for t, like the distances of Boyar and Peralta."""
+    if t in avail:
+        return 0
+
+    if t in sums:
+        return 1
+
+    if any(t ^ s in sums for s in avail):
+        return 2
+
+    if any(t ^ p in sums for p in sums):
+        return 3
+
+    return popcount(t)
+
+
+def xor_program(stages, n_signals, rng):
+    """
+    Step 2: XOR and NOT gates for the inputs of the nonlinear gates and the outputs, in a greedy way.
+
+    Signals are masks of the inputs, gates and the constant 1 (bit n_signals). Stage k lists what gate k needs, the
+    last stage the outputs. Gate k becomes available after stage k.
+
+    @return list of (mask, mask of input 1, mask of input 2) and ('gate', k)
+    """
+    avail = set(1 << i for i in range(4)) | {1 << n_signals}
+    known = 0xF | (1 << n_signals)
+    program = []
+
+    for k, targets in enumerate(stages):
+        later = [t for ts in stages[k + 1:] for t in ts]
+
+        while True:
+            need = [t for t in targets if t not in avail]
+
+            if not need:
+                break
+
+            signals = sorted(avail)
+            sums = {}
+
+            for i in range(len(signals)):
+                for j in range(i + 1, len(signals)):
+                    sums.setdefault(signals[i] ^ signals[j], (signals[i], signals[j]))
+
+            ready = [t for t in need if t in sums]
+
+            if ready:
+                new = ready[0]
+            else:
+                # The partial sum that brings the targets of this stage closest, then those of later stages as far
+                # as their signals are known already.
+                partial = [t & known for t in later if popcount(t & known) > 1]
+                best = None
+
+                for new_candidate in sums:
+                    if new_candidate in avail:
+                        continue
+
+                    after = avail | {new_candidate}
+                    after_sums = set(sums) | {new_candidate ^ s for s in avail}
+                    score = (sum(distance(t, after, after_sums) for t in need),
+                             sum(distance(t, after, after_sums) for t in partial), rng.random())
+
+                    if best is None or score < best[0]:
+                        best = (score, new_candidate)
+
+                new = best[1]
+
+            avail.add(new)
+            program.append((new,) + sums[new])
+
+        if k < len(stages) - 1:
+            avail.add(1 << (4 + k))
+            known |= 1 << (4 + k)
+            program.append(('gate', k))
+
+    return program
+
+
+def circuits(sbox, ops, variants, restarts, rng):
+    """All circuits of step 2, smallest first as they are found."""
+    targets = output_tables(sbox)
+    inputs = input_tables()
+    best = None
+
+    for sequence in skeletons(sbox, ops):
+        def realize(signals, basis, gates):
+            nonlocal best
+
+            if len(gates) == len(sequence):
+                full = affine_basis(signals)
+                outputs = [full.reduce(y)[1] for y in targets]
+                stages = [[ma, mb] for _, ma, mb, _ in gates] + [outputs]
+
+                for _ in range(restarts):
+                    program = xor_program(stages, len(signals), rng)
+                    size = len(program)
+
+                    if best is None or size < best[0]:
+                        best = (size, list(gates), program, outputs)
+
+                return
+
+            # The cheapest variants of the next gate, by the inputs they have to XOR.
+            new = sequence[len(gates)]
+            options = [g for g in nonlinear_gates(signals, ops) if basis.reduce(g[3])[0] == new]
+            options.sort(key=lambda g: popcount(g[1]) + popcount(g[2]))
+
+            for gate in options[:variants]:
+                next_basis = basis.copy()
+                next_basis.add(gate[3])
+
+                gates.append(gate)
+                realize(signals + [gate[3]], next_basis, gates)
+                gates.pop()
+
+        realize(inputs, affine_basis(inputs), [])
+
+    return best
+
+
+def emit_c(size, gates, program, outputs, reg='bs_reg_t', inputs=INPUT_NAMES, results=OUTPUT_NAMES, suffix=''):
+    """
+    C statements of a circuit, from a, b, c, d to *x0 ... *x3, and the circuit as truth tables to check them.
+
+    reg is the type of the temporaries, inputs and results the names of the inputs and outputs, and suffix is appended
+    to the names of the temporaries.
+    """
+    n_signals = 4 + len(gates)
+    const = 1 << n_signals
+    names = {1 << i: name for i, name in enumerate(inputs)}
+    tables = {1 << i: t for i, t in enumerate(input_tables())}
+    tables[const] = MASK
+    lines = []
+    count = 0
+
+    def temp(mask, expr, table):
+        nonlocal count
+
+        names[mask] = f't{count}{suffix}'
+        tables[mask] = table
+        lines.append(f'{reg} t{count}{suffix} = {expr};')
+        count += 1
+
+    for step in program:
+        if step[0] == 'gate':
+            name, ma, mb, _ = gates[step[1]]
+            _, f, _ = next(op for op in gate_ops(True) if op[0] == name)
+            temp(1 << (4 + step[1]), f'{names[ma]} {name}{names[mb]}' if name == '& ~' else
+                 f'{names[ma]} {name} {names[mb]}', f(tables[ma], tables[mb]))
+            continue
+
+        new, a, b = step
+
+        if const in (a, b):
+            other = b if a == const else a
+            temp(new, f'~{names[other]}', ~tables[other] & MASK)
+        else:
+            temp(new, f'{names[a]} ^ {names[b]}', tables[a] ^ tables[b])
+
+    for j, mask in enumerate(outputs):
+        lines.append(f'{results[j]} = {names[mask]};')
+
+    return lines, [tables[mask] for mask in outputs]
+
+
+def search(sbox, args, names):
+    """The circuit of sbox as C statements with the names of emit_c, checked against all 16 inputs."""
+    result = circuits(sbox, gate_ops(not args.no_andn), args.variants, args.restarts, random.Random(args.seed))
+
+    if result is None:
+        sys.exit('No circuit found')
+
+    lines, tables = emit_c(*result, **names)
+
+    # The truth tables cover all 16 inputs.
+    if tables != output_tables(sbox):
+        sys.exit('Circuit does not match the S-box')
+
+    return lines
+
+
+def macro(name, lines):
+    """A statement macro of a circuit, with a backslash at the end of each line in one column like crypto.c."""
+    body = [f'#define {name}(T, x0, x1, x2, x3)', '    do', '    {',
+            '        T ' + ', '.join(f'{n} = {r}' for n, r in zip(MACRO_INPUT_NAMES, MACRO_OUTPUT_NAMES)) + ';']
+    body += ['        ' + line for line in lines]
+    body += ['    } while (0)']
+    width = max(len(line) for line in body) + 1
+
+    return [line.ljust(width) + '\\' for line in body[:-1]] + [body[-1]]
+
+
+def header(forward, inverse):
+    """present_bs/sbox_circuit.h with the circuits of the S-box and its inverse."""
+    return '''// Generated by gen_sbox_circuit.py --header, do not edit.
+#ifndef __SBOX_CIRCUIT_H
+#define __SBOX_CIRCUIT_H
+
+/**
+ * @brief The S-box of PRESENT on four bitsliced signals, a circuit of {gates} gates checked against all 16 inputs.
+ *
+ * It is plain C and C++ for any type T with &, |, ^ and ~, from uint64_t to vector registers, so present_bs and the
+ * template engine of the host use the same gates. Each argument is read once and then overwritten with the result.
+ *
+ * @param T type of the signals
+ * @param x0 Input and Output: least significant bit
+ * @param x1 Input and Output: second bit
+ * @param x2 Input and Output: third bit
+ * @param x3 Input and Output: most significant bit
+ */
+{forward}
+
+/**
+ * @brief The inverse S-box of PRESENT in the same form as SBOX_CIRCUIT, a circuit of {inverse_gates} gates.
+ */
+{inverse}
+
+#endif
+'''.format(gates=len(forward) - 4, inverse_gates=len(inverse) - 4,
+              forward='\n'.join(macro('SBOX_CIRCUIT', forward)), inverse='\n'.join(macro('INV_SBOX_CIRCUIT', inverse)))
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Search a small bitsliced circuit of the PRESENT S-box')
+    parser.add_argument('--inverse', action='store_true', help='circuit of the inverse S-box')
+    parser.add_argument('--header', action='store_true', help='both circuits as the macros of present_bs/sbox_circuit.h')
+    parser.add_argument('--no-andn', action='store_true', help='only AND and OR, for targets without and-not')
+    parser.add_argument('--variants', type=int, default=3, help='variants of each nonlinear gate to try')
+    parser.add_argument('--restarts', type=int, default=2, help='runs of the XOR greedy per variant')
+    parser.add_argument('--seed', type=int, default=1, help='seed of the ties of the XOR greedy')
+    args = parser.parse_args()
+
+    if args.header:
+        names = {'reg': 'T', 'inputs': MACRO_INPUT_NAMES, 'results': MACRO_OUTPUT_NAMES, 'suffix': '_'}
+        print(header(search(SBOX, args, names), search(inverse(SBOX), args, names)), end='')
+    else:
+        names = {}
+        lines = search(inverse(SBOX) if args.inverse else SBOX, args, names)
+
+        print(f'// {len(lines) - 4} gates, checked against all 16 inputs of the {"inverse " if args.inverse else ""}S-box')
+        for line in lines:
+            print(line)
@@ -0,0 +1,288 @@
+/**
+ * Host benchmark of all configurations of present::Present side by side.
+ *
+ * Each configuration of present::engines() is first checked against present_ref with random keys and blocks, then
+ * timed for encryption and decryption of BENCH_BATCHES batches per call. Configurations the CPU does not support are
+ * skipped. The configurations present::dispatch and present::dispatch_blocks pick for this CPU, or PRESENT_ENGINE, are
+ * printed first, and present::crypto_func and present::crypto_func_128 are checked with them. A child process checks the same with PRESENT_ENGINE
+ * set to a name with the key bits of PRESENT-80, which has to select its kernel for PRESENT-128 as well.
+ *
+ * Usage: bench_engine [calls] [name of one configuration]
+ **/
+
+#include "present_engine.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern "C" {
+#include "platform.h"
+#include "crypto.h"
+}
+
+#define BENCH_DEFAULT_CALLS 100
+
+// Batches per call, so the threads of a configuration have something to share.
+#define BENCH_BATCHES 16
+
+// PRESENT_ENGINE of the check in a child process, a configuration every build has, named with PRESENT-80 key bits.
+#define BENCH_OVERRIDE "w64-k80-circuit-unrolled-t1"
+
+/**
+ * @brief Random bytes.
+ */
+static std::vector<uint8_t> random_bytes(size_t size, std::mt19937 &rng)
+{
+    std::vector<uint8_t> bytes(size);
+
+    for (uint8_t &b : bytes)
+    {
+        b = (uint8_t)rng();
+    }
+
+    return bytes;
+}
+
+/**
+ * @brief Blocks encrypted one by one with present_ref.
+ *
+ * @param key CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128 bytes
+ * @param blocks blocks to encrypt
+ *
+ * @return encrypted blocks
+ */
+static std::vector<uint8_t> reference(const std::vector<uint8_t> &key, std::vector<uint8_t> blocks)
+{
+    for (size_t i = 0; i < blocks.size() / CRYPTO_IN_SIZE; i++)
+    {
+        // crypto_func leaves the key register after the last round in the key.
+        uint8_t key_reg[CRYPTO_KEY_SIZE_128];
+
+        memcpy(key_reg, key.data(), key.size());
+
+        if (key.size() == CRYPTO_KEY_SIZE_128)
+        {
+            crypto_func_128(blocks.data() + i * CRYPTO_IN_SIZE, key_reg);
+        }
+        else
+        {
+            crypto_func(blocks.data() + i * CRYPTO_IN_SIZE, key_reg);
+        }
+    }
+
+    return blocks;
+}
+
+/**
+ * @brief Compare a configuration with present_ref on one batch under a random key.
+ *
+ * @param info configuration
+ * @param rng random numbers
+ *
+ * @return whether encryption and decryption give the same blocks as present_ref
+ */
+static bool check(const present::EngineInfo &info, std::mt19937 &rng)
+{
+    std::vector<uint8_t> key = random_bytes(info.key_size, rng);
+    std::vector<uint8_t> blocks = random_bytes(info.width * CRYPTO_IN_SIZE, rng);
+    std::vector<uint8_t> expected = reference(key, blocks);
+
+    std::unique_ptr<present::Engine> engine = info.make(key.data());
+    std::vector<uint8_t> result = blocks;
+
+    engine->encrypt(result.data(), 1);
+
+    if (result != expected)
+    {
+        return false;
+    }
+
+    engine->decrypt(result.data(), 1);
+
+    return result == blocks;
+}
+
+/**
+ * @brief Compare present::crypto_func with present_ref for both key sizes, on two batches under a random key each.
+ *
+ * @param rng random numbers
+ *
+ * @return whether both give the same blocks as present_ref
+ */
+static bool check_crypto_func(std::mt19937 &rng)
+{
+    for (size_t key_size : {CRYPTO_KEY_SIZE, CRYPTO_KEY_SIZE_128})
+    {
+        std::vector<uint8_t> key = random_bytes(key_size, rng);
+        std::vector<uint8_t> blocks = random_bytes(2 * present::dispatch(key_size).width * CRYPTO_IN_SIZE, rng);
+        std::vector<uint8_t> expected = reference(key, blocks);
+
+        if (key_size == CRYPTO_KEY_SIZE_128)
+        {
+            present::crypto_func_128(blocks.data(), 2, key.data());
+        }
+        else
+        {
+            present::crypto_func(blocks.data(), 2, key.data());
+        }
+
+        if (blocks != expected)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Check dispatch and crypto_func with PRESENT_ENGINE set to name, in a child process.
+ *
+ * dispatch keeps its configurations for the rest of the process, so the override needs a process of its own. It has
+ * to be forked before this process starts the worker threads of the engine, which the child would not have.
+ *
+ * @param name configuration of engines() with the key bits of PRESENT-80
+ *
+ * @return whether dispatch picks the kernel of name for both key sizes and crypto_func matches present_ref
+ */
+static bool check_override(const char *name)
+{
+    pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        std::mt19937 rng(2);
+        bool ok;
+
+        setenv("PRESENT_ENGINE", name, 1);
+
+        try
+        {
+            ok = present::dispatch(CRYPTO_KEY_SIZE).name == name &&
+                 present::dispatch(CRYPTO_KEY_SIZE_128).kernel == present::dispatch(CRYPTO_KEY_SIZE).kernel &&
+                 check_crypto_func(rng);
+        }
+        catch (const std::invalid_argument &e)
+        {
+            printf("[FAILED] %s\n", e.what());
+            ok = false;
+        }
+
+        fflush(stdout);
+        _exit(ok ? 0 : 1);
+    }
+
+    int status;
+
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * @brief Cycles per block of calls to encrypt or decrypt.
+ */
+static double measure(const present::Engine &engine, bool decrypt, uint8_t *blocks, uint32_t calls)
+{
+    uint64_t begin = platform_cpucycles();
+
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        if (decrypt)
+        {
+            engine.decrypt(blocks, BENCH_BATCHES);
+        }
+        else
+        {
+            engine.encrypt(blocks, BENCH_BATCHES);
+        }
+    }
+
+    uint64_t duration = (platform_cpucycles() - begin) & PLATFORM_CYCLES_MASK;
+
+    return (double)duration / calls / BENCH_BATCHES / engine.width();
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t calls = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_CALLS;
+    const char *only = argc > 2 ? argv[2] : NULL;
+    std::mt19937 rng(1);
+    bool found = false;
+
+    printf("[+] %u calls x %u batches\n", calls, BENCH_BATCHES);
+    fflush(stdout);
+
+    if (!check_override(BENCH_OVERRIDE))
+    {
+        printf("[FAILED] PRESENT_ENGINE=%s does not select its kernel for both key sizes\n", BENCH_OVERRIDE);
+        return 1;
+    }
+
+    printf("[+] PRESENT_ENGINE=%s selects its kernel for both key sizes\n", BENCH_OVERRIDE);
+
+    try
+    {
+        printf("[+] dispatch: %s, %s\n", present::dispatch(CRYPTO_KEY_SIZE).name.c_str(),
+               present::dispatch(CRYPTO_KEY_SIZE_128).name.c_str());
+        printf("[+] dispatch_blocks: %s, %s\n", present::dispatch_blocks(CRYPTO_KEY_SIZE).name.c_str(),
+               present::dispatch_blocks(CRYPTO_KEY_SIZE_128).name.c_str());
+
+        if (!check_crypto_func(rng))
+        {
+            printf("[FAILED] crypto_func does not match present_ref\n");
+            return 1;
+        }
+    }
+    catch (const std::invalid_argument &e)
+    {
+        printf("[FAILED] %s\n", e.what());
+        return 1;
+    }
+
+    printf("[+] %-32s %12s %12s\n", "configuration", "enc/block", "dec/block");
+
+    for (const present::EngineInfo &info : present::engines())
+    {
+        if (only != NULL && info.name != only)
+        {
+            continue;
+        }
+
+        found = true;
+
+        if (!info.supported)
+        {
+            printf("[+] %-32s not supported by this CPU\n", info.name.c_str());
+            continue;
+        }
+
+        if (!check(info, rng))
+        {
+            printf("[FAILED] %s does not match present_ref\n", info.name.c_str());
+            return 1;
+        }
+
+        std::vector<uint8_t> key(info.key_size);
+        std::vector<uint8_t> blocks(info.width * CRYPTO_IN_SIZE * BENCH_BATCHES);
+        std::unique_ptr<present::Engine> engine = info.make(key.data());
+
+        double enc = measure(*engine, false, blocks.data(), calls);
+        double dec = measure(*engine, true, blocks.data(), calls);
+
+        printf("[+] %-32s %12.1f %12.1f\n", info.name.c_str(), enc, dec);
+    }
+
+    if (!found)
+    {
+        printf("[FAILED] Unknown configuration %s\n", only);
+        return 1;
+    }
+
+    return 0;
+}
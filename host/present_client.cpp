@@ -0,0 +1,314 @@
+#include "present_client.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace present
+{
+
+namespace
+{
+
+[[noreturn]] void fail(const std::string &what)
+{
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+uint64_t unpack_le(const uint8_t *buf, size_t len)
+{
+    uint64_t value = 0;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        value |= static_cast<uint64_t>(buf[i]) << (8 * i);
+    }
+
+    return value;
+}
+
+} // namespace
+
+Client::Client(const std::string &port)
+{
+    struct termios tio;
+
+    // Non-blocking, so a write never waits for the device while it waits for us to read, see encrypt.
+    fd_ = open(port.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+    if (fd_ < 0)
+    {
+        fail(port);
+    }
+
+    // Binary transport, no echo and no line editing.
+    if (tcgetattr(fd_, &tio) != 0)
+    {
+        close(fd_);
+        fail(port);
+    }
+
+    cfmakeraw(&tio);
+    tcsetattr(fd_, TCSANOW, &tio);
+}
+
+Client::~Client()
+{
+    close(fd_);
+}
+
+void Client::wait_for(short events)
+{
+    struct pollfd pfd = {fd_, events, 0};
+
+    while (poll(&pfd, 1, -1) < 0)
+    {
+        if (errno != EINTR)
+        {
+            fail("poll");
+        }
+    }
+}
+
+void Client::write_all(const uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd_, buf, len);
+
+        if (n < 0)
+        {
+            if (errno == EAGAIN)
+            {
+                wait_for(POLLOUT);
+            }
+            else if (errno != EINTR)
+            {
+                fail("write");
+            }
+            continue;
+        }
+
+        buf += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+void Client::read_all(uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = read(fd_, buf, len);
+
+        if (n < 0)
+        {
+            if (errno == EAGAIN)
+            {
+                wait_for(POLLIN);
+            }
+            else if (errno != EINTR)
+            {
+                fail("read");
+            }
+            continue;
+        }
+
+        if (n == 0)
+        {
+            throw std::runtime_error("read: serial port closed");
+        }
+
+        buf += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+void Client::select_key_size(size_t key_size)
+{
+    if (key_size == key_size_)
+    {
+        return;
+    }
+
+    uint8_t tx[2] = {'K', static_cast<uint8_t>(key_size)};
+    uint8_t rx;
+
+    write_all(tx, sizeof(tx));
+
+    // The device answers with the key size in effect, which stays the old one if it does not know the new one.
+    read_all(&rx, 1);
+
+    if (rx != key_size)
+    {
+        throw std::runtime_error("device does not support keys of " + std::to_string(key_size) + " bytes");
+    }
+
+    key_size_ = key_size;
+}
+
+std::vector<uint8_t> Client::encrypt(const Key &key, const std::vector<uint8_t> &blocks, uint64_t *cycles)
+{
+    return bulk('B', key.data(), key.size(), blocks, cycles);
+}
+
+std::vector<uint8_t> Client::encrypt(const Key128 &key, const std::vector<uint8_t> &blocks, uint64_t *cycles)
+{
+    return bulk('B', key.data(), key.size(), blocks, cycles);
+}
+
+std::vector<uint8_t> Client::encrypt_pipelined(const Key &key, const std::vector<uint8_t> &blocks, uint64_t *cycles)
+{
+    return bulk('P', key.data(), key.size(), blocks, cycles);
+}
+
+std::vector<uint8_t> Client::encrypt_pipelined(const Key128 &key, const std::vector<uint8_t> &blocks, uint64_t *cycles)
+{
+    return bulk('P', key.data(), key.size(), blocks, cycles);
+}
+
+std::vector<uint8_t> Client::bulk(char command, const uint8_t *key, size_t key_size, const std::vector<uint8_t> &blocks,
+                                  uint64_t *cycles)
+{
+    if (blocks.size() % BLOCK_SIZE != 0 || blocks.size() / BLOCK_SIZE > UINT32_MAX)
+    {
+        throw std::invalid_argument("encrypt: blocks must be a multiple of 8 bytes");
+    }
+
+    select_key_size(key_size);
+
+    uint32_t count = static_cast<uint32_t>(blocks.size() / BLOCK_SIZE);
+    std::vector<uint8_t> header = {static_cast<uint8_t>(command)};
+
+    header.insert(header.end(), key, key + key_size);
+    for (size_t i = 0; i < 4; i++)
+    {
+        header.push_back(static_cast<uint8_t>(count >> (8 * i)));
+    }
+
+    write_all(header.data(), header.size());
+
+    // Ciphertexts and cycle count.
+    std::vector<uint8_t> rx(blocks.size() + 8);
+    size_t sent = 0;
+    size_t received = 0;
+
+    // The device answers each batch as soon as it is encrypted. Writing everything before reading would fill both
+    // directions of the serial port and block both sides, so write and read whatever is possible.
+    while (received < rx.size())
+    {
+        struct pollfd pfd = {fd_, POLLIN, 0};
+
+        if (sent < blocks.size())
+        {
+            pfd.events |= POLLOUT;
+        }
+
+        if (poll(&pfd, 1, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fail("poll");
+        }
+
+        if (pfd.revents & POLLIN)
+        {
+            ssize_t n = read(fd_, rx.data() + received, rx.size() - received);
+
+            if (n < 0 && errno != EINTR && errno != EAGAIN)
+            {
+                fail("read");
+            }
+            received += n > 0 ? static_cast<size_t>(n) : 0;
+        }
+
+        if (pfd.revents & POLLOUT)
+        {
+            ssize_t n = write(fd_, blocks.data() + sent, blocks.size() - sent);
+
+            if (n < 0 && errno != EINTR && errno != EAGAIN)
+            {
+                fail("write");
+            }
+            sent += n > 0 ? static_cast<size_t>(n) : 0;
+        }
+
+        if ((pfd.revents & (POLLHUP | POLLERR)) && !(pfd.revents & POLLIN))
+        {
+            throw std::runtime_error("encrypt: serial port closed");
+        }
+    }
+
+    if (cycles != nullptr)
+    {
+        *cycles = unpack_le(rx.data() + blocks.size(), 8);
+    }
+
+    rx.resize(blocks.size());
+
+    return rx;
+}
+
+std::vector<uint8_t> Client::encrypt_per_block(const Key &key, const std::vector<uint8_t> &blocks, uint64_t *cycles)
+{
+    return per_block(key.data(), key.size(), blocks, cycles);
+}
+
+std::vector<uint8_t> Client::encrypt_per_block(const Key128 &key, const std::vector<uint8_t> &blocks, uint64_t *cycles)
+{
+    return per_block(key.data(), key.size(), blocks, cycles);
+}
+
+std::vector<uint8_t> Client::per_block(const uint8_t *key, size_t key_size, const std::vector<uint8_t> &blocks,
+                                       uint64_t *cycles)
+{
+    select_key_size(key_size);
+
+    size_t count = blocks.size() / BLOCK_SIZE;
+    std::vector<uint8_t> out(blocks.size());
+    uint8_t rx[BLOCK_SIZE + 2];
+
+    // The device fills its batch from block 0 again after each batch, which is where this starts.
+    for (size_t j = 0; j < count; j++)
+    {
+        uint8_t tx[1 + BLOCK_SIZE] = {'b'};
+
+        std::memcpy(tx + 1, blocks.data() + j * BLOCK_SIZE, BLOCK_SIZE);
+        write_all(tx, sizeof(tx));
+
+        // 0xFF and block index
+        read_all(rx, 2);
+    }
+
+    uint8_t tx[1 + KEY_SIZE_128] = {'e'};
+
+    std::memcpy(tx + 1, key, key_size);
+    write_all(tx, 1 + key_size);
+
+    read_all(rx, 8);
+
+    if (cycles != nullptr)
+    {
+        *cycles = unpack_le(rx, 8);
+    }
+
+    for (size_t j = 0; j < count; j++)
+    {
+        uint8_t cmd = 'o';
+
+        write_all(&cmd, 1);
+        read_all(rx, BLOCK_SIZE + 2);
+
+        std::memcpy(out.data() + j * BLOCK_SIZE, rx, BLOCK_SIZE);
+    }
+
+    return out;
+}
+
+} // namespace present
@@ -0,0 +1,113 @@
+#ifndef __PRESENT_CLIENT_H
+#define __PRESENT_CLIENT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Host side of the serial protocol of present_bs, for a pico on /dev/ttyACM0 or present_bs_host on a pty.
+ *
+ * Blocks are 8 bytes and keys 10 bytes for PRESENT-80 or 16 bytes for PRESENT-128, in the byte order of
+ * test_against_testvectors.py. The key size of the device is selected with 'K' whenever it changes.
+ * Errors of the serial port are thrown as std::runtime_error.
+ */
+namespace present
+{
+
+constexpr size_t BLOCK_SIZE = 8;
+constexpr size_t KEY_SIZE = 10;
+constexpr size_t KEY_SIZE_128 = 16;
+
+using Key = std::array<uint8_t, KEY_SIZE>;
+using Key128 = std::array<uint8_t, KEY_SIZE_128>;
+
+class Client
+{
+public:
+    /**
+     * @brief Open the serial port in raw mode.
+     *
+     * @param port path of the serial port
+     */
+    explicit Client(const std::string &port);
+
+    ~Client();
+
+    Client(const Client &) = delete;
+    Client &operator=(const Client &) = delete;
+
+    /**
+     * @brief Encrypt any number of blocks with the bulk command 'B'.
+     *
+     * The blocks are sent while the ciphertexts come back, so neither side waits for the other.
+     *
+     * @param key key
+     * @param blocks plaintexts, a multiple of BLOCK_SIZE bytes
+     * @param cycles Output: cycles the device spent on the key schedule and encryption, may be nullptr
+     *
+     * @return ciphertexts
+     */
+    std::vector<uint8_t> encrypt(const Key &key, const std::vector<uint8_t> &blocks, uint64_t *cycles = nullptr);
+
+    /**
+     * @brief encrypt with PRESENT-128.
+     */
+    std::vector<uint8_t> encrypt(const Key128 &key, const std::vector<uint8_t> &blocks, uint64_t *cycles = nullptr);
+
+    /**
+     * @brief Encrypt any number of blocks with the pipelined bulk command 'P', like encrypt.
+     *
+     * The device receives, encrypts and sends different batches at the same time.
+     *
+     * @param key key
+     * @param blocks plaintexts, a multiple of BLOCK_SIZE bytes
+     * @param cycles Output: cycles the device waited for the encryption instead of doing I/O, may be nullptr
+     *
+     * @return ciphertexts
+     */
+    std::vector<uint8_t> encrypt_pipelined(const Key &key, const std::vector<uint8_t> &blocks, uint64_t *cycles = nullptr);
+
+    /**
+     * @brief encrypt_pipelined with PRESENT-128.
+     */
+    std::vector<uint8_t> encrypt_pipelined(const Key128 &key, const std::vector<uint8_t> &blocks,
+                                           uint64_t *cycles = nullptr);
+
+    /**
+     * @brief Encrypt one batch with the commands 'b', 'e' and 'o', with a round trip for each block.
+     *
+     * @param key key
+     * @param blocks exactly one batch of plaintexts
+     * @param cycles Output: cycles of the encryption, may be nullptr
+     *
+     * @return ciphertexts
+     */
+    std::vector<uint8_t> encrypt_per_block(const Key &key, const std::vector<uint8_t> &blocks, uint64_t *cycles = nullptr);
+
+    /**
+     * @brief encrypt_per_block with PRESENT-128.
+     */
+    std::vector<uint8_t> encrypt_per_block(const Key128 &key, const std::vector<uint8_t> &blocks,
+                                           uint64_t *cycles = nullptr);
+
+private:
+    std::vector<uint8_t> bulk(char command, const uint8_t *key, size_t key_size, const std::vector<uint8_t> &blocks,
+                              uint64_t *cycles);
+    std::vector<uint8_t> per_block(const uint8_t *key, size_t key_size, const std::vector<uint8_t> &blocks,
+                                   uint64_t *cycles);
+    void select_key_size(size_t key_size);
+    void wait_for(short events);
+    void write_all(const uint8_t *buf, size_t len);
+    void read_all(uint8_t *buf, size_t len);
+
+    int fd_;
+    // Key size of the device, 0 until the first 'K', since the device keeps it from earlier clients.
+    size_t key_size_ = 0;
+};
+
+} // namespace present
+
+#endif
@@ -0,0 +1,382 @@
+#include "present_engine.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace present
+{
+
+namespace detail
+{
+
+void update_round_key(uint64_t &hi, uint64_t &lo, unsigned r, unsigned key_bits)
+{
+    key_schedule_step(&hi, &lo, uint8_t(r), uint8_t(key_bits / 8));
+}
+
+namespace
+{
+
+/**
+ * @brief Worker threads of run_parts, which wait for the parts of one call at a time.
+ */
+class Workers
+{
+public:
+    explicit Workers(unsigned count)
+    {
+        for (unsigned i = 0; i < count; i++)
+        {
+            threads_.emplace_back([this, i] { loop(i + 1); });
+        }
+    }
+
+    ~Workers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+
+        start_.notify_all();
+
+        for (std::thread &thread : threads_)
+        {
+            thread.join();
+        }
+    }
+
+    /**
+     * @brief run_parts on the workers.
+     *
+     * @return false without running anything if another thread has the workers or there are too few of them
+     */
+    bool run(unsigned parts, void (*part)(void *ctx, size_t t), void *ctx)
+    {
+        std::unique_lock<std::mutex> busy(busy_, std::try_to_lock);
+
+        if (!busy.owns_lock() || parts - 1 > threads_.size())
+        {
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            part_ = part;
+            ctx_ = ctx;
+            parts_ = parts;
+            pending_ = parts - 1;
+            generation_++;
+        }
+
+        start_.notify_all();
+
+        part(ctx, 0);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return pending_ == 0; });
+
+        return true;
+    }
+
+private:
+    /**
+     * @brief Run part t of each call that has one, until the destructor.
+     */
+    void loop(size_t t)
+    {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        while (true)
+        {
+            start_.wait(lock, [this, seen] { return stop_ || generation_ != seen; });
+
+            if (stop_)
+            {
+                return;
+            }
+
+            seen = generation_;
+
+            if (t >= parts_)
+            {
+                continue;
+            }
+
+            void (*part)(void *, size_t) = part_;
+            void *ctx = ctx_;
+
+            lock.unlock();
+            part(ctx, t);
+            lock.lock();
+
+            if (--pending_ == 0)
+            {
+                done_.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> threads_;
+    // Held by the thread whose call runs on the workers.
+    std::mutex busy_;
+    // Guards everything below.
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    void (*part_)(void *, size_t) = nullptr;
+    void *ctx_ = nullptr;
+    size_t parts_ = 0;
+    size_t pending_ = 0;
+    // Counts the calls, so each worker runs its part of a call once.
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+};
+
+} // namespace
+
+void run_parts(unsigned parts, void (*part)(void *ctx, size_t t), void *ctx)
+{
+    // Function statics are initialized once, also with calls from several threads.
+    static Workers workers(std::max(2u, std::thread::hardware_concurrency()) - 1);
+
+    if (!workers.run(parts, part, ctx))
+    {
+        for (size_t t = 0; t < parts; t++)
+        {
+            part(ctx, t);
+        }
+    }
+}
+
+} // namespace detail
+
+namespace
+{
+
+// Instructions a translation unit is built with, beyond those of the rest of the library.
+enum class Isa
+{
+    base,
+    ssse3,
+    avx2,
+    avx512f
+};
+
+/**
+ * @brief Whether the running CPU has the instructions of isa.
+ */
+bool cpu_supports(Isa isa)
+{
+#if defined(PRESENT_ENGINE_AVX) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+
+    switch (isa)
+    {
+    case Isa::ssse3:
+        return __builtin_cpu_supports("ssse3");
+    case Isa::avx2:
+        return __builtin_cpu_supports("avx2");
+    case Isa::avx512f:
+        return __builtin_cpu_supports("avx512f");
+    case Isa::base:
+        break;
+    }
+#endif
+
+    return isa == Isa::base;
+}
+
+template <size_t N>
+void add(std::vector<EngineInfo> &list, const std::array<detail::EngineEntry, N> &entries, Isa isa = Isa::base)
+{
+    for (const detail::EngineEntry &e : entries)
+    {
+        std::string kernel = "w" + std::to_string(e.width) + "-" + e.sbox + (e.unroll ? "-unrolled" : "-loop") + "-t" +
+                             std::to_string(e.threads);
+        std::string name =
+            "w" + std::to_string(e.width) + "-k" + std::to_string(e.key_bits) + kernel.substr(kernel.find('-'));
+
+        list.push_back({name, kernel, e.width, e.key_bits / 8u, cpu_supports(isa), e.make, e.encrypt});
+    }
+}
+
+std::vector<EngineInfo> build_engines()
+{
+    std::vector<EngineInfo> list;
+
+    add(list, detail::entries_of<uint32_t>());
+    add(list, detail::entries_of<uint64_t>());
+#ifdef __SSE2__
+    add(list, detail::entries_of<Slice128>());
+#endif
+#ifdef PRESENT_ENGINE_AVX
+    add(list, detail::entries_avx2, Isa::avx2);
+    add(list, detail::entries_avx512, Isa::avx512f);
+    add(list, detail::entries_vperm_ssse3, Isa::ssse3);
+    add(list, detail::entries_vperm_avx2, Isa::avx2);
+#endif
+
+    return list;
+}
+
+/**
+ * @brief The configuration of dispatch for one key size, see there.
+ */
+const EngineInfo &resolve(size_t key_size)
+{
+    const char *choice = std::getenv("PRESENT_ENGINE");
+    std::string kernel = choice != nullptr ? choice : "";
+    const EngineInfo *best = nullptr;
+    unsigned threads = std::thread::hardware_concurrency() > 1 ? 2 : 1;
+    std::string suffix = "-circuit-unrolled-t" + std::to_string(threads);
+
+    // A name with the key bits of either key size stands for its kernel, so one PRESENT_ENGINE serves both.
+    for (const EngineInfo &info : engines())
+    {
+        if (info.name == kernel)
+        {
+            kernel = info.kernel;
+            break;
+        }
+    }
+
+    for (const EngineInfo &info : engines())
+    {
+        if (info.key_size != key_size || !info.supported)
+        {
+            continue;
+        }
+
+        if (!kernel.empty())
+        {
+            if (info.kernel == kernel)
+            {
+                return info;
+            }
+        }
+        else if (info.kernel.size() > suffix.size() &&
+                 info.kernel.compare(info.kernel.size() - suffix.size(), suffix.size(), suffix) == 0 &&
+                 (best == nullptr || info.width > best->width))
+        {
+            best = &info;
+        }
+    }
+
+    if (best == nullptr)
+    {
+        throw std::invalid_argument("PRESENT_ENGINE " + std::string(choice != nullptr ? choice : "") +
+                                    " is no supported engine for " + std::to_string(key_size) + " byte keys");
+    }
+
+    return *best;
+}
+
+/**
+ * @brief The configuration of dispatch_blocks for one key size, see there.
+ */
+const EngineInfo &resolve_blocks(size_t key_size)
+{
+    const EngineInfo *best = nullptr;
+
+    for (const EngineInfo &info : engines())
+    {
+        // The bitsliced configurations have at least 32 blocks per batch.
+        if (info.key_size == key_size && info.supported && info.width < 32 &&
+            (best == nullptr || info.width > best->width))
+        {
+            best = &info;
+        }
+    }
+
+    return best != nullptr ? *best : dispatch(key_size);
+}
+
+} // namespace
+
+const std::vector<EngineInfo> &engines()
+{
+    static const std::vector<EngineInfo> list = build_engines();
+
+    return list;
+}
+
+std::unique_ptr<Engine> make_engine(const std::string &name, const uint8_t *key)
+{
+    for (const EngineInfo &info : engines())
+    {
+        if (info.name == name)
+        {
+            if (!info.supported)
+            {
+                throw std::invalid_argument("engine " + name + " is not supported by this CPU");
+            }
+
+            return info.make(key);
+        }
+    }
+
+    throw std::invalid_argument("unknown engine " + name);
+}
+
+const EngineInfo &dispatch(size_t key_size)
+{
+    // Function statics are initialized once, also with calls from several threads. Each key size is resolved on its
+    // first call, so an error of one key size does not break the other.
+    if (key_size == 16)
+    {
+        static const EngineInfo &info = resolve(16);
+
+        return info;
+    }
+
+    if (key_size == 10)
+    {
+        static const EngineInfo &info = resolve(10);
+
+        return info;
+    }
+
+    throw std::invalid_argument("key size " + std::to_string(key_size) + " is neither 10 nor 16");
+}
+
+const EngineInfo &dispatch_blocks(size_t key_size)
+{
+    if (key_size == 16)
+    {
+        static const EngineInfo &info = resolve_blocks(16);
+
+        return info;
+    }
+
+    if (key_size == 10)
+    {
+        static const EngineInfo &info = resolve_blocks(10);
+
+        return info;
+    }
+
+    throw std::invalid_argument("key size " + std::to_string(key_size) + " is neither 10 nor 16");
+}
+
+void crypto_func(uint8_t *blocks, size_t batches, const uint8_t *key)
+{
+    // Resolved on the first call, also with calls from several threads.
+    static const EncryptFunc encrypt = dispatch(10).encrypt;
+
+    encrypt(blocks, batches, key);
+}
+
+void crypto_func_128(uint8_t *blocks, size_t batches, const uint8_t *key)
+{
+    static const EncryptFunc encrypt = dispatch(16).encrypt;
+
+    encrypt(blocks, batches, key);
+}
+
+} // namespace present
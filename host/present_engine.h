@@ -0,0 +1,637 @@
+#ifndef __PRESENT_ENGINE_H
+#define __PRESENT_ENGINE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// S-box circuits, slice orders and key schedule of present_bs, so the engine computes exactly what crypto.c does.
+#include "../present_bs/present_core.h"
+
+/**
+ * Bitsliced PRESENT as C++ templates for the host.
+ *
+ * present_bs/crypto.c picks its optimizations with the OPTIMIZATION_* defines, so a binary holds exactly one
+ * configuration. Present<SliceT, KeyBits, Rounds, Policy> takes the same choices as template parameters, so any number
+ * of configurations can live in one binary and one can be picked at runtime through engines().
+ *
+ * The algorithm is the one of present_bs: the state is fixsliced, round keys are masks of all ones or all zeros and
+ * blocks are moved in and out of bitsliced form by transposing tiles. Blocks and keys are little endian like there.
+ * The S-box circuits, fix_index and the key schedule step come from present_bs/present_core.h, which crypto.c includes
+ * as well. crypto.c itself keeps its OPTIMIZATION_* defines, since the firmware has room for one configuration only.
+ */
+namespace present
+{
+
+/**
+ * @brief Constants of a slice register.
+ *
+ * Word is the row of a tile for the transposition, 32 bits for a 32-bit register and 64 bits for anything wider.
+ */
+template <typename SliceT> struct SliceTraits;
+
+template <> struct SliceTraits<uint32_t>
+{
+    using Word = uint32_t;
+
+    static uint32_t ones() { return UINT32_MAX; }
+};
+
+template <> struct SliceTraits<uint64_t>
+{
+    using Word = uint64_t;
+
+    static uint64_t ones() { return UINT64_MAX; }
+};
+
+#ifdef __SSE2__
+// SSE2 register like __m128i, which cannot be a template argument itself because its may_alias attribute would be lost.
+typedef long long Slice128 __attribute__((vector_size(16)));
+
+template <> struct SliceTraits<Slice128>
+{
+    using Word = uint64_t;
+
+    static Slice128 ones() { return Slice128{-1, -1}; }
+};
+#endif
+
+// AVX2 and AVX-512 registers, only in the translation units built for them, see engines().
+#ifdef __AVX2__
+typedef long long Slice256 __attribute__((vector_size(32)));
+
+template <> struct SliceTraits<Slice256>
+{
+    using Word = uint64_t;
+
+    static Slice256 ones() { return Slice256{-1, -1, -1, -1}; }
+};
+#endif
+
+#ifdef __AVX512F__
+typedef long long Slice512 __attribute__((vector_size(64)));
+
+template <> struct SliceTraits<Slice512>
+{
+    using Word = uint64_t;
+
+    static Slice512 ones() { return Slice512{-1, -1, -1, -1, -1, -1, -1, -1}; }
+};
+#endif
+
+/**
+ * S-box of OPTIMIZATION_SBOX, SBOX_CIRCUIT and INV_SBOX_CIRCUIT of gen_sbox_circuit.py.
+ */
+struct SboxCircuit
+{
+    static constexpr const char *name = "circuit";
+
+    template <typename T> static void forward(T &x0, T &x1, T &x2, T &x3) { SBOX_CIRCUIT(T, x0, x1, x2, x3); }
+
+    template <typename T> static void inverse(T &x0, T &x1, T &x2, T &x3) { INV_SBOX_CIRCUIT(T, x0, x1, x2, x3); }
+};
+
+/**
+ * S-box without OPTIMIZATION_SBOX, SBOX_ANF and INV_SBOX_ANF of the ANF of gen_sbox_ANF.py.
+ */
+struct SboxAnf
+{
+    static constexpr const char *name = "anf";
+
+    template <typename T> static void forward(T &x0, T &x1, T &x2, T &x3) { SBOX_ANF(T, x0, x1, x2, x3); }
+
+    template <typename T> static void inverse(T &x0, T &x1, T &x2, T &x3) { INV_SBOX_ANF(T, x0, x1, x2, x3); }
+};
+
+/**
+ * @brief The optimizations of present_bs as one template parameter.
+ *
+ * Sbox        SboxCircuit for OPTIMIZATION_SBOX, or SboxAnf
+ * Unroll      OPTIMIZATION_UNFOLD_LOOP: rounds, S-boxes and the transposition are unrolled at compile time
+ * Threads     OPTIMIZATION_MULTICORE with 2: the batches of a call are shared by that many threads. Sharing the rounds
+ *             of one batch like on the pico needs a barrier per round, which costs far more than a round with threads.
+ */
+template <typename Sbox, bool Unroll, unsigned Threads> struct Policy
+{
+    static_assert(Threads >= 1, "at least one thread");
+
+    using sbox = Sbox;
+
+    static constexpr bool unroll = Unroll;
+    static constexpr unsigned threads = Threads;
+};
+
+namespace detail
+{
+
+template <typename F, size_t... I> inline void unrolled(F &&f, std::index_sequence<I...>)
+{
+    (f(std::integral_constant<size_t, I>{}), ...);
+}
+
+/**
+ * @brief Call f(i) for i from 0 to N - 1, with i as a compile-time constant if Unroll.
+ */
+template <bool Unroll, size_t N, typename F> inline void repeat(F &&f)
+{
+    if constexpr (Unroll)
+    {
+        unrolled(f, std::make_index_sequence<N>{});
+    }
+    else
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            f(i);
+        }
+    }
+}
+
+/**
+ * @brief key_schedule_step of present_core.h on the key register hi:lo.
+ *
+ * Defined in present_engine.cpp, so it is not built with the instructions of the AVX translation units as well.
+ *
+ * @param hi leftmost 64 bits of the key register
+ * @param lo remaining bits of the key register
+ * @param r round counter
+ * @param key_bits 80 or 128
+ */
+void update_round_key(uint64_t &hi, uint64_t &lo, unsigned r, unsigned key_bits);
+
+/**
+ * @brief Run part(ctx, t) for t = 0 to parts - 1, part 0 on the calling thread and the others on worker threads.
+ *
+ * Like the persistent worker of core1 in present_bs, the workers are started on the first call and then wait for
+ * parts for the rest of the process, so a call only costs a wake-up instead of creating and joining a thread. While
+ * another thread has the workers, or if there are fewer of them than parts - 1, all parts run on the calling thread.
+ *
+ * @param parts number of parts
+ * @param part function of one part
+ * @param ctx argument of part
+ */
+void run_parts(unsigned parts, void (*part)(void *ctx, size_t t), void *ctx);
+
+} // namespace detail
+
+/**
+ * @brief Bitsliced PRESENT.
+ *
+ * @tparam SliceT register of one slice, uint32_t, uint64_t, Slice128, Slice256 or Slice512, which gives the blocks per batch
+ * @tparam KeyBits 80 or 128
+ * @tparam Rounds 31 for PRESENT, fewer for reduced-round variants
+ * @tparam P Policy
+ */
+template <typename SliceT, unsigned KeyBits, unsigned Rounds, typename P> class Present
+{
+    static_assert(KeyBits == 80 || KeyBits == 128, "PRESENT has 80-bit or 128-bit keys");
+    static_assert(Rounds >= 1 && Rounds <= 31, "the round counter of the key schedule has 5 bits");
+
+public:
+    using Policy = P;
+
+    static constexpr size_t BLOCK_SIZE = 8;
+    static constexpr size_t KEY_SIZE = KeyBits / 8;
+    static constexpr size_t WIDTH = sizeof(SliceT) * 8;
+    static constexpr size_t BATCH_SIZE = BLOCK_SIZE * WIDTH;
+
+    /**
+     * @brief Run the key schedule once for all rounds.
+     *
+     * @param key KEY_SIZE bytes
+     */
+    explicit Present(const uint8_t *key)
+    {
+        uint64_t hi, lo = 0;
+
+        std::memcpy(&lo, key, KEY_SIZE - BLOCK_SIZE);
+        std::memcpy(&hi, key + KEY_SIZE - BLOCK_SIZE, BLOCK_SIZE);
+
+        for (unsigned r = 0; r <= Rounds; r++)
+        {
+            // Stored in the slice order of round r + 1, so the XOR does not need fix_index.
+            for (size_t i = 0; i < 64; i++)
+            {
+                round_keys_[r][fix_index(i, r % 3)] = (hi >> i) & 1 ? SliceTraits<SliceT>::ones() : SliceT{};
+            }
+
+            if (r < Rounds)
+            {
+                detail::update_round_key(hi, lo, r + 1, KeyBits);
+            }
+        }
+    }
+
+    /**
+     * @brief Encrypt whole batches in place.
+     *
+     * @param blocks batches * BATCH_SIZE bytes
+     * @param batches number of batches
+     */
+    void encrypt(uint8_t *blocks, size_t batches) const
+    {
+        for_batches(blocks, batches, [this](uint8_t *batch) { encrypt_batch(batch); });
+    }
+
+    /**
+     * @brief Decrypt whole batches in place.
+     *
+     * @param blocks batches * BATCH_SIZE bytes
+     * @param batches number of batches
+     */
+    void decrypt(uint8_t *blocks, size_t batches) const
+    {
+        for_batches(blocks, batches, [this](uint8_t *batch) { decrypt_batch(batch); });
+    }
+
+private:
+    using Word = typename SliceTraits<SliceT>::Word;
+    using State = std::array<SliceT, 64>;
+
+    static constexpr size_t WORD_BITS = sizeof(Word) * 8;
+    static constexpr size_t WORDS = WIDTH / WORD_BITS;
+    static constexpr size_t TILES = 64 / WORD_BITS;
+    static constexpr size_t LEVELS = WORD_BITS == 32 ? 5 : 6;
+
+    /**
+     * @brief Mask of the low half of every group of 2 * h bits.
+     */
+    static constexpr Word swap_mask(size_t h)
+    {
+        Word mask = 0;
+
+        for (size_t i = 0; i < WORD_BITS; i++)
+        {
+            if ((i / h) % 2 == 0)
+            {
+                mask |= Word(1) << i;
+            }
+        }
+
+        return mask;
+    }
+
+    /**
+     * @brief transpose of present_bs, the transposition of Eklundh.
+     */
+    static void transpose(Word m[WORD_BITS])
+    {
+        detail::repeat<P::unroll, LEVELS>([&](auto level) {
+            const size_t h = WORD_BITS >> (level + 1);
+            const Word mask = swap_mask(h);
+
+            detail::repeat<P::unroll, WORD_BITS / 2>([&](auto k) {
+                const size_t r = ((k & ~(h - 1)) << 1) | (k & (h - 1));
+                Word t = ((m[r] >> h) ^ m[r + h]) & mask;
+
+                m[r + h] ^= t;
+                m[r] ^= t << h;
+            });
+        });
+    }
+
+    static void enslice(const uint8_t *blocks, State &state, size_t phase)
+    {
+        for (size_t g = 0; g < WORDS; g++)
+        {
+            for (size_t t = 0; t < TILES; t++)
+            {
+                Word m[WORD_BITS];
+
+                for (size_t j = 0; j < WORD_BITS; j++)
+                {
+                    std::memcpy(&m[j], blocks + (g * WORD_BITS + j) * BLOCK_SIZE + t * sizeof(Word), sizeof(Word));
+                }
+
+                transpose(m);
+
+                for (size_t i = 0; i < WORD_BITS; i++)
+                {
+                    std::memcpy(reinterpret_cast<uint8_t *>(&state[fix_index(t * WORD_BITS + i, phase)]) +
+                                    g * sizeof(Word), &m[i], sizeof(Word));
+                }
+            }
+        }
+    }
+
+    static void unslice(const State &state, uint8_t *blocks, size_t phase)
+    {
+        for (size_t g = 0; g < WORDS; g++)
+        {
+            for (size_t t = 0; t < TILES; t++)
+            {
+                Word m[WORD_BITS];
+
+                for (size_t i = 0; i < WORD_BITS; i++)
+                {
+                    std::memcpy(&m[i], reinterpret_cast<const uint8_t *>(&state[fix_index(t * WORD_BITS + i, phase)]) +
+                                    g * sizeof(Word), sizeof(Word));
+                }
+
+                transpose(m);
+
+                for (size_t j = 0; j < WORD_BITS; j++)
+                {
+                    std::memcpy(blocks + (g * WORD_BITS + j) * BLOCK_SIZE + t * sizeof(Word), &m[j], sizeof(Word));
+                }
+            }
+        }
+    }
+
+    static void add_round_key(State &state, const State &round_key)
+    {
+        detail::repeat<P::unroll, 64>([&](auto i) { state[i] ^= round_key[i]; });
+    }
+
+    void encrypt_batch(uint8_t *blocks) const
+    {
+        State state;
+
+        enslice(blocks, state, 0);
+
+        detail::repeat<P::unroll, Rounds>([&](auto r) {
+            const size_t phase = r % 3;
+
+            add_round_key(state, round_keys_[r]);
+
+            detail::repeat<P::unroll, 16>([&](auto s) {
+                P::sbox::forward(state[fix_index(s * 4, phase)], state[fix_index(s * 4 + 1, phase)],
+                                 state[fix_index(s * 4 + 2, phase)], state[fix_index(s * 4 + 3, phase)]);
+            });
+        });
+
+        add_round_key(state, round_keys_[Rounds]);
+        unslice(state, blocks, Rounds % 3);
+    }
+
+    void decrypt_batch(uint8_t *blocks) const
+    {
+        State state;
+
+        enslice(blocks, state, Rounds % 3);
+        add_round_key(state, round_keys_[Rounds]);
+
+        detail::repeat<P::unroll, Rounds>([&](auto i) {
+            const size_t r = Rounds - 1 - i;
+            const size_t phase = r % 3;
+
+            detail::repeat<P::unroll, 16>([&](auto s) {
+                P::sbox::inverse(state[fix_index(s * 4, phase)], state[fix_index(s * 4 + 1, phase)],
+                                 state[fix_index(s * 4 + 2, phase)], state[fix_index(s * 4 + 3, phase)]);
+            });
+
+            add_round_key(state, round_keys_[r]);
+        });
+
+        unslice(state, blocks, 0);
+    }
+
+    /**
+     * @brief Call f on each batch, with the batches split into P::threads contiguous parts, see detail::run_parts.
+     */
+    template <typename F> void for_batches(uint8_t *blocks, size_t batches, F f) const
+    {
+        auto part = [&](size_t t) {
+            for (size_t b = batches * t / P::threads; b < batches * (t + 1) / P::threads; b++)
+            {
+                f(blocks + b * BATCH_SIZE);
+            }
+        };
+
+        if constexpr (P::threads > 1)
+        {
+            if (batches > 1)
+            {
+                detail::run_parts(
+                    P::threads, [](void *ctx, size_t t) { (*static_cast<decltype(part) *>(ctx))(t); }, &part);
+
+                return;
+            }
+        }
+
+        for (size_t b = 0; b < batches; b++)
+        {
+            f(blocks + b * BATCH_SIZE);
+        }
+    }
+
+    std::array<State, Rounds + 1> round_keys_;
+};
+
+/**
+ * Any Present behind one interface, to pick a configuration at runtime.
+ */
+class Engine
+{
+public:
+    virtual ~Engine() = default;
+
+    /**
+     * @brief Blocks per batch.
+     */
+    virtual size_t width() const = 0;
+
+    /**
+     * @brief Encrypt whole batches in place, see Present::encrypt.
+     */
+    virtual void encrypt(uint8_t *blocks, size_t batches) const = 0;
+
+    /**
+     * @brief Decrypt whole batches in place, see Present::decrypt.
+     */
+    virtual void decrypt(uint8_t *blocks, size_t batches) const = 0;
+};
+
+/**
+ * @brief Engine of one instance of Present.
+ */
+template <typename PresentT> class EngineOf final : public Engine
+{
+public:
+    explicit EngineOf(const uint8_t *key) : present_(key) {}
+
+    size_t width() const override { return PresentT::WIDTH; }
+
+    void encrypt(uint8_t *blocks, size_t batches) const override { present_.encrypt(blocks, batches); }
+
+    void decrypt(uint8_t *blocks, size_t batches) const override { present_.decrypt(blocks, batches); }
+
+private:
+    PresentT present_;
+};
+
+/**
+ * @brief Encrypt whole batches in place under key, with a key schedule on the stack that is gone after the call.
+ */
+using EncryptFunc = void (*)(uint8_t *blocks, size_t batches, const uint8_t *key);
+
+/**
+ * @brief Configuration in the list of engines().
+ */
+struct EngineInfo
+{
+    // Like "w64-k80-circuit-unrolled-t2": blocks per batch, key bits, S-box, loops and threads.
+    std::string name;
+    // The same without the key bits, like "w64-circuit-unrolled-t2", which is what PRESENT_ENGINE selects.
+    std::string kernel;
+    size_t width;
+    size_t key_size;
+    // Whether the running CPU has the instructions of the configuration.
+    bool supported;
+    std::unique_ptr<Engine> (*make)(const uint8_t *key);
+    EncryptFunc encrypt;
+};
+
+namespace detail
+{
+
+/**
+ * @brief A configuration as plain data, so the translation units built for AVX2 and AVX-512 share no code with the
+ * rest of the library except their own instances of Present.
+ */
+struct EngineEntry
+{
+    size_t width;
+    unsigned key_bits;
+    const char *sbox;
+    bool unroll;
+    unsigned threads;
+    std::unique_ptr<Engine> (*make)(const uint8_t *key);
+    EncryptFunc encrypt;
+};
+
+// Configurations per register: 2 key sizes x 2 S-boxes x 2 loops x 2 thread counts.
+constexpr size_t ENTRIES_PER_SLICE = 16;
+
+template <typename PresentT> std::unique_ptr<Engine> make(const uint8_t *key)
+{
+    return std::make_unique<EngineOf<PresentT>>(key);
+}
+
+template <typename PresentT> void encrypt(uint8_t *blocks, size_t batches, const uint8_t *key)
+{
+    PresentT(key).encrypt(blocks, batches);
+}
+
+template <typename PresentT> constexpr EngineEntry entry()
+{
+    using P = typename PresentT::Policy;
+
+    return {PresentT::WIDTH, unsigned(PresentT::KEY_SIZE * 8), P::sbox::name, P::unroll, P::threads, make<PresentT>,
+            encrypt<PresentT>};
+}
+
+template <typename SliceT, unsigned KeyBits, typename Sbox, bool Unroll, unsigned Threads>
+constexpr EngineEntry entry_of()
+{
+    return entry<Present<SliceT, KeyBits, 31, Policy<Sbox, Unroll, Threads>>>();
+}
+
+/**
+ * @brief Every policy for one register, in the order of the OPTIMIZATION_* bits of present_bs.
+ */
+template <typename SliceT> constexpr std::array<EngineEntry, ENTRIES_PER_SLICE> entries_of()
+{
+    return {
+        entry_of<SliceT, 80, SboxAnf, false, 1>(),      entry_of<SliceT, 80, SboxCircuit, false, 1>(),
+        entry_of<SliceT, 80, SboxAnf, false, 2>(),      entry_of<SliceT, 80, SboxCircuit, false, 2>(),
+        entry_of<SliceT, 80, SboxAnf, true, 1>(),       entry_of<SliceT, 80, SboxCircuit, true, 1>(),
+        entry_of<SliceT, 80, SboxAnf, true, 2>(),       entry_of<SliceT, 80, SboxCircuit, true, 2>(),
+        entry_of<SliceT, 128, SboxAnf, false, 1>(),     entry_of<SliceT, 128, SboxCircuit, false, 1>(),
+        entry_of<SliceT, 128, SboxAnf, false, 2>(),     entry_of<SliceT, 128, SboxCircuit, false, 2>(),
+        entry_of<SliceT, 128, SboxAnf, true, 1>(),      entry_of<SliceT, 128, SboxCircuit, true, 1>(),
+        entry_of<SliceT, 128, SboxAnf, true, 2>(),      entry_of<SliceT, 128, SboxCircuit, true, 2>(),
+    };
+}
+
+// Defined in present_engine_avx2.cpp and present_engine_avx512.cpp, which are only built for x86.
+extern const std::array<EngineEntry, ENTRIES_PER_SLICE> entries_avx2;
+extern const std::array<EngineEntry, ENTRIES_PER_SLICE> entries_avx512;
+
+// Configurations of present_vperm.h per register: 2 key sizes.
+constexpr size_t VPERM_ENTRIES = 2;
+
+// Defined in present_vperm_ssse3.cpp and present_vperm_avx2.cpp, which are only built for x86.
+extern const std::array<EngineEntry, VPERM_ENTRIES> entries_vperm_ssse3;
+extern const std::array<EngineEntry, VPERM_ENTRIES> entries_vperm_avx2;
+
+} // namespace detail
+
+/**
+ * @brief All configurations built into the library, PRESENT-80 and PRESENT-128 with 31 rounds.
+ *
+ * 32-bit and 64-bit registers are always there, 128-bit ones with SSE2. On x86 the library also has AVX2 and AVX-512
+ * configurations, built in their own translation units, which are only supported if the running CPU has them. The
+ * same holds for Vperm of present_vperm.h with SSSE3 and AVX2, like "w4-k80-vpshufb-loop-t1".
+ */
+const std::vector<EngineInfo> &engines();
+
+/**
+ * @brief Engine of a configuration of engines() by name.
+ *
+ * Unknown names and configurations the CPU does not support are thrown as std::invalid_argument.
+ *
+ * @param name name of the configuration
+ * @param key key_size bytes of the configuration
+ *
+ * @return engine with the key schedule done
+ */
+std::unique_ptr<Engine> make_engine(const std::string &name, const uint8_t *key);
+
+/**
+ * @brief Configuration for this CPU, picked once per key size on the first call with that key size.
+ *
+ * Without PRESENT_ENGINE it is the widest supported register with the S-box circuit and unrolled loops, with 2 threads
+ * if the host has more than one CPU. PRESENT_ENGINE can name any supported configuration of engines() instead, with
+ * or without the key bits, like "w128-anf-loop-t1" or "w128-k80-anf-loop-t1". A name with key bits selects its kernel
+ * for both key sizes, so "w128-k80-anf-loop-t1" gives "w128-k128-anf-loop-t1" for 16-byte keys. Other values are
+ * thrown as std::invalid_argument.
+ *
+ * @param key_size 10 or 16
+ *
+ * @return configuration
+ */
+const EngineInfo &dispatch(size_t key_size);
+
+/**
+ * @brief Configuration for requests of a few blocks, picked once per key size on the first call.
+ *
+ * The widest supported Vperm of present_vperm.h, which has 2 or 4 blocks per batch and no transposition, so a single
+ * block costs far less than with the 32 to 512 blocks of a batch of dispatch. Without SSSE3 it is dispatch(key_size).
+ *
+ * @param key_size 10 or 16
+ *
+ * @return configuration
+ */
+const EngineInfo &dispatch_blocks(size_t key_size);
+
+/**
+ * @brief crypto_func of present_bs with the configuration of dispatch(10), for 10-byte keys.
+ *
+ * The first call resolves EngineInfo::encrypt of the configuration into a function pointer, and every call after that
+ * is only the indirect call, with nothing checked or cached per call. Each call runs the key schedule of its key into
+ * round key masks on the stack, which costs about as much time as one batch and up to 128 KiB of stack with
+ * Slice512. Callers that encrypt under one key again and again should keep dispatch(10).make(key) instead, like an
+ * expanded key of present_bs.
+ *
+ * @param blocks batches * dispatch(10).width blocks, encrypted in place
+ * @param batches number of batches
+ * @param key 10 bytes
+ */
+void crypto_func(uint8_t *blocks, size_t batches, const uint8_t *key);
+
+/**
+ * @brief crypto_func with the configuration of dispatch(16), for 16-byte keys.
+ */
+void crypto_func_128(uint8_t *blocks, size_t batches, const uint8_t *key);
+
+} // namespace present
+
+#endif
@@ -0,0 +1,19 @@
+// Configurations of present_engine.cpp for Slice256, built with -mavx2 on x86 only. engines() marks them as
+// unsupported on CPUs without these instructions, so nothing of this file runs there.
+#include "present_engine.h"
+
+#ifndef __AVX2__
+#error "present_engine_avx2.cpp needs -mavx2"
+#endif
+
+namespace present
+{
+
+namespace detail
+{
+
+const std::array<EngineEntry, ENTRIES_PER_SLICE> entries_avx2 = entries_of<Slice256>();
+
+} // namespace detail
+
+} // namespace present
@@ -0,0 +1,19 @@
+// Configurations of present_engine.cpp for Slice512, built with -mavx512f on x86 only. engines() marks them as
+// unsupported on CPUs without these instructions, so nothing of this file runs there.
+#include "present_engine.h"
+
+#ifndef __AVX512F__
+#error "present_engine_avx512.cpp needs -mavx512f"
+#endif
+
+namespace present
+{
+
+namespace detail
+{
+
+const std::array<EngineEntry, ENTRIES_PER_SLICE> entries_avx512 = entries_of<Slice512>();
+
+} // namespace detail
+
+} // namespace present
@@ -0,0 +1,195 @@
+#ifndef __PRESENT_VPERM_H
+#define __PRESENT_VPERM_H
+
+#include "present_engine.h"
+
+/**
+ * PRESENT with byte shuffles for the host, for requests of a few blocks.
+ *
+ * Present needs 32 to 512 blocks per batch and transposes them into slices, which a request of one or two blocks pays
+ * for in full. Vperm keeps each block as it is in a 64-bit lane of a vector register instead. The S-box of all 16
+ * nibbles of all blocks of the register is one byte shuffle (pshufb) of a 16-byte table for the low nibbles and one
+ * for the high nibbles, and the bit permutation is the four delta swaps of OPTIMIZATION_NIBBLE_SLICE of present_ref
+ * with 64-bit shifts.
+ *
+ * The instructions come from an Ops type of the translation unit built for them, see present_vperm_ssse3.cpp and
+ * present_vperm_avx2.cpp. Ops has the register Vec, BLOCKS per register, a name, load, store, broadcast of a 64-bit
+ * word, table of a 16-byte table in every 128-bit lane, shuffle, and srl and sll of the 64-bit lanes.
+ */
+namespace present
+{
+
+/**
+ * @brief PRESENT of one register of blocks with byte shuffles.
+ *
+ * @tparam Ops instructions of the register
+ * @tparam KeyBits 80 or 128
+ */
+template <typename Ops, unsigned KeyBits> class Vperm
+{
+    static_assert(KeyBits == 80 || KeyBits == 128, "PRESENT has 80-bit or 128-bit keys");
+
+public:
+    static constexpr size_t BLOCK_SIZE = 8;
+    static constexpr size_t KEY_SIZE = KeyBits / 8;
+    static constexpr size_t WIDTH = Ops::BLOCKS;
+    static constexpr size_t BATCH_SIZE = BLOCK_SIZE * WIDTH;
+    static constexpr unsigned ROUNDS = 31;
+
+    /**
+     * @brief Run the key schedule once for all rounds and set up the shuffle tables.
+     *
+     * @param key KEY_SIZE bytes
+     */
+    explicit Vperm(const uint8_t *key)
+    {
+        uint64_t hi, lo = 0;
+
+        std::memcpy(&lo, key, KEY_SIZE - BLOCK_SIZE);
+        std::memcpy(&hi, key + KEY_SIZE - BLOCK_SIZE, BLOCK_SIZE);
+
+        for (unsigned r = 0; r <= ROUNDS; r++)
+        {
+            round_keys_[r] = Ops::broadcast(hi);
+
+            if (r < ROUNDS)
+            {
+                detail::update_round_key(hi, lo, r + 1, KeyBits);
+            }
+        }
+
+        uint8_t tables[4][16];
+
+        for (unsigned x = 0; x < 16; x++)
+        {
+            tables[0][x] = present_sbox[x];
+            tables[1][x] = uint8_t(present_sbox[x] << 4);
+            tables[2][present_sbox[x]] = uint8_t(x);
+            tables[3][present_sbox[x]] = uint8_t(x << 4);
+        }
+
+        for (unsigned i = 0; i < 4; i++)
+        {
+            tables_[i] = Ops::table(tables[i]);
+        }
+
+        low_nibbles_ = Ops::broadcast(0x0F0F0F0F0F0F0F0FULL);
+    }
+
+    /**
+     * @brief Encrypt whole batches in place.
+     *
+     * @param blocks batches * BATCH_SIZE bytes
+     * @param batches number of batches
+     */
+    void encrypt(uint8_t *blocks, size_t batches) const
+    {
+        for (size_t b = 0; b < batches; b++, blocks += BATCH_SIZE)
+        {
+            Vec s = Ops::load(blocks);
+
+            for (unsigned r = 0; r < ROUNDS; r++)
+            {
+                s = pbox(sbox(s ^ round_keys_[r], tables_[0], tables_[1]));
+            }
+
+            Ops::store(blocks, s ^ round_keys_[ROUNDS]);
+        }
+    }
+
+    /**
+     * @brief Decrypt whole batches in place.
+     *
+     * @param blocks batches * BATCH_SIZE bytes
+     * @param batches number of batches
+     */
+    void decrypt(uint8_t *blocks, size_t batches) const
+    {
+        for (size_t b = 0; b < batches; b++, blocks += BATCH_SIZE)
+        {
+            Vec s = Ops::load(blocks) ^ round_keys_[ROUNDS];
+
+            for (unsigned r = ROUNDS; r-- > 0;)
+            {
+                s = sbox(inv_pbox(s), tables_[2], tables_[3]) ^ round_keys_[r];
+            }
+
+            Ops::store(blocks, s);
+        }
+    }
+
+private:
+    using Vec = typename Ops::Vec;
+
+    /**
+     * @brief The S-box of table on every nibble.
+     *
+     * @param s blocks
+     * @param low S-box of the low nibble of a byte
+     * @param high S-box of the high nibble of a byte, shifted into the high nibble
+     */
+    Vec sbox(Vec s, Vec low, Vec high) const
+    {
+        // The shift carries bits of the next byte into bits 4 to 7, which the mask drops.
+        return Ops::shuffle(low, s & low_nibbles_) | Ops::shuffle(high, Ops::template srl<4>(s) & low_nibbles_);
+    }
+
+    /**
+     * @brief delta_swap of present_ref on every 64-bit lane.
+     */
+    template <int N> static Vec delta_swap(Vec s, uint64_t mask)
+    {
+        Vec t = (Ops::template srl<N>(s) ^ s) & Ops::broadcast(mask);
+
+        return s ^ t ^ Ops::template sll<N>(t);
+    }
+
+    /**
+     * @brief pbox_layer on every block, the swaps of nibble_pbox of present_ref.
+     */
+    static Vec pbox(Vec s)
+    {
+        s = delta_swap<3>(s, 0x0A0A0A0A0A0A0A0AULL);
+        s = delta_swap<6>(s, 0x00CC00CC00CC00CCULL);
+        s = delta_swap<12>(s, 0x0000F0F00000F0F0ULL);
+        return delta_swap<24>(s, 0x00000000FF00FF00ULL);
+    }
+
+    /**
+     * @brief Undo pbox, with its swaps in reverse order.
+     */
+    static Vec inv_pbox(Vec s)
+    {
+        s = delta_swap<24>(s, 0x00000000FF00FF00ULL);
+        s = delta_swap<12>(s, 0x0000F0F00000F0F0ULL);
+        s = delta_swap<6>(s, 0x00CC00CC00CC00CCULL);
+        return delta_swap<3>(s, 0x0A0A0A0A0A0A0A0AULL);
+    }
+
+    Vec round_keys_[ROUNDS + 1];
+    // S-box of the low and the high nibbles, then the same of the inverse S-box.
+    Vec tables_[4];
+    Vec low_nibbles_;
+};
+
+namespace detail
+{
+
+template <typename Ops, unsigned KeyBits> constexpr EngineEntry vperm_entry()
+{
+    return {Ops::BLOCKS, KeyBits, Ops::name, false, 1, make<Vperm<Ops, KeyBits>>, encrypt<Vperm<Ops, KeyBits>>};
+}
+
+/**
+ * @brief PRESENT-80 and PRESENT-128 of one register.
+ */
+template <typename Ops> constexpr std::array<EngineEntry, VPERM_ENTRIES> vperm_entries_of()
+{
+    return {vperm_entry<Ops, 80>(), vperm_entry<Ops, 128>()};
+}
+
+} // namespace detail
+
+} // namespace present
+
+#endif
@@ -0,0 +1,56 @@
+// Configurations of present_vperm.h for 256-bit registers, built with -mavx2 on x86 only. engines() marks them as
+// unsupported on CPUs without these instructions, so nothing of this file runs there.
+#include "present_vperm.h"
+
+#include <immintrin.h>
+
+#ifndef __AVX2__
+#error "present_vperm_avx2.cpp needs -mavx2"
+#endif
+
+namespace present
+{
+
+namespace
+{
+
+/**
+ * @brief Ops of Vperm for AVX2, 4 blocks per register.
+ *
+ * vpshufb shuffles within each 128-bit lane, so the tables are in both lanes.
+ */
+struct OpsAvx2
+{
+    using Vec = __m256i;
+
+    static constexpr size_t BLOCKS = 4;
+    static constexpr const char *name = "vpshufb";
+
+    static Vec load(const uint8_t *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+
+    static void store(uint8_t *p, Vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+
+    static Vec broadcast(uint64_t x) { return _mm256_set1_epi64x((long long)x); }
+
+    static Vec table(const uint8_t t[16])
+    {
+        return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(t)));
+    }
+
+    static Vec shuffle(Vec t, Vec index) { return _mm256_shuffle_epi8(t, index); }
+
+    template <int N> static Vec srl(Vec v) { return _mm256_srli_epi64(v, N); }
+
+    template <int N> static Vec sll(Vec v) { return _mm256_slli_epi64(v, N); }
+};
+
+} // namespace
+
+namespace detail
+{
+
+const std::array<EngineEntry, VPERM_ENTRIES> entries_vperm_avx2 = vperm_entries_of<OpsAvx2>();
+
+} // namespace detail
+
+} // namespace present
@@ -0,0 +1,51 @@
+// Configurations of present_vperm.h for 128-bit registers, built with -mssse3 on x86 only. engines() marks them as
+// unsupported on CPUs without pshufb, so nothing of this file runs there.
+#include "present_vperm.h"
+
+#include <immintrin.h>
+
+#ifndef __SSSE3__
+#error "present_vperm_ssse3.cpp needs -mssse3"
+#endif
+
+namespace present
+{
+
+namespace
+{
+
+/**
+ * @brief Ops of Vperm for SSSE3, 2 blocks per register.
+ */
+struct OpsSsse3
+{
+    using Vec = __m128i;
+
+    static constexpr size_t BLOCKS = 2;
+    static constexpr const char *name = "pshufb";
+
+    static Vec load(const uint8_t *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+
+    static void store(uint8_t *p, Vec v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+
+    static Vec broadcast(uint64_t x) { return _mm_set1_epi64x((long long)x); }
+
+    static Vec table(const uint8_t t[16]) { return load(t); }
+
+    static Vec shuffle(Vec t, Vec index) { return _mm_shuffle_epi8(t, index); }
+
+    template <int N> static Vec srl(Vec v) { return _mm_srli_epi64(v, N); }
+
+    template <int N> static Vec sll(Vec v) { return _mm_slli_epi64(v, N); }
+};
+
+} // namespace
+
+namespace detail
+{
+
+const std::array<EngineEntry, VPERM_ENTRIES> entries_vperm_ssse3 = vperm_entries_of<OpsSsse3>();
+
+} // namespace detail
+
+} // namespace present
@@ -0,0 +1,239 @@
+/**
+ * End-to-end throughput of the serial protocol of present_bs.
+ *
+ * Starts present_bs_host on a pty as a stand-in for the pico, then encrypts the testvectors with the bulk command,
+ * the pipelined bulk command and a round trip per block through present::Client, checks the ciphertexts and prints
+ * all three throughputs. A PRESENT-128 testvector is checked first, so the key size is switched with 'K' both ways.
+ *
+ * Usage: pty_throughput [blocks per key, default 65536]
+ **/
+
+#include "present_client.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef PRESENT_BS_HOST
+#error "PRESENT_BS_HOST must be the path of present_bs_host"
+#endif
+
+#ifndef BITSLICE_WIDTH
+#define BITSLICE_WIDTH 32
+#endif
+
+// Batches sent with the per-block commands, which are too slow for the full amount.
+#define PER_BLOCK_BATCHES 4
+
+static const uint8_t tv_pt[3][present::BLOCK_SIZE] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+    {0x45, 0x84, 0x22, 0x7B, 0x38, 0xC1, 0x79, 0x55},
+};
+
+static const present::Key tv_key[3] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+    {0x3c, 0xf4, 0x00, 0xd8, 0x28, 0xf1, 0x08, 0x7a, 0x60, 0x26},
+};
+
+// All-zero key and plaintext with PRESENT-128
+static const present::Key128 tv_key_128 = {0};
+static const uint8_t tv_ct_128[present::BLOCK_SIZE] = {0xAF, 0x00, 0x69, 0x2E, 0x2A, 0x70, 0xDB, 0x96};
+
+// tv_ct[key][pt]
+static const uint8_t tv_ct[3][3][present::BLOCK_SIZE] = {
+    {
+        {0x45, 0x84, 0x22, 0x7b, 0x38, 0xc1, 0x79, 0x55},
+        {0x7b, 0x41, 0x68, 0x2f, 0xc7, 0xff, 0x12, 0xa1},
+        {0x9a, 0x36, 0xcc, 0x6f, 0xfd, 0x45, 0xdf, 0x4e},
+    },
+    {
+        {0x49, 0x50, 0x94, 0xf5, 0xc0, 0x46, 0x2c, 0xe7},
+        {0xd2, 0x10, 0x32, 0x21, 0xd3, 0xdc, 0x33, 0x33},
+        {0x4e, 0xa8, 0x43, 0x3c, 0xcf, 0x7f, 0x10, 0x25},
+    },
+    {
+        {0x5f, 0x46, 0x65, 0xf3, 0x2d, 0x76, 0xfe, 0x9a},
+        {0xb7, 0xf4, 0x2d, 0x2e, 0xe9, 0x48, 0x66, 0x23},
+        {0xd0, 0x44, 0x6a, 0x0a, 0xc9, 0x13, 0x35, 0xd4},
+    },
+};
+
+/**
+ * @brief Start present_bs_host on a pty.
+ *
+ * @param pid Output: process id
+ *
+ * @return path of the pty
+ */
+static std::string start_device(pid_t *pid)
+{
+    int pipefd[2];
+
+    if (pipe(pipefd) != 0)
+    {
+        perror("pipe");
+        exit(1);
+    }
+
+    *pid = fork();
+
+    if (*pid == 0)
+    {
+        // The device prints the name of the pty to stderr.
+        dup2(pipefd[1], STDERR_FILENO);
+        close(pipefd[0]);
+        close(pipefd[1]);
+        setenv("PRESENT_PTY", "1", 1);
+        execl(PRESENT_BS_HOST, PRESENT_BS_HOST, (char *)NULL);
+        perror("exec");
+        _exit(1);
+    }
+
+    close(pipefd[1]);
+
+    FILE *err = fdopen(pipefd[0], "r");
+    char line[256];
+    const char *prefix = "Serial port: ";
+
+    while (fgets(line, sizeof(line), err) != NULL)
+    {
+        if (strncmp(line, prefix, strlen(prefix)) == 0)
+        {
+            line[strcspn(line, "\n")] = '\0';
+
+            return std::string(line + strlen(prefix));
+        }
+    }
+
+    fprintf(stderr, "[FAILED] No pty from %s\n", PRESENT_BS_HOST);
+    exit(1);
+}
+
+/**
+ * @brief Plaintexts j % 3 and the ciphertexts expected under key k.
+ */
+static void testvectors(size_t k, size_t blocks, std::vector<uint8_t> &pt, std::vector<uint8_t> &ct)
+{
+    pt.resize(blocks * present::BLOCK_SIZE);
+    ct.resize(blocks * present::BLOCK_SIZE);
+
+    for (size_t j = 0; j < blocks; j++)
+    {
+        memcpy(&pt[j * present::BLOCK_SIZE], tv_pt[j % 3], present::BLOCK_SIZE);
+        memcpy(&ct[j * present::BLOCK_SIZE], tv_ct[k][j % 3], present::BLOCK_SIZE);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t blocks = argc > 1 ? strtoul(argv[1], NULL, 0) : 65536;
+    pid_t pid;
+    std::string port = start_device(&pid);
+    int result = 0;
+
+    printf("[+] Device on %s\n", port.c_str());
+
+    try
+    {
+        present::Client client(port);
+        std::vector<uint8_t> pt, ct;
+        double bulk_seconds = 0, pipelined_seconds = 0, per_block_seconds = 0;
+        uint64_t cycles, bulk_cycles = 0, pipelined_cycles = 0;
+
+        pt.assign(BITSLICE_WIDTH * present::BLOCK_SIZE, 0);
+        ct.clear();
+
+        for (size_t j = 0; j < BITSLICE_WIDTH; j++)
+        {
+            ct.insert(ct.end(), tv_ct_128, tv_ct_128 + present::BLOCK_SIZE);
+        }
+
+        if (client.encrypt(tv_key_128, pt) != ct || client.encrypt_per_block(tv_key_128, pt) != ct)
+        {
+            printf("[FAILED] PRESENT-128\n");
+            result = 1;
+        }
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            testvectors(k, blocks, pt, ct);
+
+            auto begin = std::chrono::steady_clock::now();
+            std::vector<uint8_t> out = client.encrypt(tv_key[k], pt, &cycles);
+            auto end = std::chrono::steady_clock::now();
+
+            bulk_seconds += std::chrono::duration<double>(end - begin).count();
+            bulk_cycles += cycles;
+
+            if (out != ct)
+            {
+                printf("[FAILED] Bulk command, key %zu\n", k);
+                result = 1;
+            }
+
+            begin = std::chrono::steady_clock::now();
+            out = client.encrypt_pipelined(tv_key[k], pt, &cycles);
+            end = std::chrono::steady_clock::now();
+
+            pipelined_seconds += std::chrono::duration<double>(end - begin).count();
+            pipelined_cycles += cycles;
+
+            if (out != ct)
+            {
+                printf("[FAILED] Pipelined bulk command, key %zu\n", k);
+                result = 1;
+            }
+
+            testvectors(k, BITSLICE_WIDTH, pt, ct);
+
+            begin = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < PER_BLOCK_BATCHES; i++)
+            {
+                if (client.encrypt_per_block(tv_key[k], pt) != ct)
+                {
+                    printf("[FAILED] Per-block commands, key %zu\n", k);
+                    result = 1;
+                }
+            }
+            end = std::chrono::steady_clock::now();
+
+            per_block_seconds += std::chrono::duration<double>(end - begin).count();
+        }
+
+        double bulk_blocks = 3.0 * blocks;
+        double per_block_blocks = 3.0 * PER_BLOCK_BATCHES * BITSLICE_WIDTH;
+
+        printf("[+] Bulk: %.0f blocks in %.3f s = %.0f blocks/s = %.2f MB/s, %.1f device cycles per block\n",
+               bulk_blocks, bulk_seconds, bulk_blocks / bulk_seconds,
+               bulk_blocks * present::BLOCK_SIZE / bulk_seconds / 1e6, bulk_cycles / bulk_blocks);
+        printf("[+] Pipelined: %.0f blocks in %.3f s = %.0f blocks/s = %.2f MB/s, %.1f device cycles per block waiting for the encryption\n",
+               bulk_blocks, pipelined_seconds, bulk_blocks / pipelined_seconds,
+               bulk_blocks * present::BLOCK_SIZE / pipelined_seconds / 1e6, pipelined_cycles / bulk_blocks);
+        printf("[+] Per block: %.0f blocks in %.3f s = %.0f blocks/s = %.2f MB/s\n",
+               per_block_blocks, per_block_seconds, per_block_blocks / per_block_seconds,
+               per_block_blocks * present::BLOCK_SIZE / per_block_seconds / 1e6);
+    }
+    catch (const std::exception &e)
+    {
+        printf("[FAILED] %s\n", e.what());
+        result = 1;
+    }
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+
+    if (result == 0)
+    {
+        printf("[OK] Result correct\n");
+    }
+
+    return result;
+}
@@ -0,0 +1,186 @@
+#include "instrument.h"
+
+#include <string.h>
+
+// Buckets per power of two, and how many bits of a value select among them.
+#define SUB_BUCKET_BITS 3
+#define SUB_BUCKETS (1u << SUB_BUCKET_BITS)
+
+// Values from 2^33 cycles on, about a minute at 125 MHz, all go into the last bucket.
+#define BUCKETS 256
+
+typedef struct
+{
+    uint32_t buckets[BUCKETS];
+    uint64_t count;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+} histogram_t;
+
+static histogram_t histograms[INSTRUMENT_STAGE_NUM];
+
+static const char *const stage_names[INSTRUMENT_STAGE_NUM] = {
+    "enslice",
+    "add_round_key",
+    "sbox_layer",
+    "pbox_layer",
+    "update_round_key",
+    "barrier",
+    "unslice",
+};
+
+/**
+ * @brief Bucket of a value.
+ *
+ * Values below SUB_BUCKETS have a bucket each. Above, the position of the highest bit selects a power of two and the
+ * next SUB_BUCKET_BITS bits one of its buckets.
+ *
+ * @param v value
+ *
+ * @return bucket index
+ */
+static uint32_t bucket_index(uint64_t v)
+{
+    if (v < SUB_BUCKETS)
+    {
+        return (uint32_t)v;
+    }
+
+    uint32_t e = 63 - __builtin_clzll(v);
+    uint32_t index = (e - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + ((v >> (e - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+
+    return index < BUCKETS ? index : BUCKETS - 1;
+}
+
+/**
+ * @brief Smallest value of a bucket, the inverse of bucket_index.
+ *
+ * @param index bucket index
+ *
+ * @return smallest value that goes into the bucket
+ */
+static uint64_t bucket_floor(uint32_t index)
+{
+    if (index < SUB_BUCKETS)
+    {
+        return index;
+    }
+
+    uint32_t e = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+
+    return (uint64_t)(SUB_BUCKETS + index % SUB_BUCKETS) << (e - SUB_BUCKET_BITS);
+}
+
+/**
+ * @brief Value below which at least a share of all measurements are, as the floor of its bucket.
+ *
+ * @param h histogram with at least one measurement
+ * @param per_mille share in 1/1000
+ *
+ * @return percentile, between min and max
+ */
+static uint64_t percentile(const histogram_t *h, uint32_t per_mille)
+{
+    uint64_t rank = (h->count * per_mille + 999) / 1000;
+    uint64_t seen = 0;
+    uint32_t i;
+
+    for (i = 0; i < BUCKETS - 1; i++)
+    {
+        seen += h->buckets[i];
+
+        if (seen >= rank)
+        {
+            break;
+        }
+    }
+
+    uint64_t v = bucket_floor(i);
+
+    return v < h->min ? h->min : (v > h->max ? h->max : v);
+}
+
+void instrument_record(instrument_stage_t stage, uint64_t cycles)
+{
+    if (platform_core_num() != 0)
+    {
+        return;
+    }
+
+    histogram_t *h = &histograms[stage];
+
+    if (h->count == 0 || cycles < h->min)
+    {
+        h->min = cycles;
+    }
+
+    if (cycles > h->max)
+    {
+        h->max = cycles;
+    }
+
+    h->count++;
+    h->total += cycles;
+    h->buckets[bucket_index(cycles)]++;
+}
+
+void instrument_stats(instrument_stage_t stage, instrument_stats_t *stats)
+{
+    const histogram_t *h = &histograms[stage];
+
+    memset(stats, 0, sizeof(*stats));
+
+    if (h->count == 0)
+    {
+        return;
+    }
+
+    stats->count = h->count;
+    stats->total = h->total;
+    stats->min = h->min;
+    stats->median = percentile(h, 500);
+    stats->p99 = percentile(h, 990);
+    stats->max = h->max;
+}
+
+const char *instrument_stage_name(instrument_stage_t stage)
+{
+    return stage_names[stage];
+}
+
+void instrument_reset(void)
+{
+    memset(histograms, 0, sizeof(histograms));
+}
+
+void instrument_dump(void)
+{
+#ifdef INSTRUMENT
+    platform_putchar_raw(INSTRUMENT_STAGE_NUM);
+
+    for (uint8_t s = 0; s < INSTRUMENT_STAGE_NUM; s++)
+    {
+        instrument_stats_t stats;
+
+        instrument_stats((instrument_stage_t)s, &stats);
+
+        const uint64_t fields[6] = {stats.count, stats.total, stats.min, stats.median, stats.p99, stats.max};
+        uint8_t buf[sizeof(fields)];
+
+        for (uint8_t f = 0; f < 6; f++)
+        {
+            for (uint8_t b = 0; b < 8; b++)
+            {
+                buf[f * 8 + b] = (uint8_t)(fields[f] >> (8 * b));
+            }
+        }
+
+        platform_write(buf, sizeof(buf));
+    }
+
+    instrument_reset();
+#else
+    platform_putchar_raw(0);
+#endif
+}
@@ -0,0 +1,93 @@
+#ifndef __INSTRUMENT_H
+#define __INSTRUMENT_H
+
+#include <stdint.h>
+
+#include "platform.h"
+
+/**
+ * Cycles per stage of the cipher, shared by present_ref and present_bs.
+ *
+ * Built with INSTRUMENT defined (cmake -DPRESENT_INSTRUMENT=ON), each stage measures itself with INSTRUMENT_BEGIN and
+ * INSTRUMENT_END and every measurement goes into a histogram of its stage. Without INSTRUMENT both macros are empty
+ * and nothing is recorded, so the cipher runs exactly as before.
+ *
+ * Only core0 records, because SysTick is private to each core and only set up on core0 (see platform_cpucycles).
+ * Work done by core1 alone, like present_encrypt_start, is not seen.
+ *
+ * The histograms are log-linear with 8 buckets per power of two, so median and p99 are rounded down by less than 1/8.
+ * count, total, min and max are exact.
+ */
+
+typedef enum
+{
+    INSTRUMENT_ENSLICE,
+    INSTRUMENT_ADD_ROUND_KEY,
+    // With the SP table of present_ref, the whole substitution-permutation layer. add_round_key is one XOR there and not measured.
+    INSTRUMENT_SBOX_LAYER,
+    // Only in present_ref without the SP table, the permutation of present_bs is free.
+    INSTRUMENT_PBOX_LAYER,
+    INSTRUMENT_UPDATE_ROUND_KEY,
+    // Time core0 waits for core1 at a barrier.
+    INSTRUMENT_BARRIER,
+    INSTRUMENT_UNSLICE,
+    INSTRUMENT_STAGE_NUM
+} instrument_stage_t;
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t total;
+    uint64_t min;
+    uint64_t median;
+    uint64_t p99;
+    uint64_t max;
+} instrument_stats_t;
+
+#ifdef INSTRUMENT
+#define INSTRUMENT_BEGIN() uint64_t instrument_begin = platform_cpucycles()
+#define INSTRUMENT_END(stage) instrument_record((stage), (platform_cpucycles() - instrument_begin) & PLATFORM_CYCLES_MASK)
+#else
+#define INSTRUMENT_BEGIN() do { } while (0)
+#define INSTRUMENT_END(stage) do { } while (0)
+#endif
+
+/**
+ * @brief Add one measurement to the histogram of a stage. Ignored on core1.
+ *
+ * @param stage stage
+ * @param cycles duration in cycles
+ */
+void instrument_record(instrument_stage_t stage, uint64_t cycles);
+
+/**
+ * @brief Statistics of a stage since the last instrument_reset.
+ *
+ * @param stage stage
+ * @param stats Output: statistics, all zero if nothing was recorded
+ */
+void instrument_stats(instrument_stage_t stage, instrument_stats_t *stats);
+
+/**
+ * @brief Name of a stage, like "sbox_layer".
+ *
+ * @param stage stage
+ *
+ * @return name
+ */
+const char *instrument_stage_name(instrument_stage_t stage);
+
+/**
+ * @brief Clear all histograms.
+ */
+void instrument_reset(void);
+
+/**
+ * @brief Answer of the 'I' command, then instrument_reset.
+ *
+ * One byte with the number of stages, INSTRUMENT_STAGE_NUM or 0 when built without INSTRUMENT, then for each stage
+ * count, total, min, median, p99 and max as 8 bytes little endian each.
+ */
+void instrument_dump(void);
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef __PLATFORM_H
+#define __PLATFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Platform layer shared by present_ref and present_bs.
+ *
+ * The firmware command loop and the multicore code in crypto.c only talk to the hardware through the functions below.
+ * There are two backends:
+ *
+ * platform_pico.c  pico-sdk: USB/UART serial, SysTick, LED on GPIO 25, second core through the inter-core FIFO.
+ * platform_host.c  Linux (PLATFORM_HOST): stdin/stdout or a pty, rdtsc/clock_gettime, second core emulated by a thread.
+ */
+
+// Returned by platform_getchar_timeout_us when no byte arrived in time.
+#define PLATFORM_ERROR_TIMEOUT (-1)
+
+// The cycle counter is a full 64-bit counter on both backends, see platform_cpucycles.
+#define PLATFORM_CYCLES_MASK UINT64_MAX
+
+#ifdef PLATFORM_HOST
+#include <stdio.h>
+
+// Log messages must not end up in the binary transport on the host.
+#define platform_log(...) fprintf(stderr, __VA_ARGS__)
+
+/**
+ * @brief Push a word to the FIFO read by the other core. Block while the FIFO is full.
+ *
+ * @param data word to push, wide enough to carry a pointer
+ */
+void platform_fifo_push_blocking(uintptr_t data);
+
+/**
+ * @brief Pop a word from the FIFO written by the other core. Block while the FIFO is empty.
+ *
+ * @return popped word
+ */
+uintptr_t platform_fifo_pop_blocking(void);
+
+/**
+ * @brief Start entry on the second core.
+ *
+ * @param entry function run by core1
+ */
+void platform_core1_launch(void (*entry)(void));
+
+/**
+ * @brief Wait until core1 has stopped and clear both FIFOs.
+ */
+void platform_core1_reset(void);
+
+/**
+ * @brief Number of the calling core.
+ *
+ * @return 0 for the main thread, 1 for the thread started by platform_core1_launch
+ */
+uint8_t platform_core_num(void);
+#else
+#include <stdio.h>
+
+#include "pico/multicore.h"
+
+#define platform_log(...) printf(__VA_ARGS__)
+
+#define platform_fifo_push_blocking(data) multicore_fifo_push_blocking((uint32_t)(data))
+#define platform_fifo_pop_blocking() ((uintptr_t)multicore_fifo_pop_blocking())
+#define platform_core1_launch(entry) multicore_launch_core1(entry)
+#define platform_core1_reset() multicore_reset_core1()
+#define platform_core_num() ((uint8_t)get_core_num())
+#endif
+
+/**
+ * @brief Bring up transport, cycle counter and LED.
+ */
+void platform_init(void);
+
+/**
+ * @brief Read one byte from the transport.
+ *
+ * @param timeout_us timeout in microseconds
+ *
+ * @return byte value or PLATFORM_ERROR_TIMEOUT
+ */
+int platform_getchar_timeout_us(uint32_t timeout_us);
+
+/**
+ * @brief Write one byte to the transport without any translation.
+ *
+ * @param c byte value
+ */
+void platform_putchar_raw(uint8_t c);
+
+/**
+ * @brief Read len bytes from the transport, however long it takes.
+ *
+ * @param buf Output: bytes read
+ * @param len number of bytes
+ */
+void platform_read_blocking(uint8_t *buf, size_t len);
+
+/**
+ * @brief Write len bytes to the transport without any translation.
+ *
+ * @param buf bytes to write
+ * @param len number of bytes
+ */
+void platform_write(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Switch the status LED.
+ *
+ * @param on true to switch the LED on
+ */
+void platform_led_put(bool on);
+
+/**
+ * @brief Read the cycle counter.
+ *
+ * The counter increases. Only the bits in PLATFORM_CYCLES_MASK are valid, so a duration is
+ * (end - begin) & PLATFORM_CYCLES_MASK.
+ *
+ * On the pico the 24-bit SysTick is extended to 64 bits by counting its wraps in an interrupt, so durations longer
+ * than 2^24 cycles are right as well. SysTick is private to each core and only set up on core0, so only core0 may
+ * read the counter there.
+ *
+ * @return current cycle count
+ */
+uint64_t platform_cpucycles(void);
+
+/**
+ * @brief Read the time in microseconds since some fixed point.
+ *
+ * Unlike platform_cpucycles this may be read on both cores, and durations convert to seconds without knowing the
+ * clock: the timer of the pico-sdk, clock_gettime(CLOCK_MONOTONIC) on the host.
+ *
+ * @return current time in microseconds
+ */
+uint64_t platform_time_us(void);
+
+/**
+ * @brief Enter a short critical section shared by both cores.
+ *
+ * @return state to pass to platform_unlock
+ */
+uint32_t platform_lock(void);
+
+/**
+ * @brief Leave the critical section of platform_lock.
+ *
+ * @param saved return value of platform_lock
+ */
+void platform_unlock(uint32_t saved);
+
+#endif
@@ -0,0 +1,333 @@
+#define _GNU_SOURCE
+
+#include "platform.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Same depth as the inter-core FIFOs of the RP2040.
+#define FIFO_DEPTH 8
+
+#define OUT_BUF_SIZE 4096
+
+/**
+ * @brief One direction of the emulated inter-core FIFO.
+ */
+typedef struct
+{
+    uintptr_t data[FIFO_DEPTH];
+    uint8_t head;
+    uint8_t count;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} fifo_t;
+
+/**
+ * fifos[0]: core0 -> core1
+ * fifos[1]: core1 -> core0
+ */
+static fifo_t fifos[2] = {
+    {.lock = PTHREAD_MUTEX_INITIALIZER, .changed = PTHREAD_COND_INITIALIZER},
+    {.lock = PTHREAD_MUTEX_INITIALIZER, .changed = PTHREAD_COND_INITIALIZER},
+};
+
+static _Thread_local uint8_t core_id = 0;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t core1_thread;
+static bool core1_running = false;
+
+static int in_fd = STDIN_FILENO;
+static int out_fd = STDOUT_FILENO;
+
+static uint8_t out_buf[OUT_BUF_SIZE];
+static size_t out_len = 0;
+
+static void flush_output(void)
+{
+    size_t done = 0;
+
+    while (done < out_len)
+    {
+        ssize_t n = write(out_fd, out_buf + done, out_len - done);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            exit(1);
+        }
+        done += (size_t)n;
+    }
+
+    out_len = 0;
+}
+
+/**
+ * @brief Use a pty instead of stdin/stdout when PRESENT_PTY is set.
+ *
+ * The slave side behaves like the /dev/ttyACM0 of a real board, so test_against_testvectors.py can be pointed at it.
+ */
+static void open_pty(void)
+{
+    struct termios tio;
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0)
+    {
+        perror("pty");
+        exit(1);
+    }
+
+    // Binary transport, no echo and no line editing.
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+
+    // Keep the slave side open ourselves, so the pty neither hangs up before a client connects nor when it leaves.
+    if (open(ptsname(fd), O_RDWR | O_NOCTTY) < 0)
+    {
+        perror("pty");
+        exit(1);
+    }
+
+    fprintf(stderr, "Serial port: %s\n", ptsname(fd));
+
+    in_fd = fd;
+    out_fd = fd;
+}
+
+void platform_init(void)
+{
+    if (getenv("PRESENT_PTY") != NULL)
+    {
+        open_pty();
+    }
+
+    atexit(flush_output);
+}
+
+int platform_getchar_timeout_us(uint32_t timeout_us)
+{
+    struct pollfd pfd = {.fd = in_fd, .events = POLLIN};
+    uint8_t c;
+    ssize_t n;
+
+    // The other side will not answer before it has seen everything we sent.
+    flush_output();
+
+    if (poll(&pfd, 1, (int)(timeout_us / 1000)) <= 0)
+    {
+        return PLATFORM_ERROR_TIMEOUT;
+    }
+
+    n = read(in_fd, &c, 1);
+
+    if (n == 1)
+    {
+        return c;
+    }
+
+    // stdin was closed, so there is no host left to talk to.
+    if (n == 0 || (errno != EINTR && errno != EAGAIN))
+    {
+        exit(0);
+    }
+
+    return PLATFORM_ERROR_TIMEOUT;
+}
+
+void platform_putchar_raw(uint8_t c)
+{
+    if (out_len == OUT_BUF_SIZE)
+    {
+        flush_output();
+    }
+
+    out_buf[out_len++] = c;
+}
+
+void platform_read_blocking(uint8_t *buf, size_t len)
+{
+    flush_output();
+
+    while (len > 0)
+    {
+        ssize_t n = read(in_fd, buf, len);
+
+        if (n > 0)
+        {
+            buf += n;
+            len -= (size_t)n;
+        }
+        else if (n == 0 || (errno != EINTR && errno != EAGAIN))
+        {
+            // Same as in platform_getchar_timeout_us.
+            exit(0);
+        }
+    }
+}
+
+void platform_write(const uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        size_t n = OUT_BUF_SIZE - out_len;
+
+        if (n == 0)
+        {
+            flush_output();
+            continue;
+        }
+
+        if (n > len)
+        {
+            n = len;
+        }
+
+        memcpy(out_buf + out_len, buf, n);
+        out_len += n;
+        buf += n;
+        len -= n;
+    }
+}
+
+void platform_led_put(bool on)
+{
+    (void)on;
+}
+
+uint64_t platform_cpucycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    // Reference cycles of the TSC, which equal core cycles as long as the clock does not scale.
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+uint64_t platform_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+void platform_fifo_push_blocking(uintptr_t data)
+{
+    fifo_t *fifo = &fifos[core_id];
+
+    pthread_mutex_lock(&fifo->lock);
+
+    while (fifo->count == FIFO_DEPTH)
+    {
+        pthread_cond_wait(&fifo->changed, &fifo->lock);
+    }
+
+    fifo->data[(fifo->head + fifo->count) % FIFO_DEPTH] = data;
+    fifo->count++;
+
+    pthread_cond_broadcast(&fifo->changed);
+    pthread_mutex_unlock(&fifo->lock);
+}
+
+uintptr_t platform_fifo_pop_blocking(void)
+{
+    fifo_t *fifo = &fifos[core_id ^ 1];
+    uintptr_t data;
+
+    pthread_mutex_lock(&fifo->lock);
+
+    while (fifo->count == 0)
+    {
+        pthread_cond_wait(&fifo->changed, &fifo->lock);
+    }
+
+    data = fifo->data[fifo->head];
+    fifo->head = (fifo->head + 1) % FIFO_DEPTH;
+    fifo->count--;
+
+    pthread_cond_broadcast(&fifo->changed);
+    pthread_mutex_unlock(&fifo->lock);
+
+    return data;
+}
+
+static void *core1_main(void *arg)
+{
+    void (*entry)(void) = (void (*)(void))arg;
+
+    core_id = 1;
+    entry();
+
+    return NULL;
+}
+
+uint8_t platform_core_num(void)
+{
+    return core_id;
+}
+
+void platform_core1_launch(void (*entry)(void))
+{
+    if (pthread_create(&core1_thread, NULL, core1_main, (void *)entry) != 0)
+    {
+        perror("core1");
+        exit(1);
+    }
+
+    core1_running = true;
+}
+
+void platform_core1_reset(void)
+{
+    // A thread cannot be reset like core1, so wait for its entry function to return instead.
+    if (core1_running)
+    {
+        pthread_join(core1_thread, NULL);
+        core1_running = false;
+    }
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        pthread_mutex_lock(&fifos[i].lock);
+        fifos[i].head = 0;
+        fifos[i].count = 0;
+        pthread_mutex_unlock(&fifos[i].lock);
+    }
+}
+
+uint32_t platform_lock(void)
+{
+    pthread_mutex_lock(&lock);
+
+    return 0;
+}
+
+void platform_unlock(uint32_t saved)
+{
+    (void)saved;
+
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,117 @@
+#include "platform.h"
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "hardware/structs/scb.h"
+#include "hardware/structs/systick.h"
+
+#define LED_PIN 25
+
+// SysTick counts down from its reload value, 24 bits.
+#define SYSTICK_MASK 0x00FFFFFFu
+
+static spin_lock_t *lock;
+
+// Upper bits of platform_cpucycles, one for each time SysTick went through zero.
+static volatile uint32_t systick_wraps = 0;
+
+/**
+ * @brief SysTick exception of core0, every 2^24 cycles. Overrides the weak handler of the pico-sdk.
+ */
+void isr_systick(void)
+{
+    systick_wraps++;
+}
+
+void platform_init(void)
+{
+    stdio_init_all();
+
+    // based on https://forums.raspberrypi.com/viewtopic.php?f=145&t=304201&p=1820770&hilit=Hermannsw+systick#p1822677
+    // Processor clock, exception on each wrap (TICKINT) and enable.
+    systick_hw->rvr = SYSTICK_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0b00000111; // 0x7;
+
+    // Give the USB host some time to enumerate the serial port.
+    sleep_ms(2000);
+
+    gpio_init(LED_PIN);
+    gpio_set_dir(LED_PIN, GPIO_OUT);
+
+    lock = spin_lock_init(spin_lock_claim_unused(true));
+}
+
+int platform_getchar_timeout_us(uint32_t timeout_us)
+{
+    int c = getchar_timeout_us(timeout_us);
+
+    return c == PICO_ERROR_TIMEOUT ? PLATFORM_ERROR_TIMEOUT : c;
+}
+
+void platform_putchar_raw(uint8_t c)
+{
+    putchar_raw(c);
+}
+
+void platform_read_blocking(uint8_t *buf, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len)
+    {
+        int c = getchar_timeout_us(100000);
+
+        if (c != PICO_ERROR_TIMEOUT)
+        {
+            buf[done++] = c & 0xff;
+        }
+    }
+}
+
+void platform_write(const uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        putchar_raw(buf[i]);
+    }
+}
+
+void platform_led_put(bool on)
+{
+    gpio_put(LED_PIN, on);
+}
+
+uint64_t platform_cpucycles(void)
+{
+    uint32_t wraps, pending, cvr;
+
+    // Read again if a wrap was counted or became pending in between, so the count of wraps belongs to cvr.
+    // A wrap that is still pending, because interrupts are off, is counted here already.
+    do
+    {
+        wraps = systick_wraps;
+        pending = scb_hw->icsr & M0PLUS_ICSR_PENDSTSET_BITS;
+        cvr = systick_hw->cvr;
+    } while (wraps != systick_wraps || pending != (scb_hw->icsr & M0PLUS_ICSR_PENDSTSET_BITS));
+
+    // Systick *decreases*
+    return (((uint64_t)wraps + (pending ? 1 : 0)) << 24) + (SYSTICK_MASK - cvr);
+}
+
+uint64_t platform_time_us(void)
+{
+    return time_us_64();
+}
+
+uint32_t platform_lock(void)
+{
+    // The cores have no atomic read-modify-write, so use one of the hardware spin locks.
+    return spin_lock_blocking(lock);
+}
+
+void platform_unlock(uint32_t saved)
+{
+    spin_unlock(lock, saved);
+}
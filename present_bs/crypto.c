@@ -1,6 +1,9 @@
 #include "crypto.h"
 
-#include "pico/multicore.h"
+#include "platform.h"
+#include "instrument.h"
+// PBOX, fix_index, the S-box circuits and the key schedule step, shared with host/present_engine.h.
+#include "present_core.h"
 
 #define OPTIMIZATION_SBOX
 #define OPTIMIZATION_MULTICORE
@@ -17,19 +20,20 @@
 #define GETBIT(byte, i) ((byte >> i) & 0x01)
 
 /**
- * @brief Calculate the new index of bit in pbox_layer.
+ * @brief Slice order of the state before round r + 1 in fixsliced form.
  *
- * @param i index of a bit
- *
- * @return new index
+ * @param r number of rounds done
  *
+ * @return phase 0, 1 or 2
  */
-#define PBOX(i) ((i / 4) + (i % 4) * 16)
+#define FIX_PHASE(r) ((r) % 3)
 
 // There are two cores in pico totally.
 #define MULTICORE_CORE_NUM 2
 #define CORE1 1
 #define CORE0 0
+// Not a core: the calling core does the whole loop alone, for batches that are not shared, see crypt_batches.
+#define CORE_ALL 2
 
 /**
  * @brief These are some macros that help writting for loop in multicore mode easily.
@@ -41,8 +45,8 @@
  * @param core_id id of current core starting from 0 and it should be 0 or 1 in pico
  * 
  */
-#define MULTICORE_FOR_START(x, core_id) (core_id * x / MULTICORE_CORE_NUM)
-#define MULTICORE_FOR_END(x, core_id) ((core_id + 1) * x / MULTICORE_CORE_NUM)
+#define MULTICORE_FOR_START(x, core_id) (core_id == CORE_ALL ? 0 : core_id * x / MULTICORE_CORE_NUM)
+#define MULTICORE_FOR_END(x, core_id) (core_id == CORE_ALL ? x : (core_id + 1) * x / MULTICORE_CORE_NUM)
 #define MULTICORE_FOR(i, x, core_id) for (i = MULTICORE_FOR_START(x, core_id); i < MULTICORE_FOR_END(x, core_id); i++)
 
 /**
@@ -54,258 +58,317 @@
  * core0 -> write -> fifo_queue0 -> read -> core1
  *       <- read <- fifo_queue1 <- write <- core1
  * 
- * multicore_fifo_push_blocking(x) will push a value to the writable queue of the core.
- * multicore_fifo_pop_blocking() will block untill there is a value that can be read from the readable queue of the core.
+ * platform_fifo_push_blocking(x) will push a value to the writable queue of the core.
+ * platform_fifo_pop_blocking() will block untill there is a value that can be read from the readable queue of the core.
  * 
  * So for each core, it will firstly push a value to the queue and wait until the other core also pushes a value to the queue.
  * So in this way one core cannot contiue executing untill the other core also reaches the barrier.
+ *
+ * With INSTRUMENT, the time spent here is recorded as INSTRUMENT_BARRIER.
+ */
+#define MULTICORE_BARRIER()                 \
+    do                                      \
+    {                                       \
+        INSTRUMENT_BEGIN();                 \
+        platform_fifo_push_blocking(0);     \
+        platform_fifo_pop_blocking();       \
+        INSTRUMENT_END(INSTRUMENT_BARRIER); \
+    } while (0)
+
+/**
+ * @brief MULTICORE_BARRIER if the work is shared by both cores, nothing for CORE_ALL.
+ */
+#define MULTICORE_SYNC(core_id)      \
+    if ((core_id) != CORE_ALL)       \
+    {                                \
+        MULTICORE_BARRIER();         \
+    }
+
+/**
+ * @brief Swap the bits selected by mask in b with the bits selected by (mask << n) in a.
+ *
+ * @param a first word, updated
+ * @param b second word, updated
+ * @param mask bits of b to be swapped
+ * @param n distance between the swapped bits
+ */
+#define SWAPMOVE(a, b, mask, n)                      \
+    do                                               \
+    {                                                \
+        bs_word_t t = (((a) >> (n)) ^ (b)) & (mask); \
+        (b) ^= t;                                    \
+        (a) ^= t << (n);                             \
+    } while (0)
+
+#ifdef PRESENT_BS_KERNELS
+// transpose_kernel, generated by gen_kernels.py for BS_WORD_BITS.
+#include "present_bs_transpose.h"
+#endif
+
+/**
+ * @brief Transpose a square bit matrix of BS_WORD_BITS rows of BS_WORD_BITS bits in place.
+ *
+ * Afterwards bit c of m[r] is what was bit r of m[c].
+ *
+ * This is the recursive block transposition of Eklundh. The matrix is split into 2 x 2 blocks of h x h bits, and the
+ * upper right block is swapped with the lower left one. Then the same is done for h / 2 inside every block, down to
+ * single bits. Each of the log2(BS_WORD_BITS) levels costs BS_WORD_BITS / 2 SWAPMOVE.
+ *
+ * If OPTIMIZATION_UNFOLD_LOOP, both loops are fully unfolded so all shifts and masks are constants.
+ * If PRESENT_BS_KERNELS, the same is done by gen_kernels.py instead of the compiler.
+ *
+ * @param m rows of the matrix
+ */
+static void transpose(bs_word_t m[BS_WORD_BITS])
+{
+#ifdef PRESENT_BS_KERNELS
+    transpose_kernel(m);
+#else
+    // Low half of every group of 2 * h bits.
+    bs_word_t mask = ~(bs_word_t)0u >> (BS_WORD_BITS / 2);
+    uint8_t h;
+
+#ifdef OPTIMIZATION_UNFOLD_LOOP
+#pragma GCC unroll 6
+#endif
+    for (h = BS_WORD_BITS / 2; h != 0; h >>= 1, mask ^= mask << h)
+    {
+#ifdef OPTIMIZATION_UNFOLD_LOOP
+#pragma GCC unroll 32
+#endif
+        for (uint8_t k = 0; k < BS_WORD_BITS / 2; k++)
+        {
+            // kth row with bit h cleared, which is paired with the row h below it.
+            uint8_t r = ((k & ~(h - 1)) << 1) | (k & (h - 1));
+
+            SWAPMOVE(m[r], m[r + h], mask, h);
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Transpose the rows of tile (g, t) and store them into state_bs, see enslice.
+ *
+ * @param m rows of the tile, word t of texts g * BS_WORD_BITS onwards, overwritten
+ * @param state_bs Output: word g of BS_WORD_BITS slices
+ * @param phase slice order of state_bs, see fix_index
+ * @param g group of texts
+ * @param t tile of the texts
+ */
+static inline void tile_to_slices(bs_word_t m[BS_WORD_BITS], bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], uint8_t phase, uint8_t g, uint8_t t)
+{
+    transpose(m);
+
+    for (uint8_t i = 0; i < BS_WORD_BITS; i++)
+    {
+        memcpy((uint8_t *)&state_bs[fix_index(t * BS_WORD_BITS + i, phase)] + g * sizeof(bs_word_t), &m[i], sizeof(bs_word_t));
+    }
+}
+
+/**
+ * @brief Load tile (g, t) from state_bs and transpose it back into rows, the inverse of tile_to_slices.
+ *
+ * @param state_bs bitsliced state
+ * @param m Output: rows of the tile, word t of texts g * BS_WORD_BITS onwards
+ * @param phase slice order of state_bs, see fix_index
+ * @param g group of texts
+ * @param t tile of the texts
+ */
+static inline void slices_to_tile(const bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], bs_word_t m[BS_WORD_BITS], uint8_t phase, uint8_t g, uint8_t t)
+{
+    for (uint8_t i = 0; i < BS_WORD_BITS; i++)
+    {
+        memcpy(&m[i], (const uint8_t *)&state_bs[fix_index(t * BS_WORD_BITS + i, phase)] + g * sizeof(bs_word_t), sizeof(bs_word_t));
+    }
+
+    transpose(m);
+}
+
+/**
+ * @brief Transpose tile u of the texts into state_bs, see enslice.
+ *
+ * @param pt texts
+ * @param state_bs Output: word u / BITSLICE_TILES of BS_WORD_BITS slices
+ * @param phase slice order of state_bs, see fix_index
+ * @param u index of the tile
+ */
+static inline void enslice_unit(const uint8_t *pt, bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], uint8_t phase, uint8_t u)
+{
+    bs_word_t m[BS_WORD_BITS];
+    uint8_t g = u / BITSLICE_TILES;
+    uint8_t t = u % BITSLICE_TILES;
+
+    for (uint8_t j = 0; j < BS_WORD_BITS; j++)
+    {
+        memcpy(&m[j], pt + (g * BS_WORD_BITS + j) * CRYPTO_IN_SIZE + t * sizeof(bs_word_t), sizeof(bs_word_t));
+    }
+
+    tile_to_slices(m, state_bs, phase, g, t);
+}
+
+/**
+ * @brief Transpose tile u of state_bs back into the texts, the inverse of enslice_unit.
+ *
+ * @param state_bs bitsliced state
+ * @param pt Output: texts g * BS_WORD_BITS onwards, g = u / BITSLICE_TILES
+ * @param phase slice order of state_bs, see fix_index
+ * @param u index of the tile
  */
-#define MULTICORE_BARRIER()          \
-    multicore_fifo_push_blocking(0); \
-    multicore_fifo_pop_blocking()
+static inline void unslice_unit(const bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], uint8_t *pt, uint8_t phase, uint8_t u)
+{
+    bs_word_t m[BS_WORD_BITS];
+    uint8_t g = u / BITSLICE_TILES;
+    uint8_t t = u % BITSLICE_TILES;
+
+    slices_to_tile(state_bs, m, phase, g, t);
+
+    for (uint8_t j = 0; j < BS_WORD_BITS; j++)
+    {
+        memcpy(pt + (g * BS_WORD_BITS + j) * CRYPTO_IN_SIZE + t * sizeof(bs_word_t), &m[j], sizeof(bs_word_t));
+    }
+}
 
 /**
  * @brief Bring normal buffer into bitsliced form.
- * 
- * In normal behavour, it will use a nested loop of two levels.
- * The range of outer loop is (0, CRYPTO_IN_SIZE_BIT) and the range of inner loop is (0, BITSLICE_WIDTH).
- * 
- * If OPTIMIZATION_UNFOLD_LOOP, it will unfold inner loop.
- * If OPTIMIZATION_MULTICORE, it will two cores to run this function and each of core will execute half of outer loop asynchronously.
- * 
+ *
+ * The texts are a matrix of BITSLICE_WIDTH rows of CRYPTO_IN_SIZE_BIT bits and state_bs is its transposition.
+ * It is cut into BITSLICE_UNITS tiles of BS_WORD_BITS x BS_WORD_BITS bits. Tile (g, t) holds texts g * BS_WORD_BITS
+ * onwards and their bits t * BS_WORD_BITS onwards. It becomes word g of state_bs[t * BS_WORD_BITS] onwards.
+ *
+ * In normal behavour, it will loop over all tiles.
+ * If OPTIMIZATION_MULTICORE, it will two cores to run this function and each of core will transpose half of the tiles asynchronously.
+ *
+ * Encryption starts in phase 0. Decryption starts in the slice order encryption ends with, see fix_index.
+ *
  * @param pt Input: state_bs in normal form
  * @param state_bs Output: Bitsliced state
+ * @param phase slice order of state_bs, see fix_index
  * @param core_id id of core only available when OPTIMIZATION_MULTICORE
- * 
+ *
  */
-static void enslice(const uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT]
+static void enslice(const uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], uint8_t phase
 #ifdef OPTIMIZATION_MULTICORE
                    ,uint8_t core_id
 #endif
 )
 {
-    uint8_t i;
+    INSTRUMENT_BEGIN();
+
+    uint8_t u;
 
 #ifdef OPTIMIZATION_MULTICORE
-    MULTICORE_FOR(i, CRYPTO_IN_SIZE_BIT, core_id)
+    MULTICORE_FOR(u, BITSLICE_UNITS, core_id)
 #else
-    for (i = 0; i < CRYPTO_IN_SIZE_BIT; i++)
+    for (u = 0; u < BITSLICE_UNITS; u++)
 #endif
     {
-#ifdef OPTIMIZATION_UNFOLD_LOOP
-        bs_reg_t tmp;
-
-        // Get ith bit from 32 texts respectively and calculate the state_bs[i] which consists of 32 ith bits from 32 texts.
-        tmp = (pt[0 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 0;
-        tmp = (pt[1 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 1;
-        tmp = (pt[2 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 2;
-        tmp = (pt[3 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 3;
-        tmp = (pt[4 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 4;
-        tmp = (pt[5 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 5;
-        tmp = (pt[6 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 6;
-        tmp = (pt[7 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 7;
-        tmp = (pt[8 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 8;
-        tmp = (pt[9 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 9;
-        tmp = (pt[10 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 10;
-        tmp = (pt[11 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 11;
-        tmp = (pt[12 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 12;
-        tmp = (pt[13 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 13;
-        tmp = (pt[14 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 14;
-        tmp = (pt[15 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 15;
-        tmp = (pt[16 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 16;
-        tmp = (pt[17 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 17;
-        tmp = (pt[18 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 18;
-        tmp = (pt[19 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 19;
-        tmp = (pt[20 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 20;
-        tmp = (pt[21 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 21;
-        tmp = (pt[22 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 22;
-        tmp = (pt[23 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 23;
-        tmp = (pt[24 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 24;
-        tmp = (pt[25 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 25;
-        tmp = (pt[26 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 26;
-        tmp = (pt[27 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 27;
-        tmp = (pt[28 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 28;
-        tmp = (pt[29 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 29;
-        tmp = (pt[30 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 30;
-        tmp = (pt[31 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-        state_bs[i] |= tmp << 31;
-#else
-        for (uint8_t j = 0; j < BITSLICE_WIDTH; j++)
-        {
-            // Get ith bit of jth text.
-            bs_reg_t tmp = (pt[j * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] >> (i % 8 /* which bit */)) & 0x1;
-            // ith bit of jth text should be assigned to jth bit of ith state_bs.
-            state_bs[i] |= tmp << j;
-        }
-#endif
+        enslice_unit(pt, state_bs, phase, u);
     }
+
+    INSTRUMENT_END(INSTRUMENT_ENSLICE);
 }
 
 /**
  * @brief Bring bitsliced buffer into normal form. It is like enslice function.
- * 
+ *
+ * The transposition is its own inverse, so the tiles are only read from state_bs and written to pt the other way round.
+ * Every byte of pt is written, so there is no need to clear pt before.
+ *
+ * The state may still be in fixsliced order, which is undone here while reading the slices.
+ *
  * @param state_bs Input: Bitsliced state
  * @param pt Output: state_bs in normal form
+ * @param phase slice order of state_bs, see fix_index
  * @param core_id id of core only available when OPTIMIZATION_MULTICORE
  */
-static void unslice(const bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH]
+static void unslice(const bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], uint8_t phase
 #ifdef OPTIMIZATION_MULTICORE
                    ,uint8_t core_id
 #endif
 )
 {
-    uint8_t i;
+    INSTRUMENT_BEGIN();
+
+    uint8_t u;
 
 #ifdef OPTIMIZATION_MULTICORE
-    MULTICORE_FOR(i, CRYPTO_IN_SIZE_BIT, core_id)
+    MULTICORE_FOR(u, BITSLICE_UNITS, core_id)
 #else
-    for (i = 0; i < CRYPTO_IN_SIZE_BIT; i++)
+    for (u = 0; u < BITSLICE_UNITS; u++)
 #endif
     {
-#ifdef OPTIMIZATION_UNFOLD_LOOP
-        uint8_t tmp;
-
-        // Get each bit of 32 bits of ith state_bs and assign each of these 32 bits to 32 texts.
-        // 0th bit of ith state_bs which should be assigned to ith bit of 0th text. Others are same.
-        tmp = (state_bs[i] >> 0) & 0x1;
-        pt[0 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 1) & 0x1;
-        pt[1 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 2) & 0x1;
-        pt[2 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 3) & 0x1;
-        pt[3 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 4) & 0x1;
-        pt[4 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 5) & 0x1;
-        pt[5 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 6) & 0x1;
-        pt[6 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 7) & 0x1;
-        pt[7 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 8) & 0x1;
-        pt[8 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 9) & 0x1;
-        pt[9 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 10) & 0x1;
-        pt[10 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 11) & 0x1;
-        pt[11 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 12) & 0x1;
-        pt[12 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 13) & 0x1;
-        pt[13 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 14) & 0x1;
-        pt[14 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 15) & 0x1;
-        pt[15 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 16) & 0x1;
-        pt[16 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 17) & 0x1;
-        pt[17 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 18) & 0x1;
-        pt[18 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 19) & 0x1;
-        pt[19 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 20) & 0x1;
-        pt[20 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 21) & 0x1;
-        pt[21 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 22) & 0x1;
-        pt[22 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 23) & 0x1;
-        pt[23 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 24) & 0x1;
-        pt[24 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 25) & 0x1;
-        pt[25 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 26) & 0x1;
-        pt[26 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 27) & 0x1;
-        pt[27 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 28) & 0x1;
-        pt[28 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 29) & 0x1;
-        pt[29 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 30) & 0x1;
-        pt[30 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        tmp = (state_bs[i] >> 31) & 0x1;
-        pt[31 * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-#else
-        for (uint8_t j = 0; j < BITSLICE_WIDTH; j++)
-        {
-            // Get ith bit of jth text.
-            uint8_t tmp = (state_bs[i] >> j) & 0x1;
-            pt[j * CRYPTO_IN_SIZE /* which text */ + i / 8 /* which byte */] |= tmp << (i % 8 /* which bit */);
-        }
-#endif
+        unslice_unit(state_bs, pt, phase, u);
     }
+
+    INSTRUMENT_END(INSTRUMENT_UNSLICE);
 }
 
 /**
- * @brief xor each bit of key with each element of state_bs.
+ * @brief xor each bitsliced round key mask with each element of state_bs.
  * 
- * Actually, if bit == 0 we can do nothing and if bit == 1 we just negate the state_bs[i].
+ * The masks come from present_expand_key and are all ones where the key bit is 1 and all zeros where it is 0,
+ * so there is no branch on the key bits. They are already in the slice order of their round.
  * 
  * In normal behavour, it will loop for CRYPTO_IN_SIZE_BIT to calculate the result.
- * If OPTIMIZATION_MULTICORE, each core will calculate half of that.
+ * If OPTIMIZATION_MULTICORE, each core will calculate the same 8 S-box inputs as in sbox_layer, so there is no need
+ * for a barrier between both.
  * 
  * @param state_bs bitsliced state
- * @param round_key key of current round
+ * @param round_key_bs bitsliced key of current round
+ * @param phase slice order, see fix_index
  * @param core_id id of core only available when OPTIMIZATION_MULTICORE
  * 
  */
-static void add_round_key(bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], uint8_t round_key[CRYPTO_IN_SIZE]
+static void add_round_key(bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], const bs_reg_t round_key_bs[CRYPTO_IN_SIZE_BIT], uint8_t phase
 #ifdef OPTIMIZATION_MULTICORE
                          ,uint8_t core_id
 #endif
 )
 {
-    uint8_t i;
+    INSTRUMENT_BEGIN();
 
 #ifdef OPTIMIZATION_MULTICORE
-    MULTICORE_FOR(i, CRYPTO_IN_SIZE_BIT, core_id)
-#else
-    for (i = 0; i < CRYPTO_IN_SIZE_BIT; i++)
-#endif
+    uint8_t i;
+
+    MULTICORE_FOR(i, 16, core_id)
     {
-        uint8_t bit = GETBIT(round_key[i / 8], i % 8);
-        if (bit != 0u)
+        for (uint8_t j = 0; j < 4; j++)
         {
-            state_bs[i] = ~state_bs[i];
+            uint8_t k = fix_index(i * 4 + j, phase);
+
+            state_bs[k] ^= round_key_bs[k];
         }
     }
+#else
+    (void)phase;
+
+    for (uint8_t i = 0; i < CRYPTO_IN_SIZE_BIT; i++)
+    {
+        state_bs[i] ^= round_key_bs[i];
+    }
+#endif
+
+    INSTRUMENT_END(INSTRUMENT_ADD_ROUND_KEY);
+}
+
+/**
+ * @brief One S-box on 4 slices, with the formulas derived at sbox_layer.
+ *
+ * It is shared by sbox_layer and the bitsliced key schedule.
+ *
+ * @param x0 Input and Output: least significant bit
+ * @param x1 Input and Output: second bit
+ * @param x2 Input and Output: third bit
+ * @param x3 Input and Output: most significant bit
+ */
+static inline void sbox_slices(bs_reg_t *x0, bs_reg_t *x1, bs_reg_t *x2, bs_reg_t *x3)
+{
+#ifdef OPTIMIZATION_SBOX
+    SBOX_CIRCUIT(bs_reg_t, *x0, *x1, *x2, *x3);
+#else
+    SBOX_ANF(bs_reg_t, *x0, *x1, *x2, *x3);
+#endif
 }
 
 /**
@@ -402,38 +465,25 @@ static void add_round_key(bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], uint8_t round_k
  * y2 = 1 + x0 * x1 + x2 + x3 + x0 * x3 + x1 * x3 + x0 * x1 * x3 + x0 * x2 * x3
  * y3 = 1 + x0 + x1 + x1 * x2 + x0 * x1 * x2 + x3 + x0 * x1 * x3 + x0 * x2 * x3
  *  
- * And then simplify these four formulas.
- * 
- * y0 = x0 + x2 + x1 * x2 + x3
- * 	  = x0 + ~x1 * x2 + x3
- *
- * y1 = x1 + x0 * x1 * x2 + x3 + x1 * x3 + x0 * x1 * x3 + x2 * x3 + x0 * x2 * x3
- *    = x1 + x0 * x1 * x2 + x3 + x1 * x3 * (x0 + 1) + x2 * x3 * (x0 + 1)
- *    = x1 + x0 * x1 * x2 + x3 + (x0 + 1) * x3 * (x1 + x2)
- *    = x1 + x0 * x1 * x2 + x3 + ~x0 * x3 * (x1 + x2)
- *
- * y2 = 1 + x0 * x1 + x2 + x3 + x0 * x3 + x1 * x3 + x0 * x1 * x3 + x0 * x2 * x3
- *    = 1 + x0 * (x1 + x3) + x2 + x3 + x1 * x3 + x0 * x3 * (x1 + x2)
- *    = ~x2 + x0 * (x1 + x3) + ~x1 * x3 + x0 * x3 * (x1 + x2)
- *
- * y3 = 1 + x0 + x1 + x1 * x2 + x0 * x1 * x2 + x3 + x0 * x1 * x3 + x0 * x2 * x3
- *    = 1 + x0 + x1 + (x0 + 1) * x1 * x2 + x3 + x0 * x3 * (x1 + x2)
- *    = (x0 + 1) * (x1 * x2 + 1) + x1 + x3 + x0 * x3 * (x1 + x2)
- *    = ~x0 * ~(x1 * x2) + x1 + x3 + x0 * x3 * (x1 + x2)
- * 
- * In normal behavour, it will loop for 16 times and use unsimplified formulas.
- * If OPTIMIZATION_SBOX, it will use simplified formulas.
+ * In normal behavour, it will loop for 16 times and use these formulas.
+ * If OPTIMIZATION_SBOX, it will use a circuit of 16 gates found by gen_sbox_circuit.py instead, which has only 4 AND
+ * or OR gates and shares its XORs between the four outputs.
  * If OPTIMIZATION_MULTICORE, each core will calculate half of 16 times.
  *
+ * The ith S-box takes slices 4 * i to 4 * i + 3, which are found through fix_index.
+ *
  * @param state_bs bitsliced state
+ * @param phase slice order, see fix_index
  * @param core_id id of core only available when OPTIMIZATION_MULTICORE
  */
-static void sbox_layer(bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT]
+static void sbox_layer(bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], uint8_t phase
 #ifdef OPTIMIZATION_MULTICORE
                       ,uint8_t core_id
 #endif
 )
 {
+    INSTRUMENT_BEGIN();
+
     uint8_t i;
 
 #ifdef OPTIMIZATION_MULTICORE
@@ -442,287 +492,2189 @@ static void sbox_layer(bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT]
     for (i = 0; i < 16; i++)
 #endif
     {
-#ifdef OPTIMIZATION_SBOX
-        bs_reg_t x0, x1, x2, x3;
-        bs_reg_t y0, y1, y2, y3;
-        bs_reg_t x3_and_x1_xor_x2, x1_xor_x3, x1_and_x2;
-
-        x0 = state_bs[i * 4];
-        x1 = state_bs[i * 4 + 1];
-        x2 = state_bs[i * 4 + 2];
-        x3 = state_bs[i * 4 + 3];
-
-        x3_and_x1_xor_x2 = x3 & (x1 ^ x2);
-        x1_xor_x3 = x1 ^ x3;
-        x1_and_x2 = x1 & x2;
-
-        y0 = x0 ^ (~x1 & x2) ^ x3;
-        y1 = x1_xor_x3 ^ (x0 & x1_and_x2) ^ (~x0 & x3_and_x1_xor_x2);
-        y2 = ~x2 ^ (x0 & x1_xor_x3) ^ (~x1 & x3) ^ (x0 & x3_and_x1_xor_x2);
-        y3 = (~x0 & ~x1_and_x2) ^ x1_xor_x3 ^ (x0 & x3_and_x1_xor_x2);
-
-        state_bs[i * 4] = y0;
-        state_bs[i * 4 + 1] = y1;
-        state_bs[i * 4 + 2] = y2;
-        state_bs[i * 4 + 3] = y3;
-#else
         bs_reg_t x0, x1, x2, x3;
-        bs_reg_t y0, y1, y2, y3;
 
-        x0 = state_bs[i * 4];
-        x1 = state_bs[i * 4 + 1];
-        x2 = state_bs[i * 4 + 2];
-        x3 = state_bs[i * 4 + 3];
+        x0 = state_bs[fix_index(i * 4, phase)];
+        x1 = state_bs[fix_index(i * 4 + 1, phase)];
+        x2 = state_bs[fix_index(i * 4 + 2, phase)];
+        x3 = state_bs[fix_index(i * 4 + 3, phase)];
 
-        y0 = x0 ^ x2 ^ (x1 & x2) ^ x3;
-        y1 = x1 ^ (x0 & x1 & x2) ^ x3 ^ (x1 & x3) ^ (x0 & x1 & x3) ^ (x2 & x3) ^ (x0 & x2 & x3);
-        y2 = 0xffffffffu ^ (x0 & x1) ^ x2 ^ x3 ^ (x0 & x3) ^ (x1 & x3) ^ (x0 & x1 & x3) ^ (x0 & x2 & x3);
-        y3 = 0xffffffffu ^ x0 ^ x1 ^ (x1 & x2) ^ (x0 & x1 & x2) ^ x3 ^ (x0 & x1 & x3) ^ (x0 & x2 & x3);
+        sbox_slices(&x0, &x1, &x2, &x3);
 
-        state_bs[i * 4] = y0;
-        state_bs[i * 4 + 1] = y1;
-        state_bs[i * 4 + 2] = y2;
-        state_bs[i * 4 + 3] = y3;
-#endif
+        state_bs[fix_index(i * 4, phase)] = x0;
+        state_bs[fix_index(i * 4 + 1, phase)] = x1;
+        state_bs[fix_index(i * 4 + 2, phase)] = x2;
+        state_bs[fix_index(i * 4 + 3, phase)] = x3;
     }
+
+    INSTRUMENT_END(INSTRUMENT_SBOX_LAYER);
 }
 
 /**
- * @brief Calculate new index of each element of state_bs.
- * 
- * In normal behavour, it will loop for CRYPTO_IN_SIZE_BIT times and calculate pbox.
- * If OPTIMIZATION_MULTICORE, each core will calculate half of CRYPTO_IN_SIZE_BIT and save the result in an argument that is shared by two cores.
- * 
- * We cannot save the result in a local variable and then copy it to state_bs in the multicore mode like that of normal behavour.
- * Because each core will only calculate half of state_bs and the other half part that the core doesnot calculate will be 0 that is the part the other
- * core calculates.
- * So copying a local state_tmp will cover the part that the other core calculates.
- * So we save the result into an argument of state_tmp which is shared by two cores.
- * 
+ * @brief Inverse of sbox_slices, calculated the same way from the ANF of each bit.
+ *
+ * uint8_t sbox_inv[16] = "0x5, 0xE, 0xF, 0x8, 0xC, 0x1, 0x2, 0xD, 0xB, 0x4, 0x6, 0x3, 0x0, 0x7, 0x9, 0xA"
+ *
+ * gen_sbox_ANF.py gives
+ *
+ * y0 = 1 + x0 + x2 + x1 * x3
+ * y1 = x0 + x1 + x0 * x2 + x0 * x1 * x2 + x3 + x1 * x3 + x0 * x1 * x3 + x2 * x3 + x0 * x2 * x3
+ * y2 = 1 + x0 * x1 + x0 * x2 + x1 * x2 + x0 * x1 * x2 + x3 + x0 * x3 + x1 * x3 + x0 * x1 * x3 + x0 * x2 * x3
+ * y3 = x0 + x1 + x0 * x1 + x2 + x0 * x1 * x2 + x3 + x0 * x2 * x3
+ *
+ * If OPTIMIZATION_SBOX, it uses the circuit of gen_sbox_circuit.py --inverse instead.
+ *
+ * @param x0 Input and Output: least significant bit
+ * @param x1 Input and Output: second bit
+ * @param x2 Input and Output: third bit
+ * @param x3 Input and Output: most significant bit
+ */
+static inline void inv_sbox_slices(bs_reg_t *x0, bs_reg_t *x1, bs_reg_t *x2, bs_reg_t *x3)
+{
+#ifdef OPTIMIZATION_SBOX
+    INV_SBOX_CIRCUIT(bs_reg_t, *x0, *x1, *x2, *x3);
+#else
+    INV_SBOX_ANF(bs_reg_t, *x0, *x1, *x2, *x3);
+#endif
+}
+
+/**
+ * @brief Inverse of sbox_layer, with inv_sbox_slices on each S-box.
+ *
+ * If OPTIMIZATION_MULTICORE, each core will calculate half of 16 times.
+ *
  * @param state_bs bitsliced state
- * @param state_tmp temporary state for saving result of pbox_layer only available when OPTIMIZATION_MULTICORE
+ * @param phase slice order, see fix_index
  * @param core_id id of core only available when OPTIMIZATION_MULTICORE
- * 
  */
-static void pbox_layer(bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT]
+static void inv_sbox_layer(bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], uint8_t phase
 #ifdef OPTIMIZATION_MULTICORE
-                      ,bs_reg_t state_tmp[CRYPTO_IN_SIZE_BIT]
-                      ,uint8_t core_id
+                          ,uint8_t core_id
 #endif
 )
 {
+    INSTRUMENT_BEGIN();
+
     uint8_t i;
 
 #ifdef OPTIMIZATION_MULTICORE
-    MULTICORE_FOR(i, CRYPTO_IN_SIZE_BIT, core_id)
+    MULTICORE_FOR(i, 16, core_id)
 #else
-    bs_reg_t state_tmp[CRYPTO_IN_SIZE_BIT];
-
-    for (i = 0; i < CRYPTO_IN_SIZE_BIT; i++)
-#endif
-    {
-        state_tmp[PBOX(i)] = state_bs[i];
-    }
-
-#ifndef OPTIMIZATION_MULTICORE
-    memcpy(state_bs, state_tmp, 4 * CRYPTO_IN_SIZE_BIT);
+    for (i = 0; i < 16; i++)
 #endif
-}
-
-/**
- * @brief Perform next key schedule step.
- * @param key Key register to be updated
- * @param r Round counter
- * @warning For correct function, has to be called with incremented r each time.
- * @note You are free to change or optimize this function.
- */
-static void update_round_key(uint8_t key[CRYPTO_KEY_SIZE], const uint8_t r)
-{
-    //
-    // There is no need to edit this code - but you can do so if you want to
-    // optimise further
-    //
-
-    const uint8_t sbox[16] = {
-        0xC,
-        0x5,
-        0x6,
-        0xB,
-        0x9,
-        0x0,
-        0xA,
-        0xD,
-        0x3,
-        0xE,
-        0xF,
-        0x8,
-        0x4,
-        0x7,
-        0x1,
-        0x2,
-    };
-
-    uint8_t tmp = 0;
-    const uint8_t tmp2 = key[2];
-    const uint8_t tmp1 = key[1];
-    const uint8_t tmp0 = key[0];
-
-    // rotate right by 19 bit
-    key[0] = key[2] >> 3 | key[3] << 5;
-    key[1] = key[3] >> 3 | key[4] << 5;
-    key[2] = key[4] >> 3 | key[5] << 5;
-    key[3] = key[5] >> 3 | key[6] << 5;
-    key[4] = key[6] >> 3 | key[7] << 5;
-    key[5] = key[7] >> 3 | key[8] << 5;
-    key[6] = key[8] >> 3 | key[9] << 5;
-    key[7] = key[9] >> 3 | tmp0 << 5;
-    key[8] = tmp0 >> 3 | tmp1 << 5;
-    key[9] = tmp1 >> 3 | tmp2 << 5;
-
-    // perform sbox lookup on MSbits
-    tmp = sbox[key[9] >> 4];
-    key[9] &= 0x0F;
-    key[9] |= tmp << 4;
-
-    // XOR round counter k19 ... k15
-    key[1] ^= r << 7;
-    key[2] ^= r >> 1;
-}
-
-#ifdef OPTIMIZATION_MULTICORE
-/**
- * @brief Encryption running on core1.
- *
- */
-static void encrypt_core1()
-{
-    // Get parameters from core0.
-    uint8_t *pt = (uint8_t *)multicore_fifo_pop_blocking();
-    bs_reg_t *state_bs = (bs_reg_t *)multicore_fifo_pop_blocking();
-    uint8_t *key = (uint8_t *)multicore_fifo_pop_blocking();
-    bs_reg_t *state_tmp = (bs_reg_t *)multicore_fifo_pop_blocking();
-
-    enslice(pt, state_bs, CORE1);
-
-    MULTICORE_BARRIER();
-
-    for (uint8_t i = 1; i <= 31; i++)
     {
-        add_round_key(state_bs, key + 2, CORE1);
-        sbox_layer(state_bs, CORE1);
-        pbox_layer(state_bs, state_tmp, CORE1);
+        bs_reg_t x0, x1, x2, x3;
 
-        MULTICORE_BARRIER();
+        x0 = state_bs[fix_index(i * 4, phase)];
+        x1 = state_bs[fix_index(i * 4 + 1, phase)];
+        x2 = state_bs[fix_index(i * 4 + 2, phase)];
+        x3 = state_bs[fix_index(i * 4 + 3, phase)];
 
-        // Wait for that core0 finishes update_round_key and copy state_tmp to state_bs.
+        inv_sbox_slices(&x0, &x1, &x2, &x3);
 
-        MULTICORE_BARRIER();
+        state_bs[fix_index(i * 4, phase)] = x0;
+        state_bs[fix_index(i * 4 + 1, phase)] = x1;
+        state_bs[fix_index(i * 4 + 2, phase)] = x2;
+        state_bs[fix_index(i * 4 + 3, phase)] = x3;
     }
 
-    add_round_key(state_bs, key + 2, CORE1);
+    INSTRUMENT_END(INSTRUMENT_SBOX_LAYER);
+}
 
-    MULTICORE_BARRIER();
+static const uint8_t sbox_inv[16] = {0x5, 0xE, 0xF, 0x8, 0xC, 0x1, 0x2, 0xD, 0xB, 0x4, 0x6, 0x3, 0x0, 0x7, 0x9, 0xA};
 
-    unslice(state_bs, pt, CORE1);
+/**
+ * @brief Key register in native words.
+ *
+ * The round key is the leftmost 64 bits, which are always hi. lo has the remaining 16 bits of an 80-bit key or 64 bits
+ * of a 128-bit key, so a step of the key schedule is a few shifts instead of one per byte.
+ */
+typedef struct
+{
+    uint64_t hi;
+    uint64_t lo;
+} key_reg_t;
 
-    MULTICORE_BARRIER();
+/**
+ * @brief Load a key register from bytes, little endian like the blocks.
+ *
+ * @param k Output: key register
+ * @param key key bytes
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ */
+static void load_key(key_reg_t *k, const uint8_t *key, uint8_t key_size)
+{
+    k->lo = 0;
+    memcpy(&k->lo, key, key_size - CRYPTO_IN_SIZE);
+    memcpy(&k->hi, key + key_size - CRYPTO_IN_SIZE, CRYPTO_IN_SIZE);
 }
 
 /**
- * @brief Encryption in multicore mode.
- * 
- * We use two cores to run the encryption.
- * 
- * The process is like following:
- * 
- * core0                        core1
- * 
- * launch core1
- * send parameters              receive parameters
+ * @brief Store a key register as bytes, the inverse of load_key.
  *
- * enslice                      enslice
- * --------------barrier---------------- We need to wait for two cores finishing enslice.
- * Loop {                       Loop {
- * add_round_key                add_round_key
- * sbox_layer                   sbox_layer
- * pbox_layer                   pbox_layer
- * --------------barrier----------------- We need to wait for two cores finishing pbox_layer of current round before update_round_key.
- * copy(state_bs, state_tmp)
- * update_rouond_key
- * --------------barrier------------------ We only copy and update_round_key in core0 so core1 will only wait for core0 finishing that.
- * }                            }
- *
- * add_round_key                add_round_key
- * memset(pt, 0)
- * --------------barrier--------------------- We need to wait for two cores have all finished last add_round_key before unslice and core0 will set pt to 0 additionally.
- * unslice                      unslice
- * ---------------barrier--------------------- We need to make sure two cores have all finished unslice before exit this function.
+ * @param k key register
+ * @param key Output: key bytes
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
  */
-static void encrypt(uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], uint8_t key[CRYPTO_KEY_SIZE])
+static void store_key(const key_reg_t *k, uint8_t *key, uint8_t key_size)
 {
-    bs_reg_t state_tmp[CRYPTO_IN_SIZE_BIT];
+    memcpy(key, &k->lo, key_size - CRYPTO_IN_SIZE);
+    memcpy(key + key_size - CRYPTO_IN_SIZE, &k->hi, CRYPTO_IN_SIZE);
+}
 
-    multicore_reset_core1();
-    multicore_launch_core1(encrypt_core1);
+/**
+ * @brief Perform next key schedule step, key_schedule_step of present_core.h.
+ * @param k Key register to be updated
+ * @param r Round counter
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ * @warning For correct function, has to be called with incremented r each time.
+ */
+static void update_round_key(key_reg_t *k, const uint8_t r, uint8_t key_size)
+{
+    INSTRUMENT_BEGIN();
 
-    multicore_fifo_push_blocking(pt);
-    multicore_fifo_push_blocking(state_bs);
-    multicore_fifo_push_blocking(key);
-    multicore_fifo_push_blocking(state_tmp);
+    key_schedule_step(&k->hi, &k->lo, r, key_size);
 
-    enslice(pt, state_bs, CORE0);
+    INSTRUMENT_END(INSTRUMENT_UPDATE_ROUND_KEY);
+}
 
-    MULTICORE_BARRIER();
+/**
+ * @brief Undo update_round_key, so the round keys can be derived backwards from the key register after the last round.
+ * @param k Key register to be updated
+ * @param r Round counter that was passed to update_round_key
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ * @warning For correct function, has to be called with decremented r each time.
+ */
+static void inv_update_round_key(key_reg_t *k, const uint8_t r, uint8_t key_size)
+{
+    INSTRUMENT_BEGIN();
 
-    for (uint8_t i = 1; i <= 31; i++)
+    if (key_size == CRYPTO_KEY_SIZE_128)
     {
-        add_round_key(state_bs, key + 2, CORE0);
-        sbox_layer(state_bs, CORE0);
-        pbox_layer(state_bs, state_tmp, CORE0);
+        // XOR round counter k66 ... k62
+        k->lo ^= (uint64_t)r << 62;
+        k->hi ^= r >> 2;
 
-        MULTICORE_BARRIER();
+        // perform sbox_inv lookup on the two nibbles of MSbits
+        k->hi = (k->hi & 0x00FFFFFFFFFFFFFFULL) | (uint64_t)sbox_inv[k->hi >> 60] << 60 | (uint64_t)sbox_inv[(k->hi >> 56) & 0xF] << 56;
 
-        memcpy(state_bs, state_tmp, 4 * CRYPTO_IN_SIZE_BIT);
-        update_round_key(key, i);
+        const uint64_t hi = k->hi;
+        const uint64_t lo = k->lo;
 
-        MULTICORE_BARRIER();
+        // rotate right by 61 bit
+        k->hi = hi >> 61 | lo << 3;
+        k->lo = lo >> 61 | hi << 3;
     }
+    else
+    {
+        // XOR round counter k19 ... k15
+        k->lo ^= (uint16_t)(r << 15);
+        k->hi ^= r >> 1;
 
-    add_round_key(state_bs, key + 2, CORE0);
-    memset(pt, 0u, CRYPTO_IN_SIZE * BITSLICE_WIDTH);
+        // perform sbox_inv lookup on MSbits
+        k->hi = (k->hi & 0x0FFFFFFFFFFFFFFFULL) | (uint64_t)sbox_inv[k->hi >> 60] << 60;
 
-    MULTICORE_BARRIER();
+        const uint64_t hi = k->hi;
+        const uint64_t lo = k->lo;
 
-    unslice(state_bs, pt, CORE0);
+        // rotate left by 19 bit
+        k->hi = hi << 19 | lo << 3 | hi >> 61;
+        k->lo = (uint16_t)(hi >> 45);
+    }
 
-    MULTICORE_BARRIER();
+    INSTRUMENT_END(INSTRUMENT_UPDATE_ROUND_KEY);
 }
+
+#ifdef PRESENT_BS_KERNELS
+// encrypt_rounds_kernel and, with a key given to gen_kernels.py, encrypt_rounds_fixed_key.
+#include "present_bs_rounds.h"
 #endif
 
-void crypto_func(uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], uint8_t key[CRYPTO_KEY_SIZE])
+/**
+ * @brief All rounds of encryption, between enslice and unslice.
+ *
+ * In normal behavour, each round of a period of 3 has its own slice order, which is a constant here.
+ * If OPTIMIZATION_MULTICORE, each core runs this with its own core_id and there is a barrier after each round,
+ * or one core runs all of it with CORE_ALL.
+ * If PRESENT_BS_KERNELS, all 31 rounds are unrolled by gen_kernels.py, so every slice index is a constant. They call
+ * sbox_slices directly, which leaves the add_round_key and sbox_layer stages of INSTRUMENT empty.
+ *
+ * @param state_bs bitsliced state in phase 0, ends in phase FIX_PHASE(CRYPTO_ROUNDS)
+ * @param expanded expanded key
+ * @param core_id id of core only available when OPTIMIZATION_MULTICORE
+ */
+static void encrypt_rounds(bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], const present_expanded_key_t *expanded
+#ifdef OPTIMIZATION_MULTICORE
+                          ,uint8_t core_id
+#endif
+)
 {
-    // State buffer and additional backbuffer of same size.
-    bs_reg_t state[CRYPTO_IN_SIZE_BIT] = {0u};
+#if defined(PRESENT_BS_KERNELS) && defined(OPTIMIZATION_MULTICORE)
+    encrypt_rounds_kernel(state_bs, expanded, core_id);
+#elif defined(PRESENT_BS_KERNELS)
+    encrypt_rounds_kernel(state_bs, expanded);
+#elif defined(OPTIMIZATION_MULTICORE)
+    for (uint8_t i = 1; i <= CRYPTO_ROUNDS; i++)
+    {
+        add_round_key(state_bs, expanded->round_key_bs[i - 1], FIX_PHASE(i - 1), core_id);
+        sbox_layer(state_bs, FIX_PHASE(i - 1), core_id);
 
-#ifdef OPTIMIZATION_MULTICORE
-    encrypt(pt, state, key);
+        MULTICORE_SYNC(core_id);
+    }
+
+    add_round_key(state_bs, expanded->round_key_bs[CRYPTO_ROUNDS], FIX_PHASE(CRYPTO_ROUNDS), core_id);
 #else
-    // Bring into bitslicing form.
-    enslice(pt, state);
+    uint8_t i;
+
+    for (i = 0; i + 3 <= CRYPTO_ROUNDS; i += 3)
+    {
+        add_round_key(state_bs, expanded->round_key_bs[i], 0);
+        sbox_layer(state_bs, 0);
+        add_round_key(state_bs, expanded->round_key_bs[i + 1], 1);
+        sbox_layer(state_bs, 1);
+        add_round_key(state_bs, expanded->round_key_bs[i + 2], 2);
+        sbox_layer(state_bs, 2);
+    }
 
-    // Encrypt.
-    for (uint8_t i = 1; i <= 31; i++)
+    for (; i < CRYPTO_ROUNDS; i++)
     {
-        add_round_key(state, key + 2);
-        sbox_layer(state);
-        pbox_layer(state);
-        update_round_key(key, i);
+        add_round_key(state_bs, expanded->round_key_bs[i], FIX_PHASE(i));
+        sbox_layer(state_bs, FIX_PHASE(i));
     }
 
-    add_round_key(state, key + 2);
+    add_round_key(state_bs, expanded->round_key_bs[CRYPTO_ROUNDS], FIX_PHASE(CRYPTO_ROUNDS));
+#endif
+}
 
-    // Convert back to normal form.
-    memset(pt, 0u, CRYPTO_IN_SIZE * BITSLICE_WIDTH);
-    unslice(state, pt);
+/**
+ * @brief All rounds of decryption, between enslice and unslice.
+ *
+ * Round i is undone in the slice order it was done in, which is FIX_PHASE(i - 1). The inverse permutation layer
+ * is as free as the permutation layer: it only changes the slice order from FIX_PHASE(i) back to FIX_PHASE(i - 1).
+ *
+ * In normal behavour, the rounds that do not fill a period of 3 are undone first, then whole periods with constant slice orders.
+ * If OPTIMIZATION_MULTICORE, each core runs this with its own core_id and there is a barrier before each inv_sbox_layer,
+ * or one core runs all of it with CORE_ALL.
+ *
+ * @param state_bs bitsliced state in phase FIX_PHASE(CRYPTO_ROUNDS), ends in phase 0
+ * @param expanded expanded key
+ * @param core_id id of core only available when OPTIMIZATION_MULTICORE
+ */
+static void decrypt_rounds(bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], const present_expanded_key_t *expanded
+#ifdef OPTIMIZATION_MULTICORE
+                          ,uint8_t core_id
 #endif
-}
\ No newline at end of file
+)
+{
+#ifdef OPTIMIZATION_MULTICORE
+    add_round_key(state_bs, expanded->round_key_bs[CRYPTO_ROUNDS], FIX_PHASE(CRYPTO_ROUNDS), core_id);
+
+    for (uint8_t i = CRYPTO_ROUNDS; i >= 1; i--)
+    {
+        MULTICORE_SYNC(core_id);
+
+        inv_sbox_layer(state_bs, FIX_PHASE(i - 1), core_id);
+        add_round_key(state_bs, expanded->round_key_bs[i - 1], FIX_PHASE(i - 1), core_id);
+    }
+#else
+    uint8_t i;
+
+    add_round_key(state_bs, expanded->round_key_bs[CRYPTO_ROUNDS], FIX_PHASE(CRYPTO_ROUNDS));
+
+    for (i = CRYPTO_ROUNDS; i % 3 != 0; i--)
+    {
+        inv_sbox_layer(state_bs, FIX_PHASE(i - 1));
+        add_round_key(state_bs, expanded->round_key_bs[i - 1], FIX_PHASE(i - 1));
+    }
+
+    for (; i != 0; i -= 3)
+    {
+        inv_sbox_layer(state_bs, 2);
+        add_round_key(state_bs, expanded->round_key_bs[i - 1], 2);
+        inv_sbox_layer(state_bs, 1);
+        add_round_key(state_bs, expanded->round_key_bs[i - 2], 1);
+        inv_sbox_layer(state_bs, 0);
+        add_round_key(state_bs, expanded->round_key_bs[i - 3], 0);
+    }
+#endif
+}
+
+/**
+ * @brief Position in a list of fragments, see present_encrypt_iov.
+ */
+typedef struct
+{
+    const present_iovec_t *iov;
+    size_t index;
+    size_t offset;
+} iov_cursor_t;
+
+/**
+ * @brief The next block if it lies in one fragment.
+ *
+ * @param c cursor, moved past the block unless NULL is returned
+ *
+ * @return the block in its fragment, or NULL if it is split between fragments
+ */
+static inline uint8_t *iov_block(iov_cursor_t *c)
+{
+    while (c->offset == c->iov[c->index].len)
+    {
+        c->index++;
+        c->offset = 0;
+    }
+
+    if (c->iov[c->index].len - c->offset < CRYPTO_IN_SIZE)
+    {
+        return NULL;
+    }
+
+    c->offset += CRYPTO_IN_SIZE;
+
+    return (uint8_t *)c->iov[c->index].base + c->offset - CRYPTO_IN_SIZE;
+}
+
+/**
+ * @brief Copy a block that is split between fragments from or to them.
+ *
+ * @param c cursor, moved past the block
+ * @param block the block
+ * @param write whether to copy block into the fragments instead of out of them
+ */
+static void iov_copy(iov_cursor_t *c, uint8_t block[CRYPTO_IN_SIZE], bool write)
+{
+    for (uint8_t b = 0; b < CRYPTO_IN_SIZE; )
+    {
+        size_t len = c->iov[c->index].len - c->offset;
+        uint8_t *frag = (uint8_t *)c->iov[c->index].base + c->offset;
+
+        if (len == 0)
+        {
+            c->index++;
+            c->offset = 0;
+            continue;
+        }
+
+        if (len > (size_t)(CRYPTO_IN_SIZE - b))
+        {
+            len = CRYPTO_IN_SIZE - b;
+        }
+
+        if (write)
+        {
+            memcpy(frag, block + b, len);
+        }
+        else
+        {
+            memcpy(block + b, frag, len);
+        }
+
+        c->offset += len;
+        b += len;
+    }
+}
+
+#ifdef OPTIMIZATION_MULTICORE
+// Flags of crypt
+#define CRYPT_DECRYPT 0x01
+// state_bs already holds the input in bitsliced form, so enslice is skipped.
+#define CRYPT_SLICED_INPUT 0x02
+// core1 runs the whole batch alone and then pushes a token back to core0, see present_encrypt_start.
+#define CRYPT_ALONE 0x04
+// The result stays in state_bs in bitsliced form, so unslice is skipped.
+#define CRYPT_SLICED_OUTPUT 0x08
+
+/**
+ * @brief Encryption or decryption on one core.
+ *
+ * @param in plaintexts or ciphertexts
+ * @param out Output: the other ones, can be in
+ * @param state_bs bitsliced state
+ * @param expanded expanded key
+ * @param flags CRYPT_DECRYPT, CRYPT_SLICED_INPUT and CRYPT_SLICED_OUTPUT
+ * @param core_id id of core, or CORE_ALL to do all of it without the other core
+ */
+static void crypt_core(const uint8_t *in, uint8_t *out, bs_reg_t *state_bs, const present_expanded_key_t *expanded, uint8_t flags, uint8_t core_id)
+{
+    bool decrypt = flags & CRYPT_DECRYPT;
+
+    if (!(flags & CRYPT_SLICED_INPUT))
+    {
+        enslice(in, state_bs, decrypt ? FIX_PHASE(CRYPTO_ROUNDS) : 0, core_id);
+
+        MULTICORE_SYNC(core_id);
+    }
+
+    if (decrypt)
+    {
+        decrypt_rounds(state_bs, expanded, core_id);
+    }
+    else
+    {
+        encrypt_rounds(state_bs, expanded, core_id);
+    }
+
+    MULTICORE_SYNC(core_id);
+
+    if (!(flags & CRYPT_SLICED_OUTPUT))
+    {
+        unslice(state_bs, out, decrypt ? 0 : FIX_PHASE(CRYPTO_ROUNDS), core_id);
+
+        MULTICORE_SYNC(core_id);
+    }
+}
+
+static void keysearch_batch(present_keysearch_t *ctx, uint64_t batch);
+static void encrypt_iov_batch(const present_expanded_key_t *expanded, iov_cursor_t *src, iov_cursor_t *dst, size_t n,
+                              bool share);
+
+/**
+ * @brief Move a cursor forward.
+ *
+ * @param c cursor
+ * @param bytes number of bytes, at most as many as are left in the fragments
+ */
+static void iov_skip(iov_cursor_t *c, size_t bytes)
+{
+    while (bytes > c->iov[c->index].len - c->offset)
+    {
+        bytes -= c->iov[c->index].len - c->offset;
+        c->index++;
+        c->offset = 0;
+    }
+
+    c->offset += bytes;
+}
+
+/**
+ * @brief Move a cursor backward.
+ *
+ * @param c cursor
+ * @param bytes number of bytes, at most as many as lie before the cursor
+ */
+static void iov_back(iov_cursor_t *c, size_t bytes)
+{
+    while (bytes > c->offset)
+    {
+        bytes -= c->offset;
+        c->index--;
+        c->offset = c->iov[c->index].len;
+    }
+
+    c->offset -= bytes;
+}
+
+/**
+ * @brief Batches shared by both cores, see crypt_batches.
+ *
+ * Batches head to tail - 1 are left. core0 takes them from the head and core1 from the tail.
+ * If search is not NULL, they are batches of candidate keys after search->next_batch instead, see present_keysearch_run.
+ * If src is not NULL, they are batches of fragments instead of in and out, see present_encrypt_iov.
+ */
+typedef struct
+{
+    const uint8_t *in;
+    uint8_t *out;
+    const present_expanded_key_t *expanded;
+    uint8_t flags;
+    size_t head;
+    size_t tail;
+    present_keysearch_t *search;
+    // Cursors of each core, at the start of the next batch of core0 and of the last batch of core1.
+    iov_cursor_t *src;
+    iov_cursor_t *dst;
+} batch_queue_t;
+
+/**
+ * @brief Take the next batch from the queue.
+ *
+ * Each core starts at its own end, so they only meet at the last batch. When one core is slower, for example because
+ * it is also serving interrupts, the other one simply goes on past the middle and takes over the rest of its batches.
+ *
+ * @param queue shared queue
+ * @param core_id id of core
+ * @param batch Output: index of the batch
+ *
+ * @return false if there is no batch left
+ */
+static bool batch_queue_take(batch_queue_t *queue, uint8_t core_id, size_t *batch)
+{
+    bool found;
+    uint32_t saved = platform_lock();
+
+    found = queue->head < queue->tail;
+
+    if (found)
+    {
+        *batch = core_id == CORE0 ? queue->head++ : --queue->tail;
+    }
+
+    platform_unlock(saved);
+
+    return found;
+}
+
+/**
+ * @brief Work on whole batches from the queue until it is empty.
+ *
+ * @param queue shared queue
+ * @param core_id id of core
+ */
+static void batch_queue_run(batch_queue_t *queue, uint8_t core_id)
+{
+    // State buffer of this core.
+    bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT];
+    size_t batch;
+
+    while (batch_queue_take(queue, core_id, &batch))
+    {
+        if (queue->search != NULL)
+        {
+            keysearch_batch(queue->search, queue->search->next_batch + batch);
+            continue;
+        }
+
+        if (queue->src != NULL)
+        {
+            iov_cursor_t *src = &queue->src[core_id];
+            iov_cursor_t *dst = &queue->dst[core_id];
+
+            if (core_id == CORE0)
+            {
+                encrypt_iov_batch(queue->expanded, src, dst, BITSLICE_WIDTH, false);
+                continue;
+            }
+
+            // core1 goes backward, so its cursors stay at the start of its batch.
+            iov_back(src, CRYPTO_IN_SIZE * BITSLICE_WIDTH);
+            iov_back(dst, CRYPTO_IN_SIZE * BITSLICE_WIDTH);
+
+            iov_cursor_t s = *src;
+            iov_cursor_t d = *dst;
+
+            encrypt_iov_batch(queue->expanded, &s, &d, BITSLICE_WIDTH, false);
+            continue;
+        }
+
+        size_t offset = batch * CRYPTO_IN_SIZE * BITSLICE_WIDTH;
+
+        crypt_core(queue->in + offset, queue->out + offset, state_bs, queue->expanded, queue->flags, CORE_ALL);
+    }
+
+    // The caller may only return when the other core is done as well.
+    MULTICORE_BARRIER();
+}
+
+/**
+ * @brief Job descriptor that core0 passes to core1 through the FIFO, see crypt.
+ *
+ * Either one batch split inside each round, or a queue of batches if queue is not NULL.
+ */
+typedef struct
+{
+    uint8_t *pt;
+    bs_reg_t *state_bs;
+    const present_expanded_key_t *expanded;
+    uint8_t flags;
+    batch_queue_t *queue;
+} crypt_job_t;
+
+/**
+ * @brief Run the part of a job that belongs to a core.
+ *
+ * @param job job descriptor
+ * @param core_id id of core
+ */
+static void crypt_job(const crypt_job_t *job, uint8_t core_id)
+{
+    if (job->queue != NULL)
+    {
+        batch_queue_run(job->queue, core_id);
+    }
+    else if (job->flags & CRYPT_ALONE)
+    {
+        crypt_core(job->pt, job->pt, job->state_bs, job->expanded, job->flags & CRYPT_DECRYPT, CORE_ALL);
+        platform_fifo_push_blocking(1);
+    }
+    else
+    {
+        crypt_core(job->pt, job->pt, job->state_bs, job->expanded, job->flags, core_id);
+    }
+}
+
+// Whether crypt_worker is running on core1, see present_worker_start.
+static bool worker_running = false;
+
+// Job of present_encrypt_start, which must stay valid until present_encrypt_finish.
+static bs_reg_t alone_state_bs[CRYPTO_IN_SIZE_BIT];
+static crypt_job_t alone_job;
+static bool alone_pending = false;
+
+/**
+ * @brief Encryption or decryption running on core1, one job per launch.
+ *
+ */
+static void crypt_core1()
+{
+    const crypt_job_t *job = (const crypt_job_t *)platform_fifo_pop_blocking();
+
+    crypt_job(job, CORE1);
+}
+
+/**
+ * @brief Persistent worker on core1, which runs jobs until it gets NULL.
+ *
+ * core0 only waits for the last barrier of a job before it returns, so the next job is queued behind that barrier
+ * in the FIFO and core1 sees them in the right order.
+ */
+static void crypt_worker()
+{
+    const crypt_job_t *job;
+
+    while ((job = (const crypt_job_t *)platform_fifo_pop_blocking()) != NULL)
+    {
+        crypt_job(job, CORE1);
+    }
+}
+
+/**
+ * @brief Run a job on both cores.
+ *
+ * If present_worker_start was called, core1 is already waiting for jobs. Otherwise it is launched for this job only,
+ * which costs a reset and a launch of core1 each time.
+ *
+ * @param job job descriptor, which must stay valid until the job is done
+ */
+static void dispatch(const crypt_job_t *job)
+{
+    // core1 takes jobs in order, and the token of a batch in flight would be taken for a barrier.
+    present_encrypt_finish();
+
+    if (!worker_running)
+    {
+        platform_core1_reset();
+        platform_core1_launch(crypt_core1);
+    }
+
+    platform_fifo_push_blocking((uintptr_t)job);
+
+    crypt_job(job, CORE0);
+}
+
+/**
+ * @brief Encryption or decryption in multicore mode.
+ * 
+ * We use two cores to run the encryption.
+ * 
+ * The process is like following:
+ * 
+ * core0                        core1
+ * 
+ * launch core1
+ * send parameters              receive parameters
+ *
+ * enslice                      enslice
+ * --------------barrier---------------- We need to wait for two cores finishing enslice.
+ * Loop {                       Loop {
+ * add_round_key                add_round_key
+ * sbox_layer                   sbox_layer
+ * --------------barrier----------------- The next round has another slice order, so each core will read slices the other one wrote.
+ * }                            }
+ *
+ * add_round_key                add_round_key
+ * --------------barrier--------------------- We need to wait for two cores have all finished last add_round_key before unslice.
+ * unslice                      unslice
+ * ---------------barrier--------------------- We need to make sure two cores have all finished unslice before exit this function.
+ *
+ * Decryption is split the same way, with the barrier of each round before inv_sbox_layer.
+ * With CRYPT_SLICED_INPUT, core0 has written state_bs before it passed the job to core1, so enslice and its barrier are left out.
+ *
+ * @param pt Input: plaintexts or ciphertexts, Output: the other ones
+ * @param state_bs bitsliced state
+ * @param expanded expanded key
+ * @param flags CRYPT_DECRYPT and CRYPT_SLICED_INPUT
+ */
+static void crypt(uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT], const present_expanded_key_t *expanded, uint8_t flags)
+{
+    crypt_job_t job = {pt, state_bs, expanded, flags, NULL};
+
+    dispatch(&job);
+}
+
+/**
+ * @brief Encryption or decryption of many batches in multicore mode.
+ *
+ * Each core works on whole batches on its own, see batch_queue_take, so there is only one barrier at the end instead
+ * of two per round and batch.
+ *
+ * @param in plaintexts or ciphertexts
+ * @param out Output: the other ones, can be in
+ * @param batches number of batches of BITSLICE_WIDTH blocks
+ * @param expanded expanded key
+ * @param flags CRYPT_DECRYPT
+ */
+static void crypt_batches(const uint8_t *in, uint8_t *out, size_t batches, const present_expanded_key_t *expanded, uint8_t flags)
+{
+    batch_queue_t queue = {in, out, expanded, flags, 0, batches, NULL, NULL, NULL};
+    crypt_job_t job = {NULL, NULL, NULL, 0, &queue};
+
+    dispatch(&job);
+}
+
+#endif
+
+void present_worker_start(void)
+{
+#ifdef OPTIMIZATION_MULTICORE
+    if (!worker_running)
+    {
+        platform_core1_reset();
+        platform_core1_launch(crypt_worker);
+        worker_running = true;
+    }
+#endif
+}
+
+void present_worker_stop(void)
+{
+#ifdef OPTIMIZATION_MULTICORE
+    present_encrypt_finish();
+
+    if (worker_running)
+    {
+        platform_fifo_push_blocking((uintptr_t)NULL);
+        platform_core1_reset();
+        worker_running = false;
+    }
+#endif
+}
+
+/**
+ * @brief Store a round key as masks.
+ *
+ * @param round_key_bs Output: masks of the round key
+ * @param round_key round key, the leftmost 64 bits of the key register
+ * @param phase slice order of the round the key belongs to
+ */
+static void slice_round_key(bs_reg_t round_key_bs[CRYPTO_IN_SIZE_BIT], uint64_t round_key, uint8_t phase)
+{
+    for (uint8_t i = 0; i < CRYPTO_IN_SIZE_BIT; i++)
+    {
+        round_key_bs[fix_index(i, phase)] = (round_key >> i) & 0x01 ? BS_ONES : BS_ZERO;
+    }
+}
+
+/**
+ * @brief Run the key schedule once for all rounds, see present_expand_key.
+ *
+ * @param expanded Output: expanded key
+ * @param key Input: key, left unchanged
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ */
+static void expand_key(present_expanded_key_t *expanded, const uint8_t *key, uint8_t key_size)
+{
+    key_reg_t k;
+
+    load_key(&k, key, key_size);
+    expanded->lane_keys = 0;
+
+    for (uint8_t r = 0; r <= CRYPTO_ROUNDS; r++)
+    {
+        // Stored in the slice order of round r + 1.
+        slice_round_key(expanded->round_key_bs[r], k.hi, FIX_PHASE(r));
+        expanded->round_key[r] = k.hi;
+
+        if (r < CRYPTO_ROUNDS)
+        {
+            update_round_key(&k, r + 1, key_size);
+        }
+    }
+}
+
+/**
+ * @brief Run the key schedule once backwards, see present_expand_decryption_key.
+ *
+ * @param expanded Output: expanded key
+ * @param key Input: key register after the last round, left unchanged
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ */
+static void expand_decryption_key(present_expanded_key_t *expanded, const uint8_t *key, uint8_t key_size)
+{
+    key_reg_t k;
+
+    load_key(&k, key, key_size);
+    expanded->lane_keys = 0;
+
+    for (uint8_t r = CRYPTO_ROUNDS; ; r--)
+    {
+        slice_round_key(expanded->round_key_bs[r], k.hi, FIX_PHASE(r));
+        expanded->round_key[r] = k.hi;
+
+        if (r == 0)
+        {
+            break;
+        }
+
+        inv_update_round_key(&k, r, key_size);
+    }
+}
+
+/**
+ * @brief Run the key schedule forward once, see crypto_decryption_key.
+ *
+ * @param key Input: key, Output: key register after the last round
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ */
+static void decryption_key(uint8_t *key, uint8_t key_size)
+{
+    key_reg_t k;
+
+    load_key(&k, key, key_size);
+
+    for (uint8_t r = 1; r <= CRYPTO_ROUNDS; r++)
+    {
+        update_round_key(&k, r, key_size);
+    }
+
+    store_key(&k, key, key_size);
+}
+
+void present_expand_key(present_expanded_key_t *expanded, const uint8_t key[CRYPTO_KEY_SIZE])
+{
+    expand_key(expanded, key, CRYPTO_KEY_SIZE);
+}
+
+void present_expand_key_128(present_expanded_key_t *expanded, const uint8_t key[CRYPTO_KEY_SIZE_128])
+{
+    expand_key(expanded, key, CRYPTO_KEY_SIZE_128);
+}
+
+void present_expand_decryption_key(present_expanded_key_t *expanded, const uint8_t key[CRYPTO_KEY_SIZE])
+{
+    expand_decryption_key(expanded, key, CRYPTO_KEY_SIZE);
+}
+
+void present_expand_decryption_key_128(present_expanded_key_t *expanded, const uint8_t key[CRYPTO_KEY_SIZE_128])
+{
+    expand_decryption_key(expanded, key, CRYPTO_KEY_SIZE_128);
+}
+
+void crypto_decryption_key(uint8_t key[CRYPTO_KEY_SIZE])
+{
+    decryption_key(key, CRYPTO_KEY_SIZE);
+}
+
+void crypto_decryption_key_128(uint8_t key[CRYPTO_KEY_SIZE_128])
+{
+    decryption_key(key, CRYPTO_KEY_SIZE_128);
+}
+
+/**
+ * @brief Bring BITSLICE_WIDTH keys into bitsliced form, one key per lane.
+ *
+ * Like enslice, with rows of key_size bytes. The last tile of an 80-bit key is only partly filled, the missing bits are zero.
+ *
+ * @param keys BITSLICE_WIDTH keys, the key of lane j at keys + j * key_size
+ * @param key_bs Output: slice k holds bit k of each key
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ */
+static void enslice_keys(const uint8_t *keys, bs_reg_t key_bs[CRYPTO_KEY_SIZE_128_BIT], uint8_t key_size)
+{
+    for (uint8_t g = 0; g < BITSLICE_WORDS; g++)
+    {
+        for (uint8_t t = 0; t * sizeof(bs_word_t) < key_size; t++)
+        {
+            bs_word_t m[BS_WORD_BITS];
+            uint8_t bytes = key_size - t * sizeof(bs_word_t);
+
+            if (bytes > sizeof(bs_word_t))
+            {
+                bytes = sizeof(bs_word_t);
+            }
+
+            for (uint8_t j = 0; j < BS_WORD_BITS; j++)
+            {
+                m[j] = 0u;
+                memcpy(&m[j], keys + (g * BS_WORD_BITS + j) * key_size + t * sizeof(bs_word_t), bytes);
+            }
+
+            transpose(m);
+
+            for (uint8_t i = 0; i < BS_WORD_BITS && t * BS_WORD_BITS + i < key_size * 8; i++)
+            {
+                memcpy((uint8_t *)&key_bs[t * BS_WORD_BITS + i] + g * sizeof(bs_word_t), &m[i], sizeof(bs_word_t));
+            }
+        }
+    }
+}
+
+/**
+ * @brief Index in key_bs of bit i of the key register.
+ *
+ * The rotation of the key schedule is not done by moving slices either: bit i of the key register is in
+ * key_bs[(i + offset) % key_bits], and each rotation right by n bits adds n to offset.
+ *
+ * @param i bit of the key register
+ * @param offset rotation so far
+ * @param key_bits size of the key register in bits
+ *
+ * @return index in key_bs
+ */
+static inline uint8_t key_index(uint8_t i, uint8_t offset, uint8_t key_bits)
+{
+    uint8_t k = i + offset;
+
+    return k >= key_bits ? k - key_bits : k;
+}
+
+/**
+ * @brief update_round_key on the bitsliced key registers of all lanes.
+ *
+ * @param key_bs bitsliced key registers
+ * @param offset Input and Output: rotation so far, see key_index
+ * @param r Round counter
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ */
+static void update_round_key_bs(bs_reg_t key_bs[CRYPTO_KEY_SIZE_128_BIT], uint8_t *offset, const uint8_t r, uint8_t key_size)
+{
+    INSTRUMENT_BEGIN();
+
+    uint8_t key_bits = key_size * 8;
+    // Lowest bit of the round counter
+    uint8_t counter = key_size == CRYPTO_KEY_SIZE_128 ? 62 : 15;
+
+    // rotate left by 61 bit, which is right by key_bits - 61
+    *offset = key_index(key_bits - 61, *offset, key_bits);
+
+    // perform sbox on MSbits, two nibbles for a 128-bit key
+    for (uint8_t n = key_bits - 4; n >= key_bits - (key_size == CRYPTO_KEY_SIZE_128 ? 8 : 4); n -= 4)
+    {
+        sbox_slices(&key_bs[key_index(n, *offset, key_bits)], &key_bs[key_index(n + 1, *offset, key_bits)],
+                    &key_bs[key_index(n + 2, *offset, key_bits)], &key_bs[key_index(n + 3, *offset, key_bits)]);
+    }
+
+    // XOR round counter, which is the same in all lanes
+    for (uint8_t b = 0; b < 5; b++)
+    {
+        if ((r >> b) & 0x01)
+        {
+            key_bs[key_index(counter + b, *offset, key_bits)] ^= BS_ONES;
+        }
+    }
+
+    INSTRUMENT_END(INSTRUMENT_UPDATE_ROUND_KEY);
+}
+
+/**
+ * @brief Run the key schedule for a different key in each lane, see present_expand_lane_keys.
+ *
+ * @param expanded Output: expanded key
+ * @param keys BITSLICE_WIDTH keys, the key of block j at keys + j * key_size
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ */
+static void expand_lane_keys(present_expanded_key_t *expanded, const uint8_t *keys, uint8_t key_size)
+{
+    bs_reg_t key_bs[CRYPTO_KEY_SIZE_128_BIT];
+    uint8_t key_bits = key_size * 8;
+    uint8_t offset = 0;
+
+    enslice_keys(keys, key_bs, key_size);
+    expanded->lane_keys = 1;
+
+    for (uint8_t r = 0; r <= CRYPTO_ROUNDS; r++)
+    {
+        // Round key is the leftmost 64 bits of the key register, stored in the slice order of round r + 1.
+        for (uint8_t i = 0; i < CRYPTO_IN_SIZE_BIT; i++)
+        {
+            expanded->round_key_bs[r][fix_index(i, FIX_PHASE(r))] = key_bs[key_index(key_bits - CRYPTO_IN_SIZE_BIT + i, offset, key_bits)];
+        }
+
+        if (r < CRYPTO_ROUNDS)
+        {
+            update_round_key_bs(key_bs, &offset, r + 1, key_size);
+        }
+    }
+}
+
+void present_expand_lane_keys(present_expanded_key_t *expanded, const uint8_t keys[CRYPTO_KEY_SIZE * BITSLICE_WIDTH])
+{
+    expand_lane_keys(expanded, keys, CRYPTO_KEY_SIZE);
+}
+
+void present_expand_lane_keys_128(present_expanded_key_t *expanded, const uint8_t keys[CRYPTO_KEY_SIZE_128 * BITSLICE_WIDTH])
+{
+    expand_lane_keys(expanded, keys, CRYPTO_KEY_SIZE_128);
+}
+
+void present_encrypt_expanded(const present_expanded_key_t *expanded, uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH])
+{
+    // State buffer.
+    bs_reg_t state[CRYPTO_IN_SIZE_BIT] = {0u};
+
+#ifdef OPTIMIZATION_MULTICORE
+    crypt(pt, state, expanded, 0);
+#else
+    // Bring into bitslicing form.
+    enslice(pt, state, 0);
+
+    encrypt_rounds(state, expanded);
+
+    // Convert back to normal form.
+    unslice(state, pt, FIX_PHASE(CRYPTO_ROUNDS));
+#endif
+}
+
+#ifdef PRESENT_BS_FIXED_KEY
+void present_encrypt_fixed_key(uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH])
+{
+    // State buffer.
+    bs_reg_t state[CRYPTO_IN_SIZE_BIT] = {0u};
+
+#ifdef OPTIMIZATION_MULTICORE
+    enslice(pt, state, 0, CORE_ALL);
+    encrypt_rounds_fixed_key(state);
+    unslice(state, pt, FIX_PHASE(CRYPTO_ROUNDS), CORE_ALL);
+#else
+    enslice(pt, state, 0);
+    encrypt_rounds_fixed_key(state);
+    unslice(state, pt, FIX_PHASE(CRYPTO_ROUNDS));
+#endif
+}
+#endif
+
+void crypto_func(uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], uint8_t key[CRYPTO_KEY_SIZE])
+{
+    // Too large for the stack of core0 on the pico.
+    static present_expanded_key_t expanded;
+
+    present_expand_key(&expanded, key);
+    present_encrypt_expanded(&expanded, pt);
+}
+
+void crypto_func_128(uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], uint8_t key[CRYPTO_KEY_SIZE_128])
+{
+    // Too large for the stack of core0 on the pico.
+    static present_expanded_key_t expanded;
+
+    present_expand_key_128(&expanded, key);
+    present_encrypt_expanded(&expanded, pt);
+}
+
+void present_decrypt_expanded(const present_expanded_key_t *expanded, uint8_t ct[CRYPTO_IN_SIZE * BITSLICE_WIDTH])
+{
+    // State buffer.
+    bs_reg_t state[CRYPTO_IN_SIZE_BIT] = {0u};
+
+#ifdef OPTIMIZATION_MULTICORE
+    crypt(ct, state, expanded, CRYPT_DECRYPT);
+#else
+    // Bring into bitslicing form, in the slice order encryption ends with.
+    enslice(ct, state, FIX_PHASE(CRYPTO_ROUNDS));
+
+    decrypt_rounds(state, expanded);
+
+    // Convert back to normal form.
+    unslice(state, ct, 0);
+#endif
+}
+
+void present_encrypt_batches(const present_expanded_key_t *expanded, uint8_t *pt, size_t batches)
+{
+#ifdef OPTIMIZATION_MULTICORE
+    // A single batch is faster when both cores share each round.
+    if (batches > 1)
+    {
+        crypt_batches(pt, pt, batches, expanded, 0);
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < batches; i++)
+    {
+        present_encrypt_expanded(expanded, pt + i * CRYPTO_IN_SIZE * BITSLICE_WIDTH);
+    }
+}
+
+/**
+ * @brief Swap the bits of s selected by mask with the bits n places above them.
+ *
+ * The same as in Present_ref, which is built on its own and shares no sources with present_bs.
+ */
+static inline uint64_t delta_swap(uint64_t s, uint64_t mask, uint8_t n)
+{
+    uint64_t t = ((s >> n) ^ s) & mask;
+
+    return s ^ t ^ (t << n);
+}
+
+/**
+ * @brief sbox_layer and pbox_layer of one block without tables, like OPTIMIZATION_NIBBLE_SLICE of Present_ref.
+ *
+ * The permutation is 4 delta swaps, see nibble_pbox there. It brings bit j of nibble n to bit 16 * j + n, so after it
+ * the block is four 16-bit bit-planes, and SBOX_CIRCUIT of sbox_slices on them is the S-box of all 16 nibbles, already
+ * in the order of the next state. The planes are 64-bit words, since on wide slice registers sbox_slices itself would
+ * pay for vector operations on 16 useful bits. Nothing is indexed with the state, so blocks take the same time
+ * whatever their value.
+ *
+ * @param s state, bit i is bit i % 8 of byte i / 8
+ *
+ * @return new state
+ */
+static uint64_t block_sp_layer(uint64_t s)
+{
+    s = delta_swap(s, 0x0A0A0A0A0A0A0A0AULL, 3);
+    s = delta_swap(s, 0x00CC00CC00CC00CCULL, 6);
+    s = delta_swap(s, 0x0000F0F00000F0F0ULL, 12);
+    s = delta_swap(s, 0x00000000FF00FF00ULL, 24);
+
+    uint64_t x0 = s, x1 = s >> 16, x2 = s >> 32, x3 = s >> 48;
+
+    SBOX_CIRCUIT(uint64_t, x0, x1, x2, x3);
+
+    return (x0 & 0xFFFF) | (x1 & 0xFFFF) << 16 | (x2 & 0xFFFF) << 32 | x3 << 48;
+}
+
+void present_encrypt_block(const present_expanded_key_t *expanded, uint8_t pt[CRYPTO_IN_SIZE])
+{
+    present_encrypt_block_rounds(expanded, pt, CRYPTO_ROUNDS);
+}
+
+void present_encrypt_block_rounds(const present_expanded_key_t *expanded, uint8_t pt[CRYPTO_IN_SIZE], uint8_t rounds)
+{
+    // The block as one word, little endian like the slices.
+    uint64_t s;
+
+    memcpy(&s, pt, CRYPTO_IN_SIZE);
+
+    for (uint8_t r = 0; r < rounds; r++)
+    {
+        s = block_sp_layer(s ^ expanded->round_key[r]);
+    }
+
+    s ^= expanded->round_key[rounds];
+
+    memcpy(pt, &s, CRYPTO_IN_SIZE);
+}
+
+/**
+ * @brief Encrypt up to BITSLICE_WIDTH blocks from fragments into fragments.
+ *
+ * Like enslice and unslice, but the rows of the tiles are read from the source fragments and written into the
+ * destination fragments where they are. Only a block split between two fragments goes through a buffer of one block.
+ * Tiles without any block are left out, and rows without a block are zero and never written back.
+ *
+ * A whole batch is shared by both cores like present_encrypt_expanded if share is set, a smaller one runs on the
+ * calling core like present_encrypt_tail.
+ *
+ * @param expanded expanded key
+ * @param src source cursor, moved past n blocks
+ * @param dst destination cursor, moved past n blocks
+ * @param n number of blocks, at most BITSLICE_WIDTH
+ * @param share whether a whole batch is shared by both cores, not on a core that takes batches from a batch queue
+ */
+static void encrypt_iov_batch(const present_expanded_key_t *expanded, iov_cursor_t *src, iov_cursor_t *dst, size_t n,
+                              bool share)
+{
+    // State buffer, the words of the lanes left out stay zero.
+    bs_reg_t state[CRYPTO_IN_SIZE_BIT] = {0u};
+    bs_word_t m[BITSLICE_TILES][BS_WORD_BITS];
+    uint8_t block[CRYPTO_IN_SIZE];
+    uint8_t groups = (n + BS_WORD_BITS - 1) / BS_WORD_BITS;
+
+    for (uint8_t g = 0; g < groups; g++)
+    {
+        for (uint8_t j = 0; j < BS_WORD_BITS; j++)
+        {
+            const uint8_t *p = NULL;
+
+            if ((size_t)g * BS_WORD_BITS + j < n && (p = iov_block(src)) == NULL)
+            {
+                iov_copy(src, block, false);
+                p = block;
+            }
+
+            for (uint8_t t = 0; t < BITSLICE_TILES; t++)
+            {
+                m[t][j] = 0;
+
+                if (p != NULL)
+                {
+                    memcpy(&m[t][j], p + t * sizeof(bs_word_t), sizeof(bs_word_t));
+                }
+            }
+        }
+
+        for (uint8_t t = 0; t < BITSLICE_TILES; t++)
+        {
+            tile_to_slices(m[t], state, 0, g, t);
+        }
+    }
+
+#ifdef OPTIMIZATION_MULTICORE
+    if (share && n == BITSLICE_WIDTH)
+    {
+        crypt(NULL, state, expanded, CRYPT_SLICED_INPUT | CRYPT_SLICED_OUTPUT);
+    }
+    else
+    {
+        // Sharing the rounds costs one barrier per round, which a short tail rarely earns back.
+        encrypt_rounds(state, expanded, CORE_ALL);
+    }
+#else
+    (void)share;
+    encrypt_rounds(state, expanded);
+#endif
+
+    for (uint8_t g = 0; g < groups; g++)
+    {
+        for (uint8_t t = 0; t < BITSLICE_TILES; t++)
+        {
+            slices_to_tile(state, m[t], FIX_PHASE(CRYPTO_ROUNDS), g, t);
+        }
+
+        for (uint8_t j = 0; j < BS_WORD_BITS && (size_t)g * BS_WORD_BITS + j < n; j++)
+        {
+            uint8_t *p = iov_block(dst);
+
+            for (uint8_t t = 0; t < BITSLICE_TILES; t++)
+            {
+                memcpy((p != NULL ? p : block) + t * sizeof(bs_word_t), &m[t][j], sizeof(bs_word_t));
+            }
+
+            if (p == NULL)
+            {
+                iov_copy(dst, block, true);
+            }
+        }
+    }
+}
+
+void present_encrypt_tail(const present_expanded_key_t *expanded, uint8_t *pt, size_t n)
+{
+    present_iovec_t v = {pt, n * CRYPTO_IN_SIZE};
+    iov_cursor_t src = {&v, 0, 0};
+    iov_cursor_t dst = {&v, 0, 0};
+
+    if (n > 0)
+    {
+        encrypt_iov_batch(expanded, &src, &dst, n, true);
+    }
+}
+
+#ifndef PRESENT_BS_TAIL_BLOCKS
+// Runs of each timing of measure_tail_blocks. The fastest counts, so an interrupt or a cold cache does not skew it.
+#define TAIL_RUNS 3
+
+// Blocks per timing of present_encrypt_block, so the counter reads do not count for much.
+#define TAIL_SINGLE_BLOCKS 8
+
+// Crossover of present_tail_blocks, 0 until its first call.
+static size_t tail_blocks;
+
+/**
+ * @brief Time one block at a time against one batch, see present_tail_blocks.
+ *
+ * A batch costs the same for all tails that fill as many tiles, so it is timed once per tile, like bench_bs does.
+ *
+ * @param expanded expanded key, not lane keys
+ *
+ * @return first tail where one batch costs at most as much as that many blocks, or BITSLICE_WIDTH
+ */
+static size_t measure_tail_blocks(const present_expanded_key_t *expanded)
+{
+    uint8_t blocks[CRYPTO_IN_SIZE * BITSLICE_WIDTH] = {0};
+    uint64_t single = UINT64_MAX, batch = 0;
+    // Called through volatile pointers, so the compiler cannot inline them and drop the blocks nobody reads.
+    void (*volatile encrypt_block)(const present_expanded_key_t *, uint8_t *) = present_encrypt_block;
+    void (*volatile encrypt_tail)(const present_expanded_key_t *, uint8_t *, size_t) = present_encrypt_tail;
+
+    for (uint8_t run = 0; run < TAIL_RUNS; run++)
+    {
+        uint64_t begin = platform_cpucycles();
+
+        for (uint8_t i = 0; i < TAIL_SINGLE_BLOCKS; i++)
+        {
+            encrypt_block(expanded, blocks + i * CRYPTO_IN_SIZE);
+        }
+
+        uint64_t cycles = (platform_cpucycles() - begin) & PLATFORM_CYCLES_MASK;
+
+        single = cycles < single ? cycles : single;
+    }
+
+    for (size_t n = 1; n < BITSLICE_WIDTH; n++)
+    {
+        if (n % BS_WORD_BITS == 1)
+        {
+            batch = UINT64_MAX;
+
+            for (uint8_t run = 0; run < TAIL_RUNS; run++)
+            {
+                uint64_t begin = platform_cpucycles();
+
+                encrypt_tail(expanded, blocks, n);
+
+                uint64_t cycles = (platform_cpucycles() - begin) & PLATFORM_CYCLES_MASK;
+
+                batch = cycles < batch ? cycles : batch;
+            }
+        }
+
+        // single is for TAIL_SINGLE_BLOCKS blocks.
+        if (batch * TAIL_SINGLE_BLOCKS <= n * single)
+        {
+            return n;
+        }
+    }
+
+    return BITSLICE_WIDTH;
+}
+#endif
+
+size_t present_tail_blocks(const present_expanded_key_t *expanded)
+{
+#ifdef PRESENT_BS_TAIL_BLOCKS
+    (void)expanded;
+
+    return PRESENT_BS_TAIL_BLOCKS;
+#else
+    if (tail_blocks == 0)
+    {
+        tail_blocks = measure_tail_blocks(expanded);
+    }
+
+    return tail_blocks;
+#endif
+}
+
+void present_encrypt_iov(const present_expanded_key_t *expanded, const present_iovec_t *src, size_t src_count,
+                         const present_iovec_t *dst, size_t dst_count)
+{
+    iov_cursor_t in = {src, 0, 0};
+    iov_cursor_t out = {dst, 0, 0};
+    size_t src_len = 0, dst_len = 0, n;
+
+    for (size_t i = 0; i < src_count; i++)
+    {
+        src_len += src[i].len;
+    }
+
+    for (size_t i = 0; i < dst_count; i++)
+    {
+        dst_len += dst[i].len;
+    }
+
+    n = (src_len < dst_len ? src_len : dst_len) / CRYPTO_IN_SIZE;
+
+#ifdef OPTIMIZATION_MULTICORE
+    // Whole batches per core like crypt_batches, instead of a barrier per round of each batch. core0 goes forward from
+    // the first batch and core1 backward from the end of the last one, each with cursors of its own.
+    if (n / BITSLICE_WIDTH > 1)
+    {
+        size_t batches = n / BITSLICE_WIDTH;
+        iov_cursor_t src_cursors[MULTICORE_CORE_NUM] = {in, in};
+        iov_cursor_t dst_cursors[MULTICORE_CORE_NUM] = {out, out};
+        batch_queue_t queue = {NULL, NULL, expanded, 0, 0, batches, NULL, src_cursors, dst_cursors};
+        crypt_job_t job = {NULL, NULL, NULL, 0, &queue};
+
+        iov_skip(&in, batches * CRYPTO_IN_SIZE * BITSLICE_WIDTH);
+        iov_skip(&out, batches * CRYPTO_IN_SIZE * BITSLICE_WIDTH);
+        src_cursors[CORE1] = in;
+        dst_cursors[CORE1] = out;
+
+        dispatch(&job);
+        n -= batches * BITSLICE_WIDTH;
+    }
+#endif
+
+    for (; n >= BITSLICE_WIDTH; n -= BITSLICE_WIDTH)
+    {
+        encrypt_iov_batch(expanded, &in, &out, BITSLICE_WIDTH, true);
+    }
+
+    if (n == 0)
+    {
+        return;
+    }
+
+    if (expanded->lane_keys || n >= present_tail_blocks(expanded))
+    {
+        encrypt_iov_batch(expanded, &in, &out, n, true);
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        uint8_t block[CRYPTO_IN_SIZE];
+        uint8_t *p = iov_block(&in);
+
+        if (p != NULL)
+        {
+            memcpy(block, p, CRYPTO_IN_SIZE);
+        }
+        else
+        {
+            iov_copy(&in, block, false);
+        }
+
+        present_encrypt_block(expanded, block);
+
+        if ((p = iov_block(&out)) != NULL)
+        {
+            memcpy(p, block, CRYPTO_IN_SIZE);
+        }
+        else
+        {
+            iov_copy(&out, block, true);
+        }
+    }
+}
+
+void present_encrypt_blocks(const present_expanded_key_t *expanded, const uint8_t *in, uint8_t *out, size_t n)
+{
+    size_t batches = n / BITSLICE_WIDTH;
+    size_t tail = n % BITSLICE_WIDTH;
+    uint8_t *pt = out + batches * CRYPTO_IN_SIZE * BITSLICE_WIDTH;
+
+    if (out != in)
+    {
+        size_t done = 0;
+
+#ifdef OPTIMIZATION_MULTICORE
+        // Whole batches per core like present_encrypt_batches, each one read from in and written to out.
+        if (batches > 1)
+        {
+            crypt_batches(in, out, batches, expanded, 0);
+            done = batches * CRYPTO_IN_SIZE * BITSLICE_WIDTH;
+        }
+#endif
+
+        // The rest is read from in and written to out by the transposition as well, without a copy.
+        present_iovec_t src = {(void *)(in + done), n * CRYPTO_IN_SIZE - done};
+        present_iovec_t dst = {out + done, n * CRYPTO_IN_SIZE - done};
+
+        present_encrypt_iov(expanded, &src, 1, &dst, 1);
+        return;
+    }
+
+    present_encrypt_batches(expanded, out, batches);
+
+    if (tail == 0)
+    {
+        return;
+    }
+
+    if (!expanded->lane_keys && tail < present_tail_blocks(expanded))
+    {
+        for (size_t i = 0; i < tail; i++)
+        {
+            present_encrypt_block(expanded, pt + i * CRYPTO_IN_SIZE);
+        }
+    }
+    else
+    {
+        present_encrypt_tail(expanded, pt, tail);
+    }
+}
+
+void present_encrypt_start(const present_expanded_key_t *expanded, uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH])
+{
+#ifdef OPTIMIZATION_MULTICORE
+    present_encrypt_finish();
+    present_worker_start();
+
+    alone_job = (crypt_job_t){pt, alone_state_bs, expanded, CRYPT_ALONE, NULL};
+    alone_pending = true;
+
+    platform_fifo_push_blocking((uintptr_t)&alone_job);
+#else
+    present_encrypt_expanded(expanded, pt);
+#endif
+}
+
+void present_encrypt_finish(void)
+{
+#ifdef OPTIMIZATION_MULTICORE
+    if (alone_pending)
+    {
+        platform_fifo_pop_blocking();
+        alone_pending = false;
+    }
+#endif
+}
+
+void present_decrypt_batches(const present_expanded_key_t *expanded, uint8_t *ct, size_t batches)
+{
+#ifdef OPTIMIZATION_MULTICORE
+    if (batches > 1)
+    {
+        crypt_batches(ct, ct, batches, expanded, CRYPT_DECRYPT);
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < batches; i++)
+    {
+        present_decrypt_expanded(expanded, ct + i * CRYPTO_IN_SIZE * BITSLICE_WIDTH);
+    }
+}
+
+void crypto_func_lane_keys(uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], const uint8_t keys[CRYPTO_KEY_SIZE * BITSLICE_WIDTH])
+{
+    // Too large for the stack of core0 on the pico.
+    static present_expanded_key_t expanded;
+
+    present_expand_lane_keys(&expanded, keys);
+    present_encrypt_expanded(&expanded, pt);
+}
+
+void crypto_func_lane_keys_128(uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], const uint8_t keys[CRYPTO_KEY_SIZE_128 * BITSLICE_WIDTH])
+{
+    // Too large for the stack of core0 on the pico.
+    static present_expanded_key_t expanded;
+
+    present_expand_lane_keys_128(&expanded, keys);
+    present_encrypt_expanded(&expanded, pt);
+}
+
+void crypto_func_decrypt(uint8_t ct[CRYPTO_IN_SIZE * BITSLICE_WIDTH], uint8_t key[CRYPTO_KEY_SIZE])
+{
+    // Too large for the stack of core0 on the pico.
+    static present_expanded_key_t expanded;
+
+    present_expand_decryption_key(&expanded, key);
+    present_decrypt_expanded(&expanded, ct);
+}
+
+void crypto_func_decrypt_128(uint8_t ct[CRYPTO_IN_SIZE * BITSLICE_WIDTH], uint8_t key[CRYPTO_KEY_SIZE_128])
+{
+    // Too large for the stack of core0 on the pico.
+    static present_expanded_key_t expanded;
+
+    present_expand_decryption_key_128(&expanded, key);
+    present_decrypt_expanded(&expanded, ct);
+}
+
+/**
+ * @brief Slices of the lane index, slice k has bit k of the index of each lane.
+ *
+ * @param lane_bs Output: BITSLICE_LOG2 slices
+ */
+static void lane_slices(bs_reg_t lane_bs[BITSLICE_LOG2])
+{
+    // Lane j is bit j % 8 of byte j / 8 of a register, see enslice.
+    for (uint8_t k = 0; k < BITSLICE_LOG2; k++)
+    {
+        uint8_t lanes[sizeof(bs_reg_t)] = {0u};
+
+        for (uint16_t j = 0; j < BITSLICE_WIDTH; j++)
+        {
+            lanes[j / 8] |= ((j >> k) & 0x01) << (j % 8);
+        }
+
+        memcpy(&lane_bs[k], lanes, sizeof(bs_reg_t));
+    }
+}
+
+/**
+ * @brief Bring the counter blocks of the next batch into bitsliced form without enslice.
+ *
+ * Lane j gets counter + j. Bit k of counter is the same in all lanes, so its slice is all ones or all zeros, and
+ * bit k of j is the fixed pattern lane_bs[k]. Both are added with a bitsliced ripple carry adder, which also handles
+ * a counter that is not a multiple of BITSLICE_WIDTH and the wrap around at 2^64. That is about 6 operations per slice
+ * instead of a transposition of all tiles.
+ *
+ * @param ctx context
+ * @param state_bs Output: bitsliced counter blocks in phase 0
+ */
+static void ctr_enslice(const present_ctr_t *ctx, bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT])
+{
+    bs_reg_t carry = BS_ZERO;
+
+    for (uint8_t k = 0; k < CRYPTO_IN_SIZE_BIT; k++)
+    {
+        bs_reg_t a = (ctx->counter >> k) & 0x01 ? BS_ONES : BS_ZERO;
+
+        if (k < BITSLICE_LOG2)
+        {
+            bs_reg_t b = ctx->lane_bs[k];
+
+            state_bs[k] = a ^ b ^ carry;
+            carry = (a & b) | (carry & (a ^ b));
+        }
+        else
+        {
+            state_bs[k] = a ^ carry;
+            carry = a & carry;
+        }
+    }
+}
+
+/**
+ * @brief Encrypt the next batch of counter blocks into the keystream buffer.
+ *
+ * @param ctx context
+ */
+static void ctr_next_batch(present_ctr_t *ctx)
+{
+    // State buffer.
+    bs_reg_t state[CRYPTO_IN_SIZE_BIT];
+
+    ctr_enslice(ctx, state);
+
+#ifdef OPTIMIZATION_MULTICORE
+    crypt(ctx->keystream, state, &ctx->expanded, CRYPT_SLICED_INPUT);
+#else
+    encrypt_rounds(state, &ctx->expanded);
+
+    unslice(state, ctx->keystream, FIX_PHASE(CRYPTO_ROUNDS));
+#endif
+
+    ctx->counter += BITSLICE_WIDTH;
+    ctx->keystream_used = 0;
+}
+
+/**
+ * @brief Set the counter of a context with the expanded key to the IV, see present_ctr_init.
+ *
+ * @param ctx context with the expanded key
+ * @param iv first counter block
+ */
+static void ctr_start(present_ctr_t *ctx, const uint8_t iv[CRYPTO_IN_SIZE])
+{
+    ctx->counter = 0;
+    for (uint8_t i = 0; i < CRYPTO_IN_SIZE; i++)
+    {
+        ctx->counter |= (uint64_t)iv[i] << (8 * i);
+    }
+
+    lane_slices(ctx->lane_bs);
+
+    // No keystream yet.
+    ctx->keystream_used = sizeof(ctx->keystream);
+}
+
+void present_ctr_init(present_ctr_t *ctx, const uint8_t key[CRYPTO_KEY_SIZE], const uint8_t iv[CRYPTO_IN_SIZE])
+{
+    present_expand_key(&ctx->expanded, key);
+    ctr_start(ctx, iv);
+}
+
+void present_ctr_init_128(present_ctr_t *ctx, const uint8_t key[CRYPTO_KEY_SIZE_128], const uint8_t iv[CRYPTO_IN_SIZE])
+{
+    present_expand_key_128(&ctx->expanded, key);
+    ctr_start(ctx, iv);
+}
+
+void present_ctr_update(present_ctr_t *ctx, uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        if (ctx->keystream_used == sizeof(ctx->keystream))
+        {
+            ctr_next_batch(ctx);
+        }
+
+        size_t n = sizeof(ctx->keystream) - ctx->keystream_used;
+        const uint8_t *keystream = ctx->keystream + ctx->keystream_used;
+
+        if (n > len)
+        {
+            n = len;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            buf[i] ^= keystream[i];
+        }
+
+        ctx->keystream_used += n;
+        buf += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief Multiply a block by x in GF(2^64), for the CMAC subkeys.
+ *
+ * @param x block as little-endian integer
+ *
+ * @return x doubled, reduced by x^64 + x^4 + x^3 + x + 1
+ */
+static uint64_t cmac_double(uint64_t x)
+{
+    return (x << 1) ^ ((x >> 63) ? 0x1B : 0);
+}
+
+/**
+ * @brief Derive the CMAC subkeys from the expanded key of the context.
+ *
+ * @param ctx context with the expanded key, Output: k1 and k2
+ */
+static void cmac_subkeys(present_cmac_t *ctx)
+{
+    uint8_t zero[CRYPTO_IN_SIZE * BITSLICE_WIDTH] = {0u};
+    uint64_t l = 0;
+
+    present_encrypt_expanded(&ctx->expanded, zero);
+
+    for (uint8_t i = 0; i < CRYPTO_IN_SIZE; i++)
+    {
+        l |= (uint64_t)zero[i] << (8 * i);
+    }
+
+    ctx->k1 = cmac_double(l);
+    ctx->k2 = cmac_double(ctx->k1);
+}
+
+void present_cmac_init(present_cmac_t *ctx, const uint8_t key[CRYPTO_KEY_SIZE])
+{
+    present_expand_key(&ctx->expanded, key);
+    cmac_subkeys(ctx);
+}
+
+void present_cmac_init_128(present_cmac_t *ctx, const uint8_t key[CRYPTO_KEY_SIZE_128])
+{
+    present_expand_key_128(&ctx->expanded, key);
+    cmac_subkeys(ctx);
+}
+
+/**
+ * @brief Block j of a message as it goes into CBC-MAC, with padding and subkey if it is the last one.
+ *
+ * @param ctx context
+ * @param msg message
+ * @param len length of message in bytes
+ * @param j block index, below the number of blocks of the message
+ * @param block Output: block
+ */
+static void cmac_block(const present_cmac_t *ctx, const uint8_t *msg, size_t len, size_t j, uint8_t block[CRYPTO_IN_SIZE])
+{
+    size_t offset = j * CRYPTO_IN_SIZE;
+    size_t n = len - offset < CRYPTO_IN_SIZE ? len - offset : CRYPTO_IN_SIZE;
+    uint64_t subkey;
+
+    if (n > 0)
+    {
+        memcpy(block, msg + offset, n);
+    }
+
+    if (offset + CRYPTO_IN_SIZE < len)
+    {
+        return;
+    }
+
+    // Last block: complete ones get k1, others are padded with 10* and get k2.
+    if (n == CRYPTO_IN_SIZE && len > 0)
+    {
+        subkey = ctx->k1;
+    }
+    else
+    {
+        memset(block + n, 0u, CRYPTO_IN_SIZE - n);
+        block[n] = 0x80;
+        subkey = ctx->k2;
+    }
+
+    for (uint8_t i = 0; i < CRYPTO_IN_SIZE; i++)
+    {
+        block[i] ^= (uint8_t)(subkey >> (8 * i));
+    }
+}
+
+/**
+ * @brief CMAC of up to BITSLICE_WIDTH messages, message i in lane i.
+ *
+ * The chaining values stay in bitsliced form from one block to the next: only the message blocks go through enslice,
+ * and the output of a pass, in the slice order of FIX_PHASE(CRYPTO_ROUNDS), is XORed into the next input in phase 0.
+ * A lane whose message is done keeps encrypting garbage until the longest message is done, so its tag is taken into
+ * tag_bs under a mask in the pass of its last block.
+ *
+ * @param ctx context
+ * @param msgs messages
+ * @param lens lengths of messages in bytes
+ * @param count number of messages, at most BITSLICE_WIDTH
+ * @param tags Output: count tags of CRYPTO_OUT_SIZE bytes
+ */
+static void cmac_lanes(const present_cmac_t *ctx, const uint8_t *const *msgs, const size_t *lens, uint16_t count, uint8_t *tags)
+{
+    // Chaining values of the last pass and input of this pass, swapped after each pass.
+    bs_reg_t state_bs[2][CRYPTO_IN_SIZE_BIT];
+    bs_reg_t tag_bs[CRYPTO_IN_SIZE_BIT];
+    uint8_t blocks[CRYPTO_IN_SIZE * BITSLICE_WIDTH] = {0u};
+    size_t max_blocks = 0;
+    uint8_t last = 0;
+
+    // CBC-MAC starts from the all-zero chaining value.
+    memset(state_bs[0], 0u, sizeof(state_bs[0]));
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        // The empty message is one padded block.
+        size_t n = lens[i] == 0 ? 1 : (lens[i] + CRYPTO_IN_SIZE - 1) / CRYPTO_IN_SIZE;
+
+        max_blocks = n > max_blocks ? n : max_blocks;
+    }
+
+    for (size_t j = 0; j < max_blocks; j++)
+    {
+        bs_reg_t *x_bs = state_bs[last];
+        bs_reg_t *y_bs = state_bs[last ^ 1];
+        // Lanes whose last block is j
+        uint8_t done[sizeof(bs_reg_t)] = {0u};
+        bs_reg_t done_bs;
+
+        for (uint16_t i = 0; i < count; i++)
+        {
+            size_t n = lens[i] == 0 ? 1 : (lens[i] + CRYPTO_IN_SIZE - 1) / CRYPTO_IN_SIZE;
+
+            if (j < n)
+            {
+                cmac_block(ctx, msgs[i], lens[i], j, blocks + i * CRYPTO_IN_SIZE);
+            }
+
+            if (j == n - 1)
+            {
+                done[i / 8] |= 1u << (i % 8);
+            }
+        }
+
+        memcpy(&done_bs, done, sizeof(bs_reg_t));
+
+#ifdef OPTIMIZATION_MULTICORE
+        enslice(blocks, y_bs, 0, CORE_ALL);
+#else
+        enslice(blocks, y_bs, 0);
+#endif
+
+        for (uint8_t b = 0; b < CRYPTO_IN_SIZE_BIT; b++)
+        {
+            y_bs[b] ^= x_bs[fix_index(b, FIX_PHASE(CRYPTO_ROUNDS))];
+        }
+
+#ifdef OPTIMIZATION_MULTICORE
+        crypt(NULL, y_bs, &ctx->expanded, CRYPT_SLICED_INPUT | CRYPT_SLICED_OUTPUT);
+#else
+        encrypt_rounds(y_bs, &ctx->expanded);
+#endif
+
+        for (uint8_t b = 0; b < CRYPTO_IN_SIZE_BIT; b++)
+        {
+            bs_reg_t t = y_bs[fix_index(b, FIX_PHASE(CRYPTO_ROUNDS))];
+
+            tag_bs[b] = j == 0 ? t & done_bs : (tag_bs[b] & ~done_bs) | (t & done_bs);
+        }
+
+        last ^= 1;
+    }
+
+#ifdef OPTIMIZATION_MULTICORE
+    unslice(tag_bs, blocks, 0, CORE_ALL);
+#else
+    unslice(tag_bs, blocks, 0);
+#endif
+
+    memcpy(tags, blocks, count * CRYPTO_OUT_SIZE);
+}
+
+void present_cmac(const present_cmac_t *ctx, const uint8_t *const *msgs, const size_t *lens, size_t count, uint8_t *tags)
+{
+    for (size_t i = 0; i < count; i += BITSLICE_WIDTH)
+    {
+        uint16_t n = count - i < BITSLICE_WIDTH ? count - i : BITSLICE_WIDTH;
+
+        cmac_lanes(ctx, msgs + i, lens + i, n, tags + i * CRYPTO_OUT_SIZE);
+    }
+}
+
+/**
+ * @brief Start a key search, see present_keysearch_init.
+ *
+ * @param ctx Output: context
+ * @param key known key bits
+ * @param mask 1 for each unknown key bit
+ * @param pt known plaintext
+ * @param ct its ciphertext
+ * @param rounds number of rounds
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ *
+ * @return false if there are too many unknown bits or rounds is out of range
+ */
+static bool keysearch_init(present_keysearch_t *ctx, const uint8_t *key, const uint8_t *mask, const uint8_t pt[CRYPTO_IN_SIZE],
+                           const uint8_t ct[CRYPTO_OUT_SIZE], uint8_t rounds, uint8_t key_size)
+{
+    if (rounds == 0 || rounds > CRYPTO_ROUNDS)
+    {
+        return false;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->key_size = key_size;
+    ctx->rounds = rounds;
+
+    for (uint8_t k = 0; k < key_size * 8; k++)
+    {
+        if (GETBIT(mask[k / 8], k % 8))
+        {
+            ctx->unknown[ctx->unknown_count++] = k;
+        }
+        else
+        {
+            ctx->key[k / 8] |= GETBIT(key[k / 8], k % 8) << (k % 8);
+        }
+    }
+
+    // The number of batches has to fit into 64 bits.
+    if (ctx->unknown_count > 63 + BITSLICE_LOG2)
+    {
+        return false;
+    }
+
+    memcpy(&ctx->pt, pt, CRYPTO_IN_SIZE);
+    memcpy(&ctx->ct, ct, CRYPTO_OUT_SIZE);
+
+    lane_slices(ctx->lane_bs);
+    ctx->lane_unused = BS_ZERO;
+    ctx->batches = 1;
+
+    if (ctx->unknown_count < BITSLICE_LOG2)
+    {
+        // Lanes from 2^unknown_count on have a bit of the lane index set that is no key bit.
+        for (uint8_t k = ctx->unknown_count; k < BITSLICE_LOG2; k++)
+        {
+            ctx->lane_unused |= ctx->lane_bs[k];
+        }
+    }
+    else
+    {
+        ctx->batches <<= ctx->unknown_count - BITSLICE_LOG2;
+    }
+
+    return true;
+}
+
+bool present_keysearch_init(present_keysearch_t *ctx, const uint8_t key[CRYPTO_KEY_SIZE], const uint8_t mask[CRYPTO_KEY_SIZE],
+                            const uint8_t pt[CRYPTO_IN_SIZE], const uint8_t ct[CRYPTO_OUT_SIZE], uint8_t rounds)
+{
+    return keysearch_init(ctx, key, mask, pt, ct, rounds, CRYPTO_KEY_SIZE);
+}
+
+bool present_keysearch_init_128(present_keysearch_t *ctx, const uint8_t key[CRYPTO_KEY_SIZE_128], const uint8_t mask[CRYPTO_KEY_SIZE_128],
+                                const uint8_t pt[CRYPTO_IN_SIZE], const uint8_t ct[CRYPTO_OUT_SIZE], uint8_t rounds)
+{
+    return keysearch_init(ctx, key, mask, pt, ct, rounds, CRYPTO_KEY_SIZE_128);
+}
+
+/**
+ * @brief Whether all lanes of a register are 1.
+ *
+ * @param x register
+ *
+ * @return true if no lane is 0
+ */
+static inline bool bs_all_ones(bs_reg_t x)
+{
+    bs_word_t words[BITSLICE_WORDS];
+    bs_word_t all = ~(bs_word_t)0;
+
+    memcpy(words, &x, sizeof(bs_reg_t));
+
+    for (uint8_t g = 0; g < BITSLICE_WORDS; g++)
+    {
+        all &= words[g];
+    }
+
+    return all == ~(bs_word_t)0;
+}
+
+/**
+ * @brief Record a key that gives the ciphertext.
+ *
+ * Both cores may find one, so the list is only changed under platform_lock.
+ *
+ * @param ctx context
+ * @param batch batch of the key
+ * @param lane lane of the key in its batch
+ */
+static void keysearch_found(present_keysearch_t *ctx, uint64_t batch, uint16_t lane)
+{
+    uint8_t key[CRYPTO_KEY_SIZE_128];
+
+    memcpy(key, ctx->key, ctx->key_size);
+
+    for (uint8_t u = 0; u < ctx->unknown_count; u++)
+    {
+        uint8_t bit = u < BITSLICE_LOG2 ? (lane >> u) & 0x01 : (batch >> (u - BITSLICE_LOG2)) & 0x01;
+
+        key[ctx->unknown[u] / 8] |= bit << (ctx->unknown[u] % 8);
+    }
+
+    uint32_t saved = platform_lock();
+
+    if (ctx->found_count < PRESENT_KEYSEARCH_FOUND)
+    {
+        memcpy(ctx->found[ctx->found_count], key, ctx->key_size);
+    }
+
+    ctx->found_count++;
+
+    platform_unlock(saved);
+}
+
+/**
+ * @brief Test the BITSLICE_WIDTH candidates of one batch.
+ *
+ * The key schedule runs on the slices of the key registers next to the rounds, like expand_lane_keys but without
+ * storing the round keys. Round key 0 with the plaintext folded in is the initial state, so there is no enslice.
+ * The last round is done one S-box at a time, each followed by the comparison of its 4 output bits with the
+ * ciphertext, and the batch is given up as soon as no lane is left. There is no unslice either: only the lanes that
+ * are still left at the end are turned into keys.
+ *
+ * @param ctx context
+ * @param batch index of the batch, the values of the unknown bits above the lane index
+ */
+static void keysearch_batch(present_keysearch_t *ctx, uint64_t batch)
+{
+    bs_reg_t key_bs[CRYPTO_KEY_SIZE_128_BIT];
+    bs_reg_t state_bs[CRYPTO_IN_SIZE_BIT];
+    uint8_t key_bits = ctx->key_size * 8;
+    uint8_t last = ctx->rounds - 1;
+    uint8_t offset = 0;
+    // Lanes that differ from the ciphertext in some bit so far
+    bs_reg_t miss = ctx->lane_unused;
+
+    for (uint8_t k = 0; k < key_bits; k++)
+    {
+        key_bs[k] = GETBIT(ctx->key[k / 8], k % 8) ? BS_ONES : BS_ZERO;
+    }
+
+    for (uint8_t u = 0; u < ctx->unknown_count; u++)
+    {
+        if (u < BITSLICE_LOG2)
+        {
+            key_bs[ctx->unknown[u]] = ctx->lane_bs[u];
+        }
+        else
+        {
+            key_bs[ctx->unknown[u]] = (batch >> (u - BITSLICE_LOG2)) & 0x01 ? BS_ONES : BS_ZERO;
+        }
+    }
+
+    // Round key 0 in phase 0, inverted where the plaintext has a 1.
+    for (uint8_t i = 0; i < CRYPTO_IN_SIZE_BIT; i++)
+    {
+        state_bs[i] = key_bs[key_bits - CRYPTO_IN_SIZE_BIT + i];
+
+        if ((ctx->pt >> i) & 0x01)
+        {
+            state_bs[i] = ~state_bs[i];
+        }
+    }
+
+    for (uint8_t r = 0; r <= last; r++)
+    {
+        if (r > 0)
+        {
+            for (uint8_t i = 0; i < CRYPTO_IN_SIZE_BIT; i++)
+            {
+                state_bs[fix_index(i, FIX_PHASE(r))] ^= key_bs[key_index(key_bits - CRYPTO_IN_SIZE_BIT + i, offset, key_bits)];
+            }
+        }
+
+        if (r < last)
+        {
+#ifdef OPTIMIZATION_MULTICORE
+            sbox_layer(state_bs, FIX_PHASE(r), CORE_ALL);
+#else
+            sbox_layer(state_bs, FIX_PHASE(r));
+#endif
+        }
+
+        update_round_key_bs(key_bs, &offset, r + 1, ctx->key_size);
+    }
+
+    // Last S-box layer. Output bit j of S-box s is bit PBOX(4 * s + j) of the ciphertext after the permutation.
+    for (uint8_t s = 0; s < 16; s++)
+    {
+        bs_reg_t x[4];
+
+        for (uint8_t j = 0; j < 4; j++)
+        {
+            x[j] = state_bs[fix_index(s * 4 + j, FIX_PHASE(last))];
+        }
+
+        sbox_slices(&x[0], &x[1], &x[2], &x[3]);
+
+        for (uint8_t j = 0; j < 4; j++)
+        {
+            uint8_t i = s * 4 + j;
+            uint8_t b = PBOX(i);
+
+            bs_reg_t diff = x[j] ^ key_bs[key_index(key_bits - CRYPTO_IN_SIZE_BIT + b, offset, key_bits)];
+
+            if ((ctx->ct >> b) & 0x01)
+            {
+                diff = ~diff;
+            }
+
+            miss |= diff;
+        }
+
+        if (bs_all_ones(miss))
+        {
+            return;
+        }
+    }
+
+    // Lane j is bit j % 8 of byte j / 8 of a register, see enslice.
+    uint8_t lanes[sizeof(bs_reg_t)];
+
+    memcpy(lanes, &miss, sizeof(bs_reg_t));
+
+    for (uint16_t j = 0; j < BITSLICE_WIDTH; j++)
+    {
+        if (!GETBIT(lanes[j / 8], j % 8))
+        {
+            keysearch_found(ctx, batch, j);
+        }
+    }
+}
+
+bool present_keysearch_run(present_keysearch_t *ctx, size_t batches)
+{
+    uint64_t begin = platform_time_us();
+    size_t i = 0;
+
+    if (batches > ctx->batches - ctx->next_batch)
+    {
+        batches = (size_t)(ctx->batches - ctx->next_batch);
+    }
+
+#ifdef OPTIMIZATION_MULTICORE
+    // Each core takes whole batches from its end of the range, like crypt_batches.
+    if (batches > 1)
+    {
+        batch_queue_t queue = {NULL, NULL, NULL, 0, 0, batches, ctx, NULL, NULL};
+        crypt_job_t job = {NULL, NULL, NULL, 0, &queue};
+
+        dispatch(&job);
+        i = batches;
+    }
+#endif
+
+    for (; i < batches; i++)
+    {
+        keysearch_batch(ctx, ctx->next_batch + i);
+    }
+
+    ctx->next_batch += batches;
+    ctx->keys_tested += (uint64_t)batches * (ctx->unknown_count < BITSLICE_LOG2 ? 1u << ctx->unknown_count : BITSLICE_WIDTH);
+    ctx->time_us += platform_time_us() - begin;
+
+    return ctx->next_batch < ctx->batches;
+}
+
+double present_keysearch_keys_per_second(const present_keysearch_t *ctx)
+{
+    return ctx->time_us > 0 ? (double)ctx->keys_tested * 1000000.0 / (double)ctx->time_us : 0.0;
+}
@@ -1,24 +1,575 @@
-#ifndef __CRYPTO_H
-#define __CRYPTO_H
-
-#include <stdint.h>
-#include <string.h>
-
-// Define basic parameters
-#define CRYPTO_IN_SIZE  8 	// Present has 64-bit blocks
-#define CRYPTO_KEY_SIZE 10  // Present has 80-bit key
-#define CRYPTO_OUT_SIZE 8   // Present has 64-bit blocks
-
-// Block size in bit
-#define CRYPTO_IN_SIZE_BIT (CRYPTO_IN_SIZE * 8)
-
-// Do 16-bit bitslicing
-#define BITSLICE_WIDTH 32
-
-// Bitslicing register typedef
-typedef uint32_t bs_reg_t;
-
-// The function to test
-void crypto_func(uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], uint8_t key[CRYPTO_KEY_SIZE]);
-
+#ifndef __CRYPTO_H
+#define __CRYPTO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Define basic parameters
+#define CRYPTO_IN_SIZE  8 	// Present has 64-bit blocks
+#define CRYPTO_KEY_SIZE 10  // Present has 80-bit key
+#define CRYPTO_KEY_SIZE_128 16  // or a 128-bit key with PRESENT-128
+#define CRYPTO_OUT_SIZE 8   // Present has 64-bit blocks
+
+// Block size in bit
+#define CRYPTO_IN_SIZE_BIT (CRYPTO_IN_SIZE * 8)
+
+// Key size in bit
+#define CRYPTO_KEY_SIZE_BIT (CRYPTO_KEY_SIZE * 8)
+#define CRYPTO_KEY_SIZE_128_BIT (CRYPTO_KEY_SIZE_128 * 8)
+
+/**
+ * Number of blocks per batch, which is the number of bits of a bitslicing register.
+ *
+ * 32   uint32_t (default, the only one available on the pico)
+ * 64   uint64_t
+ * 128  SSE2 __m128i
+ * 256  AVX2 __m256i
+ * 512  AVX-512 __m512i
+ *
+ * The SIMD registers rely on the vector extension of GCC and Clang for the &, |, ^ and ~ operators.
+ */
+#ifndef BITSLICE_WIDTH
+#define BITSLICE_WIDTH 32
+#endif
+
+// Bitslicing register typedef with all zeros and all ones constants
+// BITSLICE_LOG2 is log2(BITSLICE_WIDTH), the number of bits of a lane index.
+#if BITSLICE_WIDTH == 32
+typedef uint32_t bs_reg_t;
+#define BS_ZERO 0u
+#define BS_ONES 0xFFFFFFFFu
+#define BITSLICE_LOG2 5
+#elif BITSLICE_WIDTH == 64
+typedef uint64_t bs_reg_t;
+#define BS_ZERO 0u
+#define BS_ONES UINT64_MAX
+#define BITSLICE_LOG2 6
+#elif BITSLICE_WIDTH == 128
+#include <emmintrin.h>
+typedef __m128i bs_reg_t;
+#define BS_ZERO _mm_setzero_si128()
+#define BS_ONES _mm_set1_epi32(-1)
+#define BITSLICE_LOG2 7
+#elif BITSLICE_WIDTH == 256
+#include <immintrin.h>
+typedef __m256i bs_reg_t;
+#define BS_ZERO _mm256_setzero_si256()
+#define BS_ONES _mm256_set1_epi32(-1)
+#define BITSLICE_LOG2 8
+#elif BITSLICE_WIDTH == 512
+#include <immintrin.h>
+typedef __m512i bs_reg_t;
+#define BS_ZERO _mm512_setzero_si512()
+#define BS_ONES _mm512_set1_epi32(-1)
+#define BITSLICE_LOG2 9
+#else
+#error "BITSLICE_WIDTH must be 32, 64, 128, 256 or 512"
+#endif
+
+/**
+ * Moving data in and out of bitsliced form transposes square tiles of BS_WORD_BITS x BS_WORD_BITS bits.
+ * The tiles are as wide as the native word, 32 bits for a 32-bit register and 64 bits for anything wider.
+ *
+ * A register consists of BITSLICE_WORDS words and a block of BITSLICE_TILES words, so there are BITSLICE_UNITS tiles.
+ */
+#if BITSLICE_WIDTH == 32
+typedef uint32_t bs_word_t;
+#define BS_WORD_BITS 32
+#else
+typedef uint64_t bs_word_t;
+#define BS_WORD_BITS 64
+#endif
+
+#define BITSLICE_WORDS (BITSLICE_WIDTH / BS_WORD_BITS)
+#define BITSLICE_TILES (CRYPTO_IN_SIZE_BIT / BS_WORD_BITS)
+#define BITSLICE_UNITS (BITSLICE_WORDS * BITSLICE_TILES)
+
+// Present has 31 rounds and 32 round keys
+#define CRYPTO_ROUNDS 31
+
+/**
+ * @brief Expanded key.
+ *
+ * All 32 round keys in bitsliced form. Each bit of a round key is stored as a whole register of ones or zeros,
+ * so add_round_key is a plain XOR.
+ */
+typedef struct
+{
+    bs_reg_t round_key_bs[CRYPTO_ROUNDS + 1][CRYPTO_IN_SIZE_BIT];
+    // The same round keys as words, for blocks encrypted one at a time by present_encrypt_block.
+    uint64_t round_key[CRYPTO_ROUNDS + 1];
+    // 1 after present_expand_lane_keys, where round_key is not set because each lane has a key of its own.
+    uint8_t lane_keys;
+} present_expanded_key_t;
+
+/**
+ * @brief Run the key schedule once for all rounds.
+ *
+ * @param expanded Output: expanded key
+ * @param key Input: 80-bit key, left unchanged
+ */
+void present_expand_key(present_expanded_key_t *expanded, const uint8_t key[CRYPTO_KEY_SIZE]);
+
+/**
+ * @brief present_expand_key with the 128-bit key schedule of PRESENT-128.
+ *
+ * The expanded key has the same form, so everything that takes an expanded key works with both key sizes.
+ *
+ * @param expanded Output: expanded key
+ * @param key Input: 128-bit key, left unchanged
+ */
+void present_expand_key_128(present_expanded_key_t *expanded, const uint8_t key[CRYPTO_KEY_SIZE_128]);
+
+/**
+ * @brief Encrypt many batches of BITSLICE_WIDTH blocks in place under an expanded key.
+ *
+ * If OPTIMIZATION_MULTICORE, each core encrypts whole batches on its own instead of sharing every round of one batch.
+ * A single batch is still shared, that gives the lowest latency.
+ *
+ * @param expanded expanded key
+ * @param pt batches * BITSLICE_WIDTH blocks
+ * @param batches number of batches
+ */
+void present_encrypt_batches(const present_expanded_key_t *expanded, uint8_t *pt, size_t batches);
+
+/**
+ * @brief Decrypt many batches of BITSLICE_WIDTH blocks in place under an expanded key, like present_encrypt_batches.
+ *
+ * @param expanded expanded key
+ * @param ct batches * BITSLICE_WIDTH blocks
+ * @param batches number of batches
+ */
+void present_decrypt_batches(const present_expanded_key_t *expanded, uint8_t *ct, size_t batches);
+
+/**
+ * @brief Run the key schedule for a different key in each lane.
+ *
+ * The key registers of all lanes are bitsliced and the key schedule runs on the slices, so it costs the same
+ * for BITSLICE_WIDTH keys as for one. The result works with present_encrypt_expanded and present_decrypt_expanded
+ * like any expanded key, block j is encrypted under key j.
+ *
+ * @param expanded Output: expanded key
+ * @param keys BITSLICE_WIDTH keys, the key of block j at keys + j * CRYPTO_KEY_SIZE
+ */
+void present_expand_lane_keys(present_expanded_key_t *expanded, const uint8_t keys[CRYPTO_KEY_SIZE * BITSLICE_WIDTH]);
+
+/**
+ * @brief present_expand_lane_keys for PRESENT-128.
+ *
+ * @param expanded Output: expanded key
+ * @param keys BITSLICE_WIDTH keys, the key of block j at keys + j * CRYPTO_KEY_SIZE_128
+ */
+void present_expand_lane_keys_128(present_expanded_key_t *expanded, const uint8_t keys[CRYPTO_KEY_SIZE_128 * BITSLICE_WIDTH]);
+
+/**
+ * @brief Encrypt BITSLICE_WIDTH blocks in place under an expanded key.
+ *
+ * @param expanded expanded key
+ * @param pt BITSLICE_WIDTH blocks
+ */
+void present_encrypt_expanded(const present_expanded_key_t *expanded, uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH]);
+
+/**
+ * @brief Shortest tail that present_encrypt_blocks and present_encrypt_iov encrypt as a batch.
+ *
+ * A batch costs the same for 1 block as for BITSLICE_WIDTH, so the crossover is where one batch gets cheaper than
+ * that many single blocks. It depends on the core and the compiler, so the first call times present_encrypt_block
+ * against present_encrypt_tail on the running core, the fastest of a few runs each, and later calls return the same
+ * value. That takes a few batches, so call it once at startup to keep it out of the first tail. Both paths are
+ * constant-time, so the timing says nothing about the key. Define PRESENT_BS_TAIL_BLOCKS to fix the crossover at
+ * build time instead, like -DPRESENT_BS_TAIL_BLOCKS=12.
+ *
+ * @param expanded expanded key to time with, not lane keys
+ *
+ * @return number of blocks, BITSLICE_WIDTH if a batch is never cheaper, or PRESENT_BS_TAIL_BLOCKS if defined
+ */
+size_t present_tail_blocks(const present_expanded_key_t *expanded);
+
+/**
+ * @brief Encrypt any number of blocks under an expanded key.
+ *
+ * In place, whole batches go through present_encrypt_batches. The tail of n % BITSLICE_WIDTH blocks goes through
+ * present_encrypt_block if it is shorter than present_tail_blocks and through present_encrypt_tail otherwise.
+ * With the lane keys of present_expand_lane_keys, the tail is always a batch, and block i of each batch is encrypted
+ * under key i. Out of place, the same is done with in read and out written by the transposition, so in is never
+ * copied to out first. Both ways to encrypt the tail are constant-time, so the time only depends on n.
+ *
+ * @param expanded expanded key
+ * @param in n blocks
+ * @param out Output: n blocks, the same as in or not overlapping it
+ * @param n number of blocks, any number
+ */
+void present_encrypt_blocks(const present_expanded_key_t *expanded, const uint8_t *in, uint8_t *out, size_t n);
+
+/**
+ * @brief Fragment of a buffer, like struct iovec of POSIX.
+ */
+typedef struct
+{
+    void *base;
+    size_t len;
+} present_iovec_t;
+
+/**
+ * @brief Encrypt blocks from a list of fragments into another one, such as network buffers.
+ *
+ * The transposition reads the rows of each batch from the source fragments and writes them into the destination
+ * fragments directly, without staging the batch in a buffer. Fragments can have any length and a block can be split
+ * between fragments. Batches and tails are handled like present_encrypt_blocks. The shorter of both lists gives the
+ * number of blocks, rounded down to whole blocks.
+ *
+ * @param expanded expanded key
+ * @param src source fragments, the blocks are their bytes in order
+ * @param src_count number of source fragments
+ * @param dst Output: destination fragments, the same as src or not overlapping them
+ * @param dst_count number of destination fragments
+ */
+void present_encrypt_iov(const present_expanded_key_t *expanded, const present_iovec_t *src, size_t src_count,
+                         const present_iovec_t *dst, size_t dst_count);
+
+/**
+ * @brief Encrypt one block in place without bitslicing.
+ *
+ * The rounds are those of OPTIMIZATION_NIBBLE_SLICE of Present_ref, without tables, so like the batches it takes the
+ * same time for every block. Not for the lane keys of present_expand_lane_keys.
+ *
+ * @param expanded expanded key
+ * @param pt block
+ */
+void present_encrypt_block(const present_expanded_key_t *expanded, uint8_t pt[CRYPTO_IN_SIZE]);
+
+/**
+ * @brief present_encrypt_block with only the first rounds, for cryptanalysis of reduced-round PRESENT.
+ *
+ * Round r adds round key r and applies the S-box and permutation layers, and round key rounds is added at the end.
+ * With CRYPTO_ROUNDS rounds this is present_encrypt_block.
+ *
+ * @param expanded expanded key, not lane keys
+ * @param pt block
+ * @param rounds number of rounds, 1 to CRYPTO_ROUNDS
+ */
+void present_encrypt_block_rounds(const present_expanded_key_t *expanded, uint8_t pt[CRYPTO_IN_SIZE], uint8_t rounds);
+
+/**
+ * @brief Encrypt fewer than BITSLICE_WIDTH blocks in place as one batch.
+ *
+ * Lanes without a block are not transposed if they fill whole tiles, so the transposition shrinks with n when
+ * BITSLICE_WIDTH is wider than BS_WORD_BITS. The rounds still cost a whole batch. Unless n is BITSLICE_WIDTH, it runs
+ * on the calling core alone.
+ *
+ * @param expanded expanded key
+ * @param pt n blocks
+ * @param n number of blocks, at most BITSLICE_WIDTH
+ */
+void present_encrypt_tail(const present_expanded_key_t *expanded, uint8_t *pt, size_t n);
+
+#ifdef PRESENT_BS_FIXED_KEY
+/**
+ * @brief Encrypt BITSLICE_WIDTH blocks in place under the key that gen_kernels.py folded into the rounds.
+ *
+ * Only built with the kernels of gen_kernels.py and a key, see PRESENT_BS_FIXED_KEY in CMakeLists.txt.
+ * There is no key schedule and no round key in memory. It runs on the calling core alone.
+ *
+ * @param pt BITSLICE_WIDTH blocks
+ */
+void present_encrypt_fixed_key(uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH]);
+#endif
+
+/**
+ * @brief Counter mode context.
+ *
+ * Counter block n is the little-endian 64-bit integer iv + n, in the byte order of the test vectors, so block 0 is the IV.
+ * The keystream of one batch of BITSLICE_WIDTH counter blocks is kept between calls of present_ctr_update.
+ */
+typedef struct
+{
+    present_expanded_key_t expanded;
+    // Counter of the first block of the next batch
+    uint64_t counter;
+    // Slice k has bit k of each lane index, see present_ctr_init
+    bs_reg_t lane_bs[BITSLICE_LOG2];
+    uint8_t keystream[CRYPTO_IN_SIZE * BITSLICE_WIDTH];
+    // Bytes of keystream already used
+    uint16_t keystream_used;
+} present_ctr_t;
+
+/**
+ * @brief Start counter mode.
+ *
+ * @param ctx Output: context, about 8 KB with 32 lanes, so better not on the stack of the pico
+ * @param key 80-bit key
+ * @param iv first counter block
+ */
+void present_ctr_init(present_ctr_t *ctx, const uint8_t key[CRYPTO_KEY_SIZE], const uint8_t iv[CRYPTO_IN_SIZE]);
+
+/**
+ * @brief present_ctr_init for PRESENT-128.
+ *
+ * @param ctx Output: context
+ * @param key 128-bit key
+ * @param iv first counter block
+ */
+void present_ctr_init_128(present_ctr_t *ctx, const uint8_t key[CRYPTO_KEY_SIZE_128], const uint8_t iv[CRYPTO_IN_SIZE]);
+
+/**
+ * @brief Encrypt or decrypt the next len bytes of a stream in place.
+ *
+ * len can be anything, the stream goes on where the last call stopped.
+ *
+ * @param ctx context
+ * @param buf data
+ * @param len length of data in bytes
+ */
+void present_ctr_update(present_ctr_t *ctx, uint8_t *buf, size_t len);
+
+/**
+ * @brief CMAC context with the expanded key and both subkeys, derived once per key.
+ *
+ * Blocks are in the byte order of the test vectors like everywhere else: the subkeys are doubled as little-endian
+ * 64-bit integers, and a short last block is padded with 0x80 after its last byte.
+ */
+typedef struct
+{
+    present_expanded_key_t expanded;
+    uint64_t k1;
+    uint64_t k2;
+} present_cmac_t;
+
+/**
+ * @brief Run the key schedule and derive the CMAC subkeys.
+ *
+ * @param ctx Output: context, about 8 KB with 32 lanes, so better not on the stack of the pico
+ * @param key 80-bit key
+ */
+void present_cmac_init(present_cmac_t *ctx, const uint8_t key[CRYPTO_KEY_SIZE]);
+
+/**
+ * @brief present_cmac_init for PRESENT-128.
+ *
+ * @param ctx Output: context
+ * @param key 128-bit key
+ */
+void present_cmac_init_128(present_cmac_t *ctx, const uint8_t key[CRYPTO_KEY_SIZE_128]);
+
+/**
+ * @brief CMAC of many independent messages under one key.
+ *
+ * CMAC is serial within a message, so each lane gets a message of its own, and each pass encrypts the next block
+ * of up to BITSLICE_WIDTH messages. A batch takes as many passes as its longest message has blocks, so messages of
+ * similar length should be next to each other.
+ *
+ * @param ctx context
+ * @param msgs messages
+ * @param lens lengths of the messages in bytes, any length including 0
+ * @param count number of messages
+ * @param tags Output: count tags of CRYPTO_OUT_SIZE bytes
+ */
+void present_cmac(const present_cmac_t *ctx, const uint8_t *const *msgs, const size_t *lens, size_t count, uint8_t *tags);
+
+// Keys that present_keysearch_run keeps, further matches are only counted.
+#define PRESENT_KEYSEARCH_FOUND 8
+
+/**
+ * @brief Exhaustive search of the unknown bits of a key from one known plaintext and ciphertext.
+ *
+ * Each lane tests another candidate key. The lowest BITSLICE_LOG2 unknown bits are the lane index and the others the
+ * batch index, so the key registers of a batch are built from constants and lane_bs without a transposition. The
+ * plaintext is the same in all lanes, so it is folded into the first round key addition the same way.
+ */
+typedef struct
+{
+    // Known key bits, the unknown ones are 0
+    uint8_t key[CRYPTO_KEY_SIZE_128];
+    uint8_t key_size;
+    // Bits of the key register that are unknown, lowest first
+    uint8_t unknown[CRYPTO_KEY_SIZE_128_BIT];
+    uint8_t unknown_count;
+    uint8_t rounds;
+    uint64_t pt;
+    uint64_t ct;
+    // Slice k has bit k of each lane index, see present_ctr_init
+    bs_reg_t lane_bs[BITSLICE_LOG2];
+    // Lanes that repeat a candidate when there are fewer than BITSLICE_LOG2 unknown bits
+    bs_reg_t lane_unused;
+    // Next batch and number of batches of the whole key space
+    uint64_t next_batch;
+    uint64_t batches;
+    // Progress: candidates tested and the time spent in present_keysearch_run
+    uint64_t keys_tested;
+    uint64_t time_us;
+    // Matching keys, of which the first PRESENT_KEYSEARCH_FOUND are kept in found
+    uint32_t found_count;
+    uint8_t found[PRESENT_KEYSEARCH_FOUND][CRYPTO_KEY_SIZE_128];
+} present_keysearch_t;
+
+/**
+ * @brief Start a key search with 80-bit keys.
+ *
+ * Bit i of the key register is bit i % 8 of byte i / 8, like the blocks, and the same for mask.
+ *
+ * @param ctx Output: context
+ * @param key known key bits, the others are ignored
+ * @param mask 1 for each unknown key bit, at most 63 + BITSLICE_LOG2 of them
+ * @param pt known plaintext
+ * @param ct its ciphertext after rounds rounds, see present_encrypt_block_rounds
+ * @param rounds number of rounds, 1 to CRYPTO_ROUNDS
+ *
+ * @return false if there are too many unknown bits or rounds is out of range
+ */
+bool present_keysearch_init(present_keysearch_t *ctx, const uint8_t key[CRYPTO_KEY_SIZE], const uint8_t mask[CRYPTO_KEY_SIZE],
+                            const uint8_t pt[CRYPTO_IN_SIZE], const uint8_t ct[CRYPTO_OUT_SIZE], uint8_t rounds);
+
+/**
+ * @brief present_keysearch_init for PRESENT-128.
+ *
+ * @param ctx Output: context
+ * @param key known key bits, the others are ignored
+ * @param mask 1 for each unknown key bit, at most 63 + BITSLICE_LOG2 of them
+ * @param pt known plaintext
+ * @param ct its ciphertext after rounds rounds
+ * @param rounds number of rounds, 1 to CRYPTO_ROUNDS
+ *
+ * @return false if there are too many unknown bits or rounds is out of range
+ */
+bool present_keysearch_init_128(present_keysearch_t *ctx, const uint8_t key[CRYPTO_KEY_SIZE_128], const uint8_t mask[CRYPTO_KEY_SIZE_128],
+                                const uint8_t pt[CRYPTO_IN_SIZE], const uint8_t ct[CRYPTO_OUT_SIZE], uint8_t rounds);
+
+/**
+ * @brief Test the candidates of the next batches of the key space.
+ *
+ * The rounds run on the slices of all candidates of a batch, and the last round goes S-box by S-box: once every lane
+ * differs from the ciphertext in some bit, the batch is rejected without the remaining S-boxes. If
+ * OPTIMIZATION_MULTICORE, both cores take whole batches from either end of the range like present_encrypt_batches.
+ * Call it again with small counts to report progress in between, see present_keysearch_keys_per_second.
+ *
+ * @param ctx context
+ * @param batches number of batches of BITSLICE_WIDTH candidates to test at most
+ *
+ * @return true if there are batches left
+ */
+bool present_keysearch_run(present_keysearch_t *ctx, size_t batches);
+
+/**
+ * @brief Throughput of present_keysearch_run so far.
+ *
+ * @param ctx context
+ *
+ * @return candidate keys tested per second
+ */
+double present_keysearch_keys_per_second(const present_keysearch_t *ctx);
+
+/**
+ * @brief Run the key schedule once backwards from the key register after the last round.
+ *
+ * The result is the same as present_expand_key of the original key, and serves both directions.
+ *
+ * @param expanded Output: expanded key
+ * @param key Input: result of crypto_decryption_key, left unchanged
+ */
+void present_expand_decryption_key(present_expanded_key_t *expanded, const uint8_t key[CRYPTO_KEY_SIZE]);
+
+/**
+ * @brief present_expand_decryption_key for PRESENT-128.
+ *
+ * @param expanded Output: expanded key
+ * @param key Input: result of crypto_decryption_key_128, left unchanged
+ */
+void present_expand_decryption_key_128(present_expanded_key_t *expanded, const uint8_t key[CRYPTO_KEY_SIZE_128]);
+
+/**
+ * @brief Decrypt BITSLICE_WIDTH blocks in place under an expanded key.
+ *
+ * @param expanded expanded key
+ * @param ct BITSLICE_WIDTH blocks
+ */
+void present_decrypt_expanded(const present_expanded_key_t *expanded, uint8_t ct[CRYPTO_IN_SIZE * BITSLICE_WIDTH]);
+
+/**
+ * @brief Start to encrypt BITSLICE_WIDTH blocks in place under an expanded key, and return before they are done.
+ *
+ * If OPTIMIZATION_MULTICORE, core1 encrypts the whole batch alone on the worker of present_worker_start, which is
+ * started if needed, and core0 is free for other work such as I/O. Only one batch is in flight, so this first waits
+ * for the previous one. Without OPTIMIZATION_MULTICORE the batch is encrypted before this returns.
+ *
+ * @param expanded expanded key, which must stay valid until present_encrypt_finish
+ * @param pt BITSLICE_WIDTH blocks, which must not be touched until present_encrypt_finish
+ */
+void present_encrypt_start(const present_expanded_key_t *expanded, uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH]);
+
+/**
+ * @brief Wait until the batch of present_encrypt_start is encrypted. Does nothing if no batch is in flight.
+ */
+void present_encrypt_finish(void);
+
+/**
+ * @brief Start a persistent worker on core1, or on a thread in the host build.
+ *
+ * With OPTIMIZATION_MULTICORE, every batch otherwise resets and launches core1 again. The worker is launched once and
+ * then only gets a pointer to each job through the FIFO. Without OPTIMIZATION_MULTICORE this does nothing.
+ */
+void present_worker_start(void);
+
+/**
+ * @brief Stop the worker of present_worker_start, after which each batch launches core1 again.
+ */
+void present_worker_stop(void);
+
+// The function to test
+void crypto_func(uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], uint8_t key[CRYPTO_KEY_SIZE]);
+
+/**
+ * @brief crypto_func with the 128-bit key schedule of PRESENT-128. The rounds are the same.
+ *
+ * @param pt BITSLICE_WIDTH blocks
+ * @param key 128-bit key
+ */
+void crypto_func_128(uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], uint8_t key[CRYPTO_KEY_SIZE_128]);
+
+/**
+ * @brief Encrypt BITSLICE_WIDTH blocks in place, each under its own key.
+ *
+ * @param pt BITSLICE_WIDTH blocks
+ * @param keys BITSLICE_WIDTH keys, the key of block j at keys + j * CRYPTO_KEY_SIZE
+ */
+void crypto_func_lane_keys(uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], const uint8_t keys[CRYPTO_KEY_SIZE * BITSLICE_WIDTH]);
+
+/**
+ * @brief crypto_func_lane_keys for PRESENT-128.
+ *
+ * @param pt BITSLICE_WIDTH blocks
+ * @param keys BITSLICE_WIDTH keys, the key of block j at keys + j * CRYPTO_KEY_SIZE_128
+ */
+void crypto_func_lane_keys_128(uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH], const uint8_t keys[CRYPTO_KEY_SIZE_128 * BITSLICE_WIDTH]);
+
+/**
+ * @brief Run the key schedule forward once, which turns a key into the key register decryption starts from.
+ *
+ * @param key Input: key, Output: key register after the last round
+ */
+void crypto_decryption_key(uint8_t key[CRYPTO_KEY_SIZE]);
+
+/**
+ * @brief crypto_decryption_key for PRESENT-128.
+ *
+ * @param key Input: key, Output: key register after the last round
+ */
+void crypto_decryption_key_128(uint8_t key[CRYPTO_KEY_SIZE_128]);
+
+/**
+ * @brief Decrypt BITSLICE_WIDTH blocks in place.
+ *
+ * @param ct Input: ciphertexts, Output: plaintexts
+ * @param key Input: result of crypto_decryption_key, left unchanged
+ */
+void crypto_func_decrypt(uint8_t ct[CRYPTO_IN_SIZE * BITSLICE_WIDTH], uint8_t key[CRYPTO_KEY_SIZE]);
+
+/**
+ * @brief crypto_func_decrypt for PRESENT-128.
+ *
+ * @param ct Input: ciphertexts, Output: plaintexts
+ * @param key Input: result of crypto_decryption_key_128, left unchanged
+ */
+void crypto_func_decrypt_128(uint8_t ct[CRYPTO_IN_SIZE * BITSLICE_WIDTH], uint8_t key[CRYPTO_KEY_SIZE_128]);
+
 #endif
\ No newline at end of file
@@ -1,151 +1,358 @@
-/**
- * Based on https://gist.github.com/nezza/27835ad5e5d5482e2b81445c5ab8df9c by Thomas Roth <code@stacksmashing.net>
- * Modified by David Oswald <d.f.oswald@bham.ac.uk>
- **/
-
-#include <stdio.h>
-#include <string.h>
-#include <stdint.h>
-#include <stdbool.h>
-#include <stdio.h>
-
-#include "pico/stdlib.h"
-#include "hardware/gpio.h"
-#include "hardware/timer.h"
-#include "hardware/clocks.h"
-#include "hardware/structs/pll.h"
-#include "hardware/structs/clocks.h"
-#include "hardware/structs/systick.h"
-
-#include "crypto.h"
-
-#define TRIGGER_ACTIVE() {}
-#define TRIGGER_RELEASE() {}
-
-const uint LED_PIN = 25;
-
-
-
-// based on https://forums.raspberrypi.com/viewtopic.php?f=145&t=304201&p=1820770&hilit=Hermannsw+systick#p1822677
-static void systick_init()
-{
-	systick_hw->csr = 0b00000101; // 0x5;
-    systick_hw->rvr = 0x00FFFFFF;
-}
-
-static uint64_t cpucycles()
-{
-	return systick_hw->cvr;
-}
-
-static uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH] = { 0 };
-static uint8_t key[CRYPTO_KEY_SIZE] = { 0 };
-	
-int main() 
-{
-	uint8_t b = 0;
-	uint64_t begin = 0, end = 0, duration;
-	int c = -1;
-	
-	stdio_init_all();
-	systick_init();
-	
-	sleep_ms(2000);
-	printf("Welcome to the PRESENT bitslicing program v0.1...\n");
-	
-	gpio_init(LED_PIN);
-    gpio_set_dir(LED_PIN, GPIO_OUT);
-	gpio_put(LED_PIN, 1);
-	
-	uint8_t block_index = 0;
-	
-	while (1)
-    {	
-		c = getchar_timeout_us(100000);
-		
-		// Input block (plaintext)
-		if(c == (int)'b')
-		{
-			gpio_put(LED_PIN, 0);
-			
-			// Get block
-			b = 0;
-			while(b < CRYPTO_IN_SIZE)
-			{
-				int x = getchar_timeout_us(100000);
-				
-				if(x != PICO_ERROR_TIMEOUT)
-				{
-					pt[b + CRYPTO_IN_SIZE * block_index] = x & 0xff;
-					b++;
-				}
-			}
-			
-			// RX ok
-			putchar_raw(0xFF);
-			putchar_raw(block_index);
-			
-			// Next block, roll over at 16
-			block_index = (block_index + 1) % BITSLICE_WIDTH;
-			
-			gpio_put(LED_PIN, 1);
-		}
-		else if(c == (int)'e')
-		{
-			gpio_put(LED_PIN, 0);
-			
-			// Get key
-			b = 0;
-			while(b < CRYPTO_KEY_SIZE)
-			{
-				int x = getchar_timeout_us(100000);
-				
-				if(x != PICO_ERROR_TIMEOUT)
-				{
-					key[b] = x & 0xff;
-					b++;
-				}
-			}
-			
-			// Execute crypto code
-			TRIGGER_ACTIVE();
-			begin = cpucycles();
-			crypto_func(pt, key);
-			end = cpucycles();
-			TRIGGER_RELEASE();
-			
-			// Systick *decreases*
-			duration = begin - end; 
-			
-			for(b = 0; b < 8; b++)
-			{
-				putchar_raw(duration & (uint64_t)0xff);
-				duration >>= 8;
-			}
-			
-			gpio_put(LED_PIN, 1);
-		}
-		// Get output block
-		else if(c == (int)'o')
-		{
-			gpio_put(LED_PIN, 0);
-			
-			for(b = 0; b < CRYPTO_OUT_SIZE; b++)
-			{
-				putchar_raw(pt[b + CRYPTO_IN_SIZE * block_index]);
-			}
-
-			// Block ok
-			putchar_raw(0xFF);
-			putchar_raw(block_index);
-			
-			// Next block, roll over at 16
-			block_index = (block_index + 1) % BITSLICE_WIDTH;
-			
-			gpio_put(LED_PIN, 1);
-		}
-	}
-
-    return 0;
-}
-
+/**
+ * Based on https://gist.github.com/nezza/27835ad5e5d5482e2b81445c5ab8df9c by Thomas Roth <code@stacksmashing.net>
+ * Modified by David Oswald <d.f.oswald@bham.ac.uk>
+ **/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "platform.h"
+#include "instrument.h"
+
+#include "crypto.h"
+
+#define TRIGGER_ACTIVE() {}
+#define TRIGGER_RELEASE() {}
+
+// Batch buffers of the 'P' command, one for each of receive, encrypt and send.
+#define PIPELINE_DEPTH 3
+
+static uint8_t pt[CRYPTO_IN_SIZE * BITSLICE_WIDTH] = { 0 };
+static uint8_t key[CRYPTO_KEY_SIZE_128] = { 0 };
+static uint8_t lane_keys[CRYPTO_KEY_SIZE_128 * BITSLICE_WIDTH] = { 0 };
+// Key size of all commands, selected with 'K'
+static uint8_t key_size = CRYPTO_KEY_SIZE;
+static present_expanded_key_t expanded;
+static uint8_t pipeline[PIPELINE_DEPTH][CRYPTO_IN_SIZE * BITSLICE_WIDTH];
+	
+int main() 
+{
+	uint8_t b = 0;
+	uint64_t begin = 0, end = 0, duration;
+	int c = -1;
+	
+	platform_init();
+	
+	// Launch core1 once, it waits for batches from now on.
+	present_worker_start();
+	
+	platform_log("Welcome to the PRESENT bitslicing program v0.1...\n");
+	
+	platform_led_put(1);
+	
+	// Wide enough for up to 512 blocks per batch, only the low byte is acknowledged.
+	uint16_t block_index = 0;
+	
+	while (1)
+    {	
+		c = platform_getchar_timeout_us(100000);
+		
+		// Input block (plaintext)
+		if(c == (int)'b')
+		{
+			platform_led_put(0);
+			
+			// Get block
+			b = 0;
+			while(b < CRYPTO_IN_SIZE)
+			{
+				int x = platform_getchar_timeout_us(100000);
+				
+				if(x != PLATFORM_ERROR_TIMEOUT)
+				{
+					pt[b + CRYPTO_IN_SIZE * block_index] = x & 0xff;
+					b++;
+				}
+			}
+			
+			// RX ok
+			platform_putchar_raw(0xFF);
+			platform_putchar_raw(block_index & 0xff);
+			
+			// Next block, roll over at BITSLICE_WIDTH
+			block_index = (block_index + 1) % BITSLICE_WIDTH;
+			
+			platform_led_put(1);
+		}
+		// 'K': select PRESENT-80 or PRESENT-128 with the key size in bytes, answered by the key size in effect.
+		else if(c == (int)'K')
+		{
+			int x;
+			
+			while((x = platform_getchar_timeout_us(100000)) == PLATFORM_ERROR_TIMEOUT);
+			
+			if(x == CRYPTO_KEY_SIZE || x == CRYPTO_KEY_SIZE_128)
+			{
+				key_size = x;
+			}
+			
+			platform_putchar_raw(key_size);
+		}
+		// 'e': encrypt, 'd': decrypt the blocks that were sent with 'b'
+		else if(c == (int)'e' || c == (int)'d')
+		{
+			platform_led_put(0);
+			
+			// Get key
+			b = 0;
+			while(b < key_size)
+			{
+				int x = platform_getchar_timeout_us(100000);
+				
+				if(x != PLATFORM_ERROR_TIMEOUT)
+				{
+					key[b] = x & 0xff;
+					b++;
+				}
+			}
+			
+			// Execute crypto code
+			if(c == (int)'e')
+			{
+				TRIGGER_ACTIVE();
+				begin = platform_cpucycles();
+				if(key_size == CRYPTO_KEY_SIZE_128)
+				{
+					crypto_func_128(pt, key);
+				}
+				else
+				{
+					crypto_func(pt, key);
+				}
+				end = platform_cpucycles();
+				TRIGGER_RELEASE();
+			}
+			else
+			{
+				// Like the key schedule of a cipher context, this is not part of the measurement.
+				if(key_size == CRYPTO_KEY_SIZE_128)
+				{
+					crypto_decryption_key_128(key);
+				}
+				else
+				{
+					crypto_decryption_key(key);
+				}
+				
+				TRIGGER_ACTIVE();
+				begin = platform_cpucycles();
+				if(key_size == CRYPTO_KEY_SIZE_128)
+				{
+					crypto_func_decrypt_128(pt, key);
+				}
+				else
+				{
+					crypto_func_decrypt(pt, key);
+				}
+				end = platform_cpucycles();
+				TRIGGER_RELEASE();
+			}
+			
+			duration = (end - begin) & PLATFORM_CYCLES_MASK;
+			
+			for(b = 0; b < 8; b++)
+			{
+				platform_putchar_raw(duration & (uint64_t)0xff);
+				duration >>= 8;
+			}
+			
+			platform_led_put(1);
+		}
+		// Encrypt each block under its own key
+		else if(c == (int)'k')
+		{
+			platform_led_put(0);
+			
+			// Get one key per block
+			uint16_t k = 0;
+			while(k < key_size * BITSLICE_WIDTH)
+			{
+				int x = platform_getchar_timeout_us(100000);
+				
+				if(x != PLATFORM_ERROR_TIMEOUT)
+				{
+					lane_keys[k] = x & 0xff;
+					k++;
+				}
+			}
+			
+			// Execute crypto code
+			TRIGGER_ACTIVE();
+			begin = platform_cpucycles();
+			if(key_size == CRYPTO_KEY_SIZE_128)
+			{
+				crypto_func_lane_keys_128(pt, lane_keys);
+			}
+			else
+			{
+				crypto_func_lane_keys(pt, lane_keys);
+			}
+			end = platform_cpucycles();
+			TRIGGER_RELEASE();
+			
+			duration = (end - begin) & PLATFORM_CYCLES_MASK;
+			
+			for(b = 0; b < 8; b++)
+			{
+				platform_putchar_raw(duration & (uint64_t)0xff);
+				duration >>= 8;
+			}
+			
+			platform_led_put(1);
+		}
+		// Bulk encryption: key, number of blocks as 4 bytes little-endian and the blocks.
+		// Answered by the ciphertexts and the cycle count, without any round trip in between.
+		else if(c == (int)'B')
+		{
+			uint8_t count[4];
+			uint32_t blocks;
+			
+			platform_led_put(0);
+			
+			platform_read_blocking(key, key_size);
+			platform_read_blocking(count, sizeof(count));
+			
+			blocks = count[0] | count[1] << 8 | count[2] << 16 | (uint32_t)count[3] << 24;
+			
+			begin = platform_cpucycles();
+			if(key_size == CRYPTO_KEY_SIZE_128)
+			{
+				present_expand_key_128(&expanded, key);
+			}
+			else
+			{
+				present_expand_key(&expanded, key);
+			}
+			end = platform_cpucycles();
+			
+			duration = (end - begin) & PLATFORM_CYCLES_MASK;
+			
+			// One batch at a time, the blocks of the 'b' command are overwritten.
+			// A last batch that is not full is encrypted anyway and only its blocks are sent.
+			while(blocks > 0)
+			{
+				uint32_t n = blocks < BITSLICE_WIDTH ? blocks : BITSLICE_WIDTH;
+				
+				platform_read_blocking(pt, n * CRYPTO_IN_SIZE);
+				
+				TRIGGER_ACTIVE();
+				begin = platform_cpucycles();
+				present_encrypt_expanded(&expanded, pt);
+				end = platform_cpucycles();
+				TRIGGER_RELEASE();
+				
+				duration += (end - begin) & PLATFORM_CYCLES_MASK;
+				
+				platform_write(pt, n * CRYPTO_IN_SIZE);
+				
+				blocks -= n;
+			}
+			
+			for(b = 0; b < 8; b++)
+			{
+				platform_putchar_raw(duration & (uint64_t)0xff);
+				duration >>= 8;
+			}
+			
+			platform_led_put(1);
+		}
+		// Bulk encryption like 'B', but pipelined: core1 encrypts batch k while core0 receives batch k + 1 and sends batch k - 1.
+		// The cycle count is how long core0 waited for core1, which stays 0 as long as the serial port is the bottleneck.
+		else if(c == (int)'P')
+		{
+			uint8_t count[4];
+			uint32_t blocks, batches, k;
+			
+			platform_led_put(0);
+			
+			platform_read_blocking(key, key_size);
+			platform_read_blocking(count, sizeof(count));
+			
+			blocks = count[0] | count[1] << 8 | count[2] << 16 | (uint32_t)count[3] << 24;
+			batches = blocks / BITSLICE_WIDTH + (blocks % BITSLICE_WIDTH != 0);
+			
+			if(key_size == CRYPTO_KEY_SIZE_128)
+			{
+				present_expand_key_128(&expanded, key);
+			}
+			else
+			{
+				present_expand_key(&expanded, key);
+			}
+			duration = 0;
+			
+			// Batch k stays in pipeline[k % PIPELINE_DEPTH] from its receipt until it is sent.
+			// One more step than batches drains the pipeline.
+			for(k = 0; k <= batches; k++)
+			{
+				uint8_t *next = pipeline[k % PIPELINE_DEPTH];
+				uint8_t *last = pipeline[(k + PIPELINE_DEPTH - 1) % PIPELINE_DEPTH];
+				
+				// Receive batch k while core1 is still on batch k - 1.
+				if(k < batches)
+				{
+					uint32_t n = blocks - k * BITSLICE_WIDTH;
+					
+					platform_read_blocking(next, (n < BITSLICE_WIDTH ? n : BITSLICE_WIDTH) * CRYPTO_IN_SIZE);
+				}
+				
+				begin = platform_cpucycles();
+				present_encrypt_finish();
+				end = platform_cpucycles();
+				
+				duration += (end - begin) & PLATFORM_CYCLES_MASK;
+				
+				// Hand batch k over to core1, then send batch k - 1 while it is encrypted.
+				if(k < batches)
+				{
+					present_encrypt_start(&expanded, next);
+				}
+				
+				if(k > 0)
+				{
+					uint32_t n = blocks - (k - 1) * BITSLICE_WIDTH;
+					
+					platform_write(last, (n < BITSLICE_WIDTH ? n : BITSLICE_WIDTH) * CRYPTO_IN_SIZE);
+				}
+			}
+			
+			for(b = 0; b < 8; b++)
+			{
+				platform_putchar_raw(duration & (uint64_t)0xff);
+				duration >>= 8;
+			}
+			
+			platform_led_put(1);
+		}
+		// 'I': cycles per stage of the cipher since the last 'I', see instrument_dump
+		else if(c == (int)'I')
+		{
+			instrument_dump();
+		}
+		// Get output block
+		else if(c == (int)'o')
+		{
+			platform_led_put(0);
+			
+			for(b = 0; b < CRYPTO_OUT_SIZE; b++)
+			{
+				platform_putchar_raw(pt[b + CRYPTO_IN_SIZE * block_index]);
+			}
+
+			// Block ok
+			platform_putchar_raw(0xFF);
+			platform_putchar_raw(block_index & 0xff);
+			
+			// Next block, roll over at BITSLICE_WIDTH
+			block_index = (block_index + 1) % BITSLICE_WIDTH;
+			
+			platform_led_put(1);
+		}
+	}
+
+    return 0;
+}
+
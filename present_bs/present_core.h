@@ -0,0 +1,159 @@
+#ifndef __PRESENT_CORE_H
+#define __PRESENT_CORE_H
+
+#include <stdint.h>
+
+// SBOX_CIRCUIT and INV_SBOX_CIRCUIT, generated by gen_sbox_circuit.py --header.
+#include "sbox_circuit.h"
+
+/**
+ * The parts of PRESENT that present_bs/crypto.c and the template engine of host/present_engine.h share: the S-box in
+ * bitsliced form, the slice orders of fixslicing and the key schedule. The engine includes this header instead of
+ * having copies of them, so both always compute the same cipher. It is plain C that compiles as C++ as well, and
+ * depends on nothing of crypto.h.
+ */
+
+/**
+ * @brief Calculate the new index of bit in the permutation layer.
+ *
+ * @param i index of a bit
+ *
+ * @return new index
+ *
+ */
+#define PBOX(i) ((i / 4) + (i % 4) * 16)
+
+/**
+ * @brief Calculate the old index of bit in the permutation layer, which is the inverse of PBOX.
+ *
+ * @param i new index of a bit
+ *
+ * @return old index
+ *
+ */
+#define PBOX_INV(i) ((i % 16) * 4 + i / 16)
+
+/**
+ * @brief Index in state_bs of the ith slice in fixsliced form.
+ *
+ * The permutation layer only decides which slice goes into which register, so instead of moving the slices every round
+ * we leave them where they are and keep track of where each slice is. This is fixslicing.
+ *
+ * PBOX rotates the three base-4 digits of an index, so applying it three times gives the original order again.
+ * After r rounds the ith slice is in state_bs[PBOX^-r(i)], which leaves only three orders:
+ *
+ * phase 0 (r % 3 == 0): i
+ * phase 1 (r % 3 == 1): PBOX_INV(i)
+ * phase 2 (r % 3 == 2): PBOX(i) = PBOX_INV(PBOX_INV(i))
+ *
+ * The round key masks are stored in the order of their round by present_expand_key, and unslice undoes the order of the
+ * last round. Nothing is moved at all.
+ *
+ * @param i index of a slice
+ * @param phase slice order, FIX_PHASE of the rounds done
+ *
+ * @return index in state_bs
+ */
+static inline uint8_t fix_index(uint8_t i, uint8_t phase)
+{
+    if (phase == 1)
+    {
+        return PBOX_INV(i);
+    }
+    else if (phase == 2)
+    {
+        return PBOX(i);
+    }
+
+    return i;
+}
+
+/**
+ * @brief The S-box on four bitsliced signals of type T from its ANF, without OPTIMIZATION_SBOX.
+ *
+ * The formulas are derived at sbox_layer of present_bs/crypto.c. Like SBOX_CIRCUIT, each argument is read once and
+ * then overwritten with the result.
+ *
+ * @param T type of the signals
+ * @param x0 Input and Output: least significant bit
+ * @param x1 Input and Output: second bit
+ * @param x2 Input and Output: third bit
+ * @param x3 Input and Output: most significant bit
+ */
+#define SBOX_ANF(T, x0, x1, x2, x3)                                                         \
+    do                                                                                      \
+    {                                                                                       \
+        T a_ = (x0), b_ = (x1), c_ = (x2), d_ = (x3);                                       \
+        (x0) = a_ ^ c_ ^ (b_ & c_) ^ d_;                                                    \
+        (x1) = b_ ^ (a_ & b_ & c_) ^ d_ ^ (b_ & d_) ^ (a_ & b_ & d_) ^ (c_ & d_) ^          \
+               (a_ & c_ & d_);                                                              \
+        (x2) = ~((a_ & b_) ^ c_ ^ d_ ^ (a_ & d_) ^ (b_ & d_) ^ (a_ & b_ & d_) ^             \
+                 (a_ & c_ & d_));                                                           \
+        (x3) = ~(a_ ^ b_ ^ (b_ & c_) ^ (a_ & b_ & c_) ^ d_ ^ (a_ & b_ & d_) ^               \
+                 (a_ & c_ & d_));                                                           \
+    } while (0)
+
+/**
+ * @brief The inverse S-box from its ANF in the same form as SBOX_ANF, see inv_sbox_slices of present_bs/crypto.c.
+ */
+#define INV_SBOX_ANF(T, x0, x1, x2, x3)                                                     \
+    do                                                                                      \
+    {                                                                                       \
+        T a_ = (x0), b_ = (x1), c_ = (x2), d_ = (x3);                                       \
+        (x0) = ~(a_ ^ c_ ^ (b_ & d_));                                                      \
+        (x1) = a_ ^ b_ ^ (a_ & c_) ^ (a_ & b_ & c_) ^ d_ ^ (b_ & d_) ^ (a_ & b_ & d_) ^     \
+               (c_ & d_) ^ (a_ & c_ & d_);                                                  \
+        (x2) = ~((a_ & b_) ^ (a_ & c_) ^ (b_ & c_) ^ (a_ & b_ & c_) ^ d_ ^ (a_ & d_) ^      \
+                 (b_ & d_) ^ (a_ & b_ & d_) ^ (a_ & c_ & d_));                              \
+        (x3) = a_ ^ b_ ^ (a_ & b_) ^ c_ ^ (a_ & b_ & c_) ^ d_ ^ (a_ & c_ & d_);             \
+    } while (0)
+
+static const uint8_t present_sbox[16] = {0xC, 0x5, 0x6, 0xB, 0x9, 0x0, 0xA, 0xD, 0x3, 0xE, 0xF, 0x8, 0x4, 0x7, 0x1, 0x2};
+
+/**
+ * @brief One step of the key schedule on a key register in native words.
+ *
+ * The round key is the leftmost 64 bits, which are always hi. lo has the remaining 16 bits of an 80-bit key or 64 bits
+ * of a 128-bit key, so a step is a few shifts instead of one per byte.
+ *
+ * @param hi Input and Output: leftmost 64 bits of the key register
+ * @param lo Input and Output: remaining bits of the key register
+ * @param r round counter
+ * @param key_size 10 for PRESENT-80 or 16 for PRESENT-128
+ * @warning For correct function, has to be called with incremented r each time.
+ */
+static inline void key_schedule_step(uint64_t *hi, uint64_t *lo, uint8_t r, uint8_t key_size)
+{
+    const uint64_t h = *hi;
+    const uint64_t l = *lo;
+
+    if (key_size == 16)
+    {
+        // rotate left by 61 bit
+        *hi = l >> 3 | h << 61;
+        *lo = h >> 3 | l << 61;
+
+        // perform sbox lookup on the two nibbles of MSbits
+        *hi = (*hi & 0x00FFFFFFFFFFFFFFULL) | (uint64_t)present_sbox[*hi >> 60] << 60 |
+              (uint64_t)present_sbox[(*hi >> 56) & 0xF] << 56;
+
+        // XOR round counter k66 ... k62
+        *lo ^= (uint64_t)r << 62;
+        *hi ^= r >> 2;
+    }
+    else
+    {
+        // rotate right by 19 bit, lo is the low 16 bits
+        *hi = h >> 19 | l << 45 | h << 61;
+        *lo = (uint16_t)(h >> 3);
+
+        // perform sbox lookup on MSbits
+        *hi = (*hi & 0x0FFFFFFFFFFFFFFFULL) | (uint64_t)present_sbox[*hi >> 60] << 60;
+
+        // XOR round counter k19 ... k15
+        *lo ^= (uint16_t)(r << 15);
+        *hi ^= r >> 1;
+    }
+}
+
+#endif
@@ -0,0 +1,72 @@
+// Generated by gen_sbox_circuit.py --header, do not edit.
+#ifndef __SBOX_CIRCUIT_H
+#define __SBOX_CIRCUIT_H
+
+/**
+ * @brief The S-box of PRESENT on four bitsliced signals, a circuit of 16 gates checked against all 16 inputs.
+ *
+ * It is plain C and C++ for any type T with &, |, ^ and ~, from uint64_t to vector registers, so present_bs and the
+ * template engine of the host use the same gates. Each argument is read once and then overwritten with the result.
+ *
+ * @param T type of the signals
+ * @param x0 Input and Output: least significant bit
+ * @param x1 Input and Output: second bit
+ * @param x2 Input and Output: third bit
+ * @param x3 Input and Output: most significant bit
+ */
+#define SBOX_CIRCUIT(T, x0, x1, x2, x3)               \
+    do                                                \
+    {                                                 \
+        T a_ = (x0), b_ = (x1), c_ = (x2), d_ = (x3); \
+        T t0_ = b_ | c_;                              \
+        T t1_ = a_ ^ b_;                              \
+        T t2_ = d_ ^ t0_;                             \
+        T t3_ = c_ ^ t2_;                             \
+        T t4_ = t1_ & t3_;                            \
+        T t5_ = b_ ^ c_;                              \
+        T t6_ = t5_ | d_;                             \
+        T t7_ = t2_ ^ t6_;                            \
+        T t8_ = a_ & t7_;                             \
+        T t9_ = t1_ ^ t2_;                            \
+        T t10_ = t3_ ^ t8_;                           \
+        T t11_ = t7_ ^ t10_;                          \
+        T t12_ = ~t10_;                               \
+        T t13_ = a_ ^ t12_;                           \
+        T t14_ = c_ ^ t12_;                           \
+        T t15_ = t4_ ^ t14_;                          \
+        (x0) = t9_;                                   \
+        (x1) = t11_;                                  \
+        (x2) = t15_;                                  \
+        (x3) = t13_;                                  \
+    } while (0)
+
+/**
+ * @brief The inverse S-box of PRESENT in the same form as SBOX_CIRCUIT, a circuit of 16 gates.
+ */
+#define INV_SBOX_CIRCUIT(T, x0, x1, x2, x3)           \
+    do                                                \
+    {                                                 \
+        T a_ = (x0), b_ = (x1), c_ = (x2), d_ = (x3); \
+        T t0_ = a_ ^ c_;                              \
+        T t1_ = b_ ^ d_;                              \
+        T t2_ = t0_ & t1_;                            \
+        T t3_ = d_ ^ t2_;                             \
+        T t4_ = a_ | t3_;                             \
+        T t5_ = t0_ ^ t4_;                            \
+        T t6_ = a_ ^ t1_;                             \
+        T t7_ = t6_ ^ t3_;                            \
+        T t8_ = t7_ & t5_;                            \
+        T t9_ = b_ & d_;                              \
+        T t10_ = t6_ ^ t8_;                           \
+        T t11_ = t7_ ^ t5_;                           \
+        T t12_ = ~t7_;                                \
+        T t13_ = t10_ ^ t12_;                         \
+        T t14_ = ~t9_;                                \
+        T t15_ = t0_ ^ t14_;                          \
+        (x0) = t15_;                                  \
+        (x1) = t10_;                                  \
+        (x2) = t13_;                                  \
+        (x3) = t11_;                                  \
+    } while (0)
+
+#endif
@@ -1,141 +1,367 @@
-#!/usr/bin/python
-import serial
-import time
-import sys
-
-BLOCK_SIZE = 8
-KEY_SIZE = 10
-CPU_FREQUENCY = 125e6
-BITSLICE_CNT = 32
-
-BAUDRATE = 9600
-
-if len(sys.argv) != 2:
-    sys.exit("Usage: python3 ./test_against_testvectors.py [COMPORT, e.g. /dev/ttySX on WSL]")
-
-COM_PORT = sys.argv[1]
-
-ser = serial.Serial(COM_PORT, BAUDRATE, timeout=1)
-
-# 3 pt
-tv_pt = [
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,       
-    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,    
-    0x45, 0x84, 0x22, 0x7B, 0x38, 0xC1, 0x79, 0x55,
-]
-
-# 3 keys
-tv_key = [
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,    
-    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-    0x3c, 0xf4, 0x00, 0xd8, 0x28, 0xf1, 0x08, 0x7a, 0x60, 0x26,
-]
-
-# 9 ct
-tv_ct = [
-    #  Pt 0, key 0
-    0x45, 0x84, 0x22, 0x7b, 0x38, 0xc1, 0x79, 0x55, 
-    #  Pt 1, key 0
-    0x7b, 0x41, 0x68, 0x2f, 0xc7, 0xff, 0x12, 0xa1, 
-    #  Pt 2, key 0
-    0x9a, 0x36, 0xcc, 0x6f, 0xfd, 0x45, 0xdf, 0x4e, 
-    #  Pt 0, key 1
-    0x49, 0x50, 0x94, 0xf5, 0xc0, 0x46, 0x2c, 0xe7, 
-    #  Pt 1, key 1
-    0xd2, 0x10, 0x32, 0x21, 0xd3, 0xdc, 0x33, 0x33, 
-    #  Pt 2, key 1
-    0x4e, 0xa8, 0x43, 0x3c, 0xcf, 0x7f, 0x10, 0x25, 
-    #  Pt 0, key 2
-    0x5f, 0x46, 0x65, 0xf3, 0x2d, 0x76, 0xfe, 0x9a, 
-    #  Pt 1, key 2
-    0xb7, 0xf4, 0x2d, 0x2e, 0xe9, 0x48, 0x66, 0x23, 
-    #  Pt 2, key 2
-    0xd0, 0x44, 0x6a, 0x0a, 0xc9, 0x13, 0x35, 0xd4, 
-]
-
-TV_PT_COUNT = int(len(tv_pt) / BLOCK_SIZE)
-TV_KEY_COUNT = int(len(tv_key) / KEY_SIZE)
-
-debug = False
-
-def unpack_le(s):
-    return sum((s[i]) << (8 * i) for i in range(len(s)))
-
-for tv in range(TV_KEY_COUNT):
-    key = bytes(tv_key[tv*KEY_SIZE:(tv+1)*KEY_SIZE])
-    print("== Key " + str(tv) + " = " + key.hex())
-    
-
-    # Send 16 plaintext blocks
-    for j in range(BITSLICE_CNT):
-        # Plaintext
-        tv_idx = ((tv + j) % TV_PT_COUNT) * BLOCK_SIZE 
-        pt = tv_pt[tv_idx:(tv_idx + BLOCK_SIZE)]
-        
-        # send one block        
-        buf = str.encode("b")
-        buf += bytes(pt)
-        ser.write(buf)
-        
-        # read response
-        rx = ser.read(2)
-        
-        if debug:
-            print("[i] TX block {}: {} -> {}".format(j, buf.hex(), rx.hex()))
-        else:
-            print("[{}] ".format(j), end="")
-    
-    if debug == False:
-        print()
-
-    # Initial command & key
-    buf = str.encode("e")
-    buf += key
-   
-    if debug:
-        print("TX: " + buf.hex())
-
-    # Do operation
-    ser.write(buf)
-
-    # Get answer
-    rx = ser.read(8)
-
-    # duration in CPU cycles and seconds
-    duration = unpack_le(rx)
-
-    if debug:
-        print("[i] RX: " + rx.hex())
-
-    print("[+] Cycle count = " + str(duration) + " = " + str(duration/CPU_FREQUENCY) + " s")
-    print("[+] Cycle count per block = " + str(duration/BITSLICE_CNT) + " = " + str(duration/CPU_FREQUENCY/BITSLICE_CNT) + " s")
-
-    # Get ciphertext blocks
-    for j in range(BITSLICE_CNT):
-        # get one block        
-        ser.write(str.encode("o"))
-        
-        # read response
-        rx = ser.read(10)
-        
-        # Check result
-        tv_idx = ((tv + j) % TV_PT_COUNT) * BLOCK_SIZE 
-        tv_idx = tv_idx + tv*BLOCK_SIZE*TV_PT_COUNT
-        
-        r_ref = bytes(tv_ct[tv_idx:tv_idx+BLOCK_SIZE])
-        r_comp = rx[:BLOCK_SIZE]
-    
-        if r_ref == r_comp:
-            if debug:
-                print("[OK] Result correct: " + ''.join('{:02x} '.format((x)) for x in r_comp).upper())
-        else:
-            print ("[FAILED]")
-            print ("Got  : " + ''.join('{:02x} '.format((x)) for x in r_comp).upper())
-            print ("Exp't: " + ''.join('{:02x} '.format((x)) for x in r_ref).upper())
-            exit(0)
-        
-    print("[OK] Result correct")
-    print()
-    time.sleep(0.1)
-
-ser.close()
+#!/usr/bin/python
+import serial
+import time
+import sys
+
+BLOCK_SIZE = 8
+KEY_SIZE = 10
+CPU_FREQUENCY = 125e6
+BITSLICE_CNT = 32
+
+BAUDRATE = 9600
+
+if len(sys.argv) not in (2, 3):
+    sys.exit("Usage: python3 ./test_against_testvectors.py [COMPORT, e.g. /dev/ttySX on WSL] [BITSLICE_WIDTH, default 32]")
+
+COM_PORT = sys.argv[1]
+
+if len(sys.argv) == 3:
+    BITSLICE_CNT = int(sys.argv[2])
+
+ser = serial.Serial(COM_PORT, BAUDRATE, timeout=1)
+
+# 3 pt
+tv_pt = [
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,       
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,    
+    0x45, 0x84, 0x22, 0x7B, 0x38, 0xC1, 0x79, 0x55,
+]
+
+# 3 keys
+tv_key = [
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,    
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x3c, 0xf4, 0x00, 0xd8, 0x28, 0xf1, 0x08, 0x7a, 0x60, 0x26,
+]
+
+# 9 ct
+tv_ct = [
+    #  Pt 0, key 0
+    0x45, 0x84, 0x22, 0x7b, 0x38, 0xc1, 0x79, 0x55, 
+    #  Pt 1, key 0
+    0x7b, 0x41, 0x68, 0x2f, 0xc7, 0xff, 0x12, 0xa1, 
+    #  Pt 2, key 0
+    0x9a, 0x36, 0xcc, 0x6f, 0xfd, 0x45, 0xdf, 0x4e, 
+    #  Pt 0, key 1
+    0x49, 0x50, 0x94, 0xf5, 0xc0, 0x46, 0x2c, 0xe7, 
+    #  Pt 1, key 1
+    0xd2, 0x10, 0x32, 0x21, 0xd3, 0xdc, 0x33, 0x33, 
+    #  Pt 2, key 1
+    0x4e, 0xa8, 0x43, 0x3c, 0xcf, 0x7f, 0x10, 0x25, 
+    #  Pt 0, key 2
+    0x5f, 0x46, 0x65, 0xf3, 0x2d, 0x76, 0xfe, 0x9a, 
+    #  Pt 1, key 2
+    0xb7, 0xf4, 0x2d, 0x2e, 0xe9, 0x48, 0x66, 0x23, 
+    #  Pt 2, key 2
+    0xd0, 0x44, 0x6a, 0x0a, 0xc9, 0x13, 0x35, 0xd4, 
+]
+
+# PRESENT-128: 3 keys
+tv_key_128 = [
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xef, 0xcd, 0xab, 0x89, 0x67, 0x45, 0x23, 0x01, 0xef, 0xcd, 0xab, 0x89, 0x67, 0x45, 0x23, 0x01,
+]
+
+# PRESENT-128: 3 pt
+tv_pt_128 = [
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xef, 0xcd, 0xab, 0x89, 0x67, 0x45, 0x23, 0x01,
+]
+
+# PRESENT-128: 9 ct, tv_ct_128[key][pt]
+tv_ct_128 = [
+    0xaf, 0x00, 0x69, 0x2e, 0x2a, 0x70, 0xdb, 0x96,
+    0x63, 0xd5, 0xed, 0xe5, 0xe5, 0x19, 0x60, 0x3c,
+    0xe4, 0x0c, 0x00, 0x5b, 0x67, 0xd8, 0x60, 0x35,
+    0xd8, 0xa5, 0x72, 0x02, 0x71, 0x8c, 0x23, 0x13,
+    0xb4, 0xe5, 0x18, 0x42, 0xbd, 0x9f, 0x8d, 0x62,
+    0x13, 0xb8, 0xe2, 0xd3, 0x5b, 0x9f, 0x3e, 0x75,
+    0xe9, 0x1e, 0xdc, 0x37, 0xa9, 0xbc, 0xdb, 0x6f,
+    0x13, 0x21, 0x40, 0xea, 0x55, 0x9f, 0x77, 0x21,
+    0xd6, 0x1d, 0x67, 0x5e, 0x68, 0x28, 0x9d, 0x0e,
+]
+
+KEY_SIZE_128 = 16
+
+TV_PT_COUNT = int(len(tv_pt) / BLOCK_SIZE)
+TV_KEY_COUNT = int(len(tv_key) / KEY_SIZE)
+
+debug = False
+
+def unpack_le(s):
+    return sum((s[i]) << (8 * i) for i in range(len(s)))
+
+for tv in range(TV_KEY_COUNT):
+    key = bytes(tv_key[tv*KEY_SIZE:(tv+1)*KEY_SIZE])
+    print("== Key " + str(tv) + " = " + key.hex())
+    
+
+    # Send 16 plaintext blocks
+    for j in range(BITSLICE_CNT):
+        # Plaintext
+        tv_idx = ((tv + j) % TV_PT_COUNT) * BLOCK_SIZE 
+        pt = tv_pt[tv_idx:(tv_idx + BLOCK_SIZE)]
+        
+        # send one block        
+        buf = str.encode("b")
+        buf += bytes(pt)
+        ser.write(buf)
+        
+        # read response
+        rx = ser.read(2)
+        
+        if debug:
+            print("[i] TX block {}: {} -> {}".format(j, buf.hex(), rx.hex()))
+        else:
+            print("[{}] ".format(j), end="")
+    
+    if debug == False:
+        print()
+
+    # Initial command & key
+    buf = str.encode("e")
+    buf += key
+   
+    if debug:
+        print("TX: " + buf.hex())
+
+    # Do operation
+    ser.write(buf)
+
+    # Get answer
+    rx = ser.read(8)
+
+    # duration in CPU cycles and seconds
+    duration = unpack_le(rx)
+
+    if debug:
+        print("[i] RX: " + rx.hex())
+
+    print("[+] Cycle count = " + str(duration) + " = " + str(duration/CPU_FREQUENCY) + " s")
+    print("[+] Cycle count per block = " + str(duration/BITSLICE_CNT) + " = " + str(duration/CPU_FREQUENCY/BITSLICE_CNT) + " s")
+
+    # Get ciphertext blocks
+    for j in range(BITSLICE_CNT):
+        # get one block        
+        ser.write(str.encode("o"))
+        
+        # read response
+        rx = ser.read(10)
+        
+        # Check result
+        tv_idx = ((tv + j) % TV_PT_COUNT) * BLOCK_SIZE 
+        tv_idx = tv_idx + tv*BLOCK_SIZE*TV_PT_COUNT
+        
+        r_ref = bytes(tv_ct[tv_idx:tv_idx+BLOCK_SIZE])
+        r_comp = rx[:BLOCK_SIZE]
+    
+        if r_ref == r_comp:
+            if debug:
+                print("[OK] Result correct: " + ''.join('{:02x} '.format((x)) for x in r_comp).upper())
+        else:
+            print ("[FAILED]")
+            print ("Got  : " + ''.join('{:02x} '.format((x)) for x in r_comp).upper())
+            print ("Exp't: " + ''.join('{:02x} '.format((x)) for x in r_ref).upper())
+            exit(0)
+        
+    print("[OK] Result correct")
+
+    # The ciphertexts are still on the device, decrypt them back
+    buf = str.encode("d")
+    buf += key
+   
+    if debug:
+        print("TX: " + buf.hex())
+
+    ser.write(buf)
+
+    rx = ser.read(8)
+
+    duration = unpack_le(rx)
+
+    print("[+] Decryption cycle count = " + str(duration) + " = " + str(duration/CPU_FREQUENCY) + " s")
+    print("[+] Decryption cycle count per block = " + str(duration/BITSLICE_CNT) + " = " + str(duration/CPU_FREQUENCY/BITSLICE_CNT) + " s")
+
+    # Get plaintext blocks
+    for j in range(BITSLICE_CNT):
+        ser.write(str.encode("o"))
+        
+        rx = ser.read(10)
+        
+        tv_idx = ((tv + j) % TV_PT_COUNT) * BLOCK_SIZE 
+        
+        r_ref = bytes(tv_pt[tv_idx:tv_idx+BLOCK_SIZE])
+        r_comp = rx[:BLOCK_SIZE]
+    
+        if r_ref != r_comp:
+            print ("[FAILED] Decryption")
+            print ("Got  : " + ''.join('{:02x} '.format((x)) for x in r_comp).upper())
+            print ("Exp't: " + ''.join('{:02x} '.format((x)) for x in r_ref).upper())
+            exit(0)
+        
+    print("[OK] Decryption correct")
+    print()
+    time.sleep(0.1)
+
+# Bulk commands: all blocks of several batches in one go, answered by all ciphertexts and the cycle count.
+# 'P' does the same, but receives, encrypts and sends different batches at the same time.
+BULK_BLOCKS = 4 * BITSLICE_CNT
+
+for cmd, name in (("B", "Bulk"), ("P", "Pipelined bulk")):
+    for tv in range(TV_KEY_COUNT):
+        key = bytes(tv_key[tv*KEY_SIZE:(tv+1)*KEY_SIZE])
+        print("== " + name + ", key " + str(tv) + " = " + key.hex())
+
+        buf = str.encode(cmd) + key + BULK_BLOCKS.to_bytes(4, "little")
+        for j in range(BULK_BLOCKS):
+            tv_idx = (j % TV_PT_COUNT) * BLOCK_SIZE
+            buf += bytes(tv_pt[tv_idx:(tv_idx + BLOCK_SIZE)])
+
+        ser.write(buf)
+
+        rx = ser.read(BULK_BLOCKS * BLOCK_SIZE + 8)
+
+        duration = unpack_le(rx[BULK_BLOCKS * BLOCK_SIZE:])
+
+        # For the pipelined command, this is how long the device waited for the encryption instead of doing I/O
+        print("[+] Cycle count = " + str(duration) + " = " + str(duration/CPU_FREQUENCY) + " s")
+        print("[+] Cycle count per block = " + str(duration/BULK_BLOCKS) + " = " + str(duration/CPU_FREQUENCY/BULK_BLOCKS) + " s")
+
+        for j in range(BULK_BLOCKS):
+            tv_idx = (tv * TV_PT_COUNT + j % TV_PT_COUNT) * BLOCK_SIZE
+
+            r_ref = bytes(tv_ct[tv_idx:tv_idx+BLOCK_SIZE])
+            r_comp = rx[j*BLOCK_SIZE:(j+1)*BLOCK_SIZE]
+
+            if r_ref != r_comp:
+                print ("[FAILED] Block " + str(j))
+                print ("Got  : " + ''.join('{:02x} '.format((x)) for x in r_comp).upper())
+                print ("Exp't: " + ''.join('{:02x} '.format((x)) for x in r_ref).upper())
+                exit(0)
+
+        print("[OK] Result correct")
+        print()
+
+# Each block under its own key: block j gets key j % 3 and plaintext (j / 3) % 3
+print("== One key per block")
+
+for j in range(BITSLICE_CNT):
+    tv_idx = ((j // TV_KEY_COUNT) % TV_PT_COUNT) * BLOCK_SIZE
+    ser.write(str.encode("b") + bytes(tv_pt[tv_idx:(tv_idx + BLOCK_SIZE)]))
+    ser.read(2)
+
+buf = str.encode("k")
+for j in range(BITSLICE_CNT):
+    tv_idx = (j % TV_KEY_COUNT) * KEY_SIZE
+    buf += bytes(tv_key[tv_idx:(tv_idx + KEY_SIZE)])
+
+ser.write(buf)
+
+rx = ser.read(8)
+
+duration = unpack_le(rx)
+
+print("[+] Cycle count = " + str(duration) + " = " + str(duration/CPU_FREQUENCY) + " s")
+print("[+] Cycle count per block = " + str(duration/BITSLICE_CNT) + " = " + str(duration/CPU_FREQUENCY/BITSLICE_CNT) + " s")
+
+for j in range(BITSLICE_CNT):
+    ser.write(str.encode("o"))
+    
+    rx = ser.read(10)
+    
+    tv_idx = ((j % TV_KEY_COUNT) * TV_PT_COUNT + (j // TV_KEY_COUNT) % TV_PT_COUNT) * BLOCK_SIZE
+    
+    r_ref = bytes(tv_ct[tv_idx:tv_idx+BLOCK_SIZE])
+    r_comp = rx[:BLOCK_SIZE]
+
+    if r_ref != r_comp:
+        print ("[FAILED] Block " + str(j))
+        print ("Got  : " + ''.join('{:02x} '.format((x)) for x in r_comp).upper())
+        print ("Exp't: " + ''.join('{:02x} '.format((x)) for x in r_ref).upper())
+        exit(0)
+
+print("[OK] Result correct")
+print()
+
+# PRESENT-128: select the key size with 'K', which answers with the key size in effect.
+# All commands then take 16-byte keys, checked here with the bulk command and one key per block.
+ser.write(str.encode("K") + bytes([KEY_SIZE_128]))
+if ser.read(1) != bytes([KEY_SIZE_128]):
+    sys.exit("[FAILED] PRESENT-128 not selected")
+
+for tv in range(TV_KEY_COUNT):
+    key = bytes(tv_key_128[tv*KEY_SIZE_128:(tv+1)*KEY_SIZE_128])
+    print("== PRESENT-128 bulk, key " + str(tv) + " = " + key.hex())
+
+    buf = str.encode("B") + key + BULK_BLOCKS.to_bytes(4, "little")
+    for j in range(BULK_BLOCKS):
+        tv_idx = (j % TV_PT_COUNT) * BLOCK_SIZE
+        buf += bytes(tv_pt_128[tv_idx:(tv_idx + BLOCK_SIZE)])
+
+    ser.write(buf)
+
+    rx = ser.read(BULK_BLOCKS * BLOCK_SIZE + 8)
+
+    for j in range(BULK_BLOCKS):
+        tv_idx = (tv * TV_PT_COUNT + j % TV_PT_COUNT) * BLOCK_SIZE
+
+        if bytes(tv_ct_128[tv_idx:tv_idx+BLOCK_SIZE]) != rx[j*BLOCK_SIZE:(j+1)*BLOCK_SIZE]:
+            print ("[FAILED] Block " + str(j))
+            exit(0)
+
+    print("[OK] Result correct")
+    print()
+
+print("== PRESENT-128, one key per block")
+
+for j in range(BITSLICE_CNT):
+    tv_idx = ((j // TV_KEY_COUNT) % TV_PT_COUNT) * BLOCK_SIZE
+    ser.write(str.encode("b") + bytes(tv_pt_128[tv_idx:(tv_idx + BLOCK_SIZE)]))
+    ser.read(2)
+
+buf = str.encode("k")
+for j in range(BITSLICE_CNT):
+    tv_idx = (j % TV_KEY_COUNT) * KEY_SIZE_128
+    buf += bytes(tv_key_128[tv_idx:(tv_idx + KEY_SIZE_128)])
+
+ser.write(buf)
+
+ser.read(8)
+
+for j in range(BITSLICE_CNT):
+    ser.write(str.encode("o"))
+
+    rx = ser.read(10)
+
+    tv_idx = ((j % TV_KEY_COUNT) * TV_PT_COUNT + (j // TV_KEY_COUNT) % TV_PT_COUNT) * BLOCK_SIZE
+
+    if bytes(tv_ct_128[tv_idx:tv_idx+BLOCK_SIZE]) != rx[:BLOCK_SIZE]:
+        print ("[FAILED] Block " + str(j))
+        exit(0)
+
+print("[OK] Result correct")
+print()
+
+# Back to PRESENT-80
+ser.write(str.encode("K") + bytes([KEY_SIZE]))
+ser.read(1)
+
+# Cycles per stage since the start, only with firmware built with PRESENT_INSTRUMENT
+INSTRUMENT_STAGES = ["enslice", "add_round_key", "sbox_layer", "pbox_layer", "update_round_key", "barrier", "unslice"]
+
+ser.write(str.encode("I"))
+stages = ser.read(1)[0]
+
+if stages != 0:
+    print("== Cycles per stage")
+    print("{:16} {:>10} {:>12} {:>8} {:>8} {:>8} {:>8}".format("stage", "count", "total", "min", "median", "p99", "max"))
+
+for s in range(stages):
+    rx = ser.read(6 * 8)
+    fields = [unpack_le(rx[i*8:(i+1)*8]) for i in range(6)]
+    name = INSTRUMENT_STAGES[s] if s < len(INSTRUMENT_STAGES) else str(s)
+    print("{:16} {:>10} {:>12} {:>8} {:>8} {:>8} {:>8}".format(name, *fields))
+
+ser.close()
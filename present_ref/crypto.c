@@ -1,140 +1,834 @@
-#include "crypto.h"
-
-
-/**
- * @brief Get ith bit from a byte
- * 
- * @param byte a byte
- * @param i ith
- * 
- * @return ith bit
- */
-#define GETBIT(byte, i) ((byte >> i) & 0x01)
-
-/**
- * @brief Calculate the new index of bit in pbox_layer
- * 
- * @param i index of a bit
- * 
- * @return new index
- * 
- */
-#define PBOX(i) ((i / 4) + (i % 4) * 16)
-
-/**
- * @brief Copy bit to ith bit of byte
- * 
- * @param byte a byte
- * @param i ith
- * @param bit bit value to be copied
- * 
- */
-#define CPYBIT(byte, i, bit) byte |= bit << i
-
-/**
- * @brief XOR the pt with roundkey.
- * 
- * @param pt state of previous round
- * @param roundkey key of this round
- */
-static void add_round_key(uint8_t pt[CRYPTO_IN_SIZE], uint8_t roundkey[CRYPTO_IN_SIZE])
-{
-	for (uint8_t i = 0; i < CRYPTO_IN_SIZE; i++) {
-		pt[i] ^= roundkey[i];
-	}
-}
-
-static const uint8_t sbox[16] = {
-	0xC, 0x5, 0x6, 0xB, 0x9, 0x0, 0xA, 0xD, 0x3, 0xE, 0xF, 0x8, 0x4, 0x7, 0x1, 0x2,
-};
-
-/**
- * @brief Replace each byte of state with value in sbox
- * 
- * @param s state
- */
-static void sbox_layer(uint8_t s[CRYPTO_IN_SIZE])
-{
-	// Up 4 bits and low 4 bits.
-	uint8_t un, ln;
-
-	for (uint8_t i = 0; i < CRYPTO_IN_SIZE; i++) {
-		un = s[i] >> 4;
-		ln = s[i] & 0x0F;
-
-		// Replace old byte with new byte
-		s[i] = sbox[ln] | (sbox[un] << 4);
-	}
-}
-
-/**
- * @brief Permutate each bit of 64-bit state
- * 
- * For ith bit, the new index is (i / 4) + (i % 4) * 16
- * 
- * @param s state
- */
-static void pbox_layer(uint8_t s[CRYPTO_IN_SIZE])
-{
-	// Create a tmp storing permutated state
-	uint8_t tmp_s[8] = {0u};
-
-	for (uint8_t i = 0; i < 64; i++) {
-		uint8_t tmp = GETBIT(s[i / 8], i % 8);
-		uint8_t new_i = PBOX(i);
-		CPYBIT(tmp_s[new_i / 8], new_i % 8, tmp);
-	}
-
-	memcpy(s, tmp_s, CRYPTO_IN_SIZE);
-}
-
-static void update_round_key(uint8_t key[CRYPTO_KEY_SIZE], const uint8_t r)
-{
-	//
-	// There is no need to edit this code
-	//
-	uint8_t tmp = 0;
-	const uint8_t tmp2 = key[2];
-	const uint8_t tmp1 = key[1];
-	const uint8_t tmp0 = key[0];
-	
-	// rotate right by 19 bit
-	key[0] = key[2] >> 3 | key[3] << 5;
-	key[1] = key[3] >> 3 | key[4] << 5;
-	key[2] = key[4] >> 3 | key[5] << 5;
-	key[3] = key[5] >> 3 | key[6] << 5;
-	key[4] = key[6] >> 3 | key[7] << 5;
-	key[5] = key[7] >> 3 | key[8] << 5;
-	key[6] = key[8] >> 3 | key[9] << 5;
-	key[7] = key[9] >> 3 | tmp0 << 5;
-	key[8] = tmp0 >> 3   | tmp1 << 5;
-	key[9] = tmp1 >> 3   | tmp2 << 5;
-	
-	// perform sbox lookup on MSbits
-	tmp = sbox[key[9] >> 4];
-	key[9] &= 0x0F;
-	key[9] |= tmp << 4;
-	
-	// XOR round counter k19 ... k15
-	key[1] ^= r << 7;
-	key[2] ^= r >> 1;
-}
-
-void crypto_func(uint8_t pt[CRYPTO_IN_SIZE], uint8_t key[CRYPTO_KEY_SIZE])
-{
-	//
-	// There is no need to edit this code
-	//
-	
-	uint8_t i = 0;
-	
-	for(i = 1; i <= 31; i++)
-	{
-		add_round_key(pt, key + 2);
-		sbox_layer(pt);
-		pbox_layer(pt);
-		update_round_key(key, i);
-	}
-	
-	add_round_key(pt, key + 2);
-}
+#include "crypto.h"
+
+#include "instrument.h"
+
+#define OPTIMIZATION_SP_TABLE
+
+/**
+ * Constant time instead of the tables of OPTIMIZATION_SP_TABLE, see nibble_sp_layer. It takes precedence when both are
+ * defined, and is set from outside by the _nibble targets of CMakeLists.txt and PRESENT_REF_NIBBLE_SLICE of the pico build.
+ */
+// #define OPTIMIZATION_NIBBLE_SLICE
+
+/**
+ * @brief Get ith bit from a byte
+ * 
+ * @param byte a byte
+ * @param i ith
+ * 
+ * @return ith bit
+ */
+#define GETBIT(byte, i) ((byte >> i) & 0x01)
+
+/**
+ * @brief Calculate the new index of bit in pbox_layer
+ * 
+ * @param i index of a bit
+ * 
+ * @return new index
+ * 
+ */
+#define PBOX(i) ((i / 4) + (i % 4) * 16)
+
+/**
+ * @brief Calculate the old index of bit in pbox_layer, which is the inverse of PBOX
+ * 
+ * @param i new index of a bit
+ * 
+ * @return old index
+ * 
+ */
+#define PBOX_INV(i) ((i % 16) * 4 + i / 16)
+
+/**
+ * @brief Copy bit to ith bit of byte
+ * 
+ * @param byte a byte
+ * @param i ith
+ * @param bit bit value to be copied
+ * 
+ */
+#define CPYBIT(byte, i, bit) byte |= bit << i
+
+#ifndef OPTIMIZATION_NIBBLE_SLICE
+static const uint8_t sbox[16] = {
+	0xC, 0x5, 0x6, 0xB, 0x9, 0x0, 0xA, 0xD, 0x3, 0xE, 0xF, 0x8, 0x4, 0x7, 0x1, 0x2,
+};
+
+static const uint8_t sbox_inv[16] = {
+	0x5, 0xE, 0xF, 0x8, 0xC, 0x1, 0x2, 0xD, 0xB, 0x4, 0x6, 0x3, 0x0, 0x7, 0x9, 0xA,
+};
+#endif
+
+#ifdef OPTIMIZATION_NIBBLE_SLICE
+/**
+ * @brief The S-box on 16 nibbles at once, one bit of each nibble per plane.
+ * 
+ * Bit n of plane j is bit j of nibble n, so this is the circuit of sbox_slices in present_bs with OPTIMIZATION_SBOX,
+ * found by gen_sbox_circuit.py. It has no table and no branch, so its time does not depend on the state.
+ * Only the low 16 bits of each plane are used, the bits above are left undefined.
+ * 
+ * @param x0 Input and Output: plane of the least significant bits
+ * @param x1 Input and Output: plane of the second bits
+ * @param x2 Input and Output: plane of the third bits
+ * @param x3 Input and Output: plane of the most significant bits
+ */
+static inline void sbox_planes(uint64_t *x0, uint64_t *x1, uint64_t *x2, uint64_t *x3)
+{
+	uint64_t a = *x0, b = *x1, c = *x2, d = *x3;
+	
+	uint64_t t0 = b | c;
+	uint64_t t1 = a ^ b;
+	uint64_t t2 = d ^ t0;
+	uint64_t t3 = c ^ t2;
+	uint64_t t4 = t1 & t3;
+	uint64_t t5 = b ^ c;
+	uint64_t t6 = t5 | d;
+	uint64_t t7 = t2 ^ t6;
+	uint64_t t8 = a & t7;
+	uint64_t t9 = t1 ^ t2;
+	uint64_t t10 = t3 ^ t8;
+	uint64_t t11 = t7 ^ t10;
+	uint64_t t12 = ~t10;
+	uint64_t t13 = a ^ t12;
+	uint64_t t14 = c ^ t12;
+	uint64_t t15 = t4 ^ t14;
+	*x0 = t9;
+	*x1 = t11;
+	*x2 = t15;
+	*x3 = t13;
+}
+
+/**
+ * @brief Inverse of sbox_planes, with the circuit of gen_sbox_circuit.py --inverse.
+ * 
+ * @param x0 Input and Output: plane of the least significant bits
+ * @param x1 Input and Output: plane of the second bits
+ * @param x2 Input and Output: plane of the third bits
+ * @param x3 Input and Output: plane of the most significant bits
+ */
+static inline void inv_sbox_planes(uint64_t *x0, uint64_t *x1, uint64_t *x2, uint64_t *x3)
+{
+	uint64_t a = *x0, b = *x1, c = *x2, d = *x3;
+	
+	uint64_t t0 = a ^ c;
+	uint64_t t1 = b ^ d;
+	uint64_t t2 = t0 & t1;
+	uint64_t t3 = d ^ t2;
+	uint64_t t4 = a | t3;
+	uint64_t t5 = t0 ^ t4;
+	uint64_t t6 = a ^ t1;
+	uint64_t t7 = t6 ^ t3;
+	uint64_t t8 = t7 & t5;
+	uint64_t t9 = b & d;
+	uint64_t t10 = t6 ^ t8;
+	uint64_t t11 = t7 ^ t5;
+	uint64_t t12 = ~t7;
+	uint64_t t13 = t10 ^ t12;
+	uint64_t t14 = ~t9;
+	uint64_t t15 = t0 ^ t14;
+	*x0 = t15;
+	*x1 = t10;
+	*x2 = t13;
+	*x3 = t11;
+}
+
+/**
+ * @brief Swap the bits of s selected by mask with the bits n places above them.
+ * 
+ * @param s word
+ * @param mask lower bit of each pair
+ * @param n distance of the bits of a pair
+ * 
+ * @return s with the pairs swapped
+ */
+static inline uint64_t delta_swap(uint64_t s, uint64_t mask, uint8_t n)
+{
+	uint64_t t = ((s >> n) ^ s) & mask;
+	
+	return s ^ t ^ (t << n);
+}
+
+/**
+ * @brief pbox_layer with shifts and masks.
+ * 
+ * PBOX rotates the three base-4 digits of a bit index: 16 * d2 + 4 * d1 + d0 goes to 16 * d0 + 4 * d2 + d1. That is
+ * a swap of d0 and d1 followed by a swap of d1 and d2, and swapping two digits swaps two pairs of index bits, each of
+ * which is one delta_swap.
+ * 
+ * PBOX also brings bit j of nibble n to bit 16 * j + n, which is bit n of plane j of sbox_planes.
+ * 
+ * @param s state
+ * 
+ * @return permutated state
+ */
+static uint64_t nibble_pbox(uint64_t s)
+{
+	INSTRUMENT_BEGIN();
+	
+	// Swap d0 and d1, index bits 0 and 2 and index bits 1 and 3
+	s = delta_swap(s, 0x0A0A0A0A0A0A0A0AULL, 3);
+	s = delta_swap(s, 0x00CC00CC00CC00CCULL, 6);
+	// Swap d1 and d2, index bits 2 and 4 and index bits 3 and 5
+	s = delta_swap(s, 0x0000F0F00000F0F0ULL, 12);
+	s = delta_swap(s, 0x00000000FF00FF00ULL, 24);
+	
+	INSTRUMENT_END(INSTRUMENT_PBOX_LAYER);
+	
+	return s;
+}
+
+/**
+ * @brief Undo nibble_pbox, with its swaps in reverse order.
+ * 
+ * @param s state
+ * 
+ * @return old state
+ */
+static uint64_t inv_nibble_pbox(uint64_t s)
+{
+	INSTRUMENT_BEGIN();
+	
+	s = delta_swap(s, 0x00000000FF00FF00ULL, 24);
+	s = delta_swap(s, 0x0000F0F00000F0F0ULL, 12);
+	s = delta_swap(s, 0x00CC00CC00CC00CCULL, 6);
+	s = delta_swap(s, 0x0A0A0A0A0A0A0A0AULL, 3);
+	
+	INSTRUMENT_END(INSTRUMENT_PBOX_LAYER);
+	
+	return s;
+}
+
+/**
+ * @brief sbox_layer and pbox_layer of a 64-bit state without tables.
+ * 
+ * The S-boxes are applied after the permutation instead of before it: nibble_pbox(s) holds the nibbles of s as four
+ * 16-bit bit-planes, so sbox_planes on the planes gives sbox_layer of s in the order of pbox_layer, which is the
+ * next state itself. There is no conversion into planes and back.
+ * 
+ * @param s state, bit i is bit i % 8 of byte i / 8
+ * 
+ * @return new state
+ */
+static uint64_t nibble_sp_layer(uint64_t s)
+{
+	s = nibble_pbox(s);
+	
+	INSTRUMENT_BEGIN();
+	
+	uint64_t x0 = s, x1 = s >> 16, x2 = s >> 32, x3 = s >> 48;
+	
+	sbox_planes(&x0, &x1, &x2, &x3);
+	
+	s = (x0 & 0xFFFF) | (x1 & 0xFFFF) << 16 | (x2 & 0xFFFF) << 32 | x3 << 48;
+	
+	INSTRUMENT_END(INSTRUMENT_SBOX_LAYER);
+	
+	return s;
+}
+
+/**
+ * @brief Undo nibble_sp_layer.
+ * 
+ * @param s state
+ * 
+ * @return old state
+ */
+static uint64_t inv_nibble_sp_layer(uint64_t s)
+{
+	INSTRUMENT_BEGIN();
+	
+	uint64_t x0 = s, x1 = s >> 16, x2 = s >> 32, x3 = s >> 48;
+	
+	inv_sbox_planes(&x0, &x1, &x2, &x3);
+	
+	s = (x0 & 0xFFFF) | (x1 & 0xFFFF) << 16 | (x2 & 0xFFFF) << 32 | x3 << 48;
+	
+	INSTRUMENT_END(INSTRUMENT_SBOX_LAYER);
+	
+	return inv_nibble_pbox(s);
+}
+#elif !defined(OPTIMIZATION_SP_TABLE)
+/**
+ * @brief XOR the pt with roundkey.
+ * 
+ * @param pt state of previous round
+ * @param roundkey key of this round
+ */
+static void add_round_key(uint8_t pt[CRYPTO_IN_SIZE], uint8_t roundkey[CRYPTO_IN_SIZE])
+{
+	INSTRUMENT_BEGIN();
+	
+	for (uint8_t i = 0; i < CRYPTO_IN_SIZE; i++) {
+		pt[i] ^= roundkey[i];
+	}
+	
+	INSTRUMENT_END(INSTRUMENT_ADD_ROUND_KEY);
+}
+
+/**
+ * @brief Replace each byte of state with value in sbox
+ * 
+ * @param s state
+ */
+static void sbox_layer(uint8_t s[CRYPTO_IN_SIZE])
+{
+	INSTRUMENT_BEGIN();
+	
+	// Up 4 bits and low 4 bits.
+	uint8_t un, ln;
+
+	for (uint8_t i = 0; i < CRYPTO_IN_SIZE; i++) {
+		un = s[i] >> 4;
+		ln = s[i] & 0x0F;
+
+		// Replace old byte with new byte
+		s[i] = sbox[ln] | (sbox[un] << 4);
+	}
+	
+	INSTRUMENT_END(INSTRUMENT_SBOX_LAYER);
+}
+
+/**
+ * @brief Permutate each bit of 64-bit state
+ * 
+ * For ith bit, the new index is (i / 4) + (i % 4) * 16
+ * 
+ * @param s state
+ */
+static void pbox_layer(uint8_t s[CRYPTO_IN_SIZE])
+{
+	INSTRUMENT_BEGIN();
+	
+	// Create a tmp storing permutated state
+	uint8_t tmp_s[8] = {0u};
+
+	for (uint8_t i = 0; i < 64; i++) {
+		uint8_t tmp = GETBIT(s[i / 8], i % 8);
+		uint8_t new_i = PBOX(i);
+		CPYBIT(tmp_s[new_i / 8], new_i % 8, tmp);
+	}
+
+	memcpy(s, tmp_s, CRYPTO_IN_SIZE);
+	
+	INSTRUMENT_END(INSTRUMENT_PBOX_LAYER);
+}
+
+/**
+ * @brief Replace each nibble of state with value in sbox_inv
+ * 
+ * @param s state
+ */
+static void inv_sbox_layer(uint8_t s[CRYPTO_IN_SIZE])
+{
+	INSTRUMENT_BEGIN();
+	
+	for (uint8_t i = 0; i < CRYPTO_IN_SIZE; i++) {
+		s[i] = sbox_inv[s[i] & 0x0F] | (sbox_inv[s[i] >> 4] << 4);
+	}
+	
+	INSTRUMENT_END(INSTRUMENT_SBOX_LAYER);
+}
+
+/**
+ * @brief Undo pbox_layer
+ * 
+ * For ith bit, the old index is (i % 16) * 4 + i / 16
+ * 
+ * @param s state
+ */
+static void inv_pbox_layer(uint8_t s[CRYPTO_IN_SIZE])
+{
+	INSTRUMENT_BEGIN();
+	
+	uint8_t tmp_s[8] = {0u};
+
+	for (uint8_t i = 0; i < 64; i++) {
+		uint8_t tmp = GETBIT(s[i / 8], i % 8);
+		uint8_t old_i = PBOX_INV(i);
+		CPYBIT(tmp_s[old_i / 8], old_i % 8, tmp);
+	}
+
+	memcpy(s, tmp_s, CRYPTO_IN_SIZE);
+	
+	INSTRUMENT_END(INSTRUMENT_PBOX_LAYER);
+}
+#else
+/**
+ * @brief sbox packed into one constant, nibble x is sbox[x]
+ */
+#define SBOX_PACKED 0x21748FE3DA09B65CULL
+
+/**
+ * @brief sbox lookup that is a constant expression
+ * 
+ * @param x nibble
+ * 
+ * @return sbox[x]
+ */
+#define SBOX_NIBBLE(x) ((SBOX_PACKED >> (4 * (x))) & 0x0F)
+
+/**
+ * @brief sbox_layer of one byte as a constant expression
+ * 
+ * @param v byte
+ * 
+ * @return byte with both nibbles replaced
+ */
+#define SBOX_BYTE(v) (SBOX_NIBBLE((v) & 0x0F) | (SBOX_NIBBLE((v) >> 4) << 4))
+
+// Same for sbox_inv
+#define SBOX_INV_PACKED 0xA970364BD21C8FE5ULL
+#define SBOX_INV_NIBBLE(x) ((SBOX_INV_PACKED >> (4 * (x))) & 0x0F)
+#define SBOX_INV_BYTE(v) (SBOX_INV_NIBBLE((v) & 0x0F) | (SBOX_INV_NIBBLE((v) >> 4) << 4))
+
+/**
+ * @brief Where the kth bit of byte b of the state ends up after sbox_layer and pbox_layer
+ * 
+ * @param b which byte
+ * @param v value of the byte
+ * @param k which bit
+ * 
+ * @return that bit at its new index
+ */
+#define SP_BIT(b, v, k) ((uint64_t)((SBOX_BYTE(v) >> (k)) & 0x01) << PBOX((8 * (b) + (k))))
+
+#define SP_ENTRY(b, v) (SP_BIT(b, v, 0) | SP_BIT(b, v, 1) | SP_BIT(b, v, 2) | SP_BIT(b, v, 3) | \
+                        SP_BIT(b, v, 4) | SP_BIT(b, v, 5) | SP_BIT(b, v, 6) | SP_BIT(b, v, 7))
+
+/**
+ * @brief Where the kth bit of byte b of the state ends up after inv_pbox_layer
+ * 
+ * @param b which byte
+ * @param v value of the byte
+ * @param k which bit
+ * 
+ * @return that bit at its old index
+ */
+#define IP_BIT(b, v, k) ((uint64_t)(((v) >> (k)) & 0x01) << PBOX_INV((8 * (b) + (k))))
+
+#define IP_ENTRY(b, v) (IP_BIT(b, v, 0) | IP_BIT(b, v, 1) | IP_BIT(b, v, 2) | IP_BIT(b, v, 3) | \
+                        IP_BIT(b, v, 4) | IP_BIT(b, v, 5) | IP_BIT(b, v, 6) | IP_BIT(b, v, 7))
+
+#define SBOX_INV_ENTRY(b, v) SBOX_INV_BYTE(v)
+
+/**
+ * @brief Table with 256 entries E(b, 0) to E(b, 255)
+ * 
+ * @param E macro computing one entry
+ * @param b which byte of the state
+ */
+#define TABLE_ENTRY4(E, b, v) E(b, v), E(b, (v) + 1), E(b, (v) + 2), E(b, (v) + 3)
+#define TABLE_ENTRY16(E, b, v) TABLE_ENTRY4(E, b, v), TABLE_ENTRY4(E, b, (v) + 4), TABLE_ENTRY4(E, b, (v) + 8), TABLE_ENTRY4(E, b, (v) + 12)
+#define TABLE_ENTRY64(E, b, v) TABLE_ENTRY16(E, b, v), TABLE_ENTRY16(E, b, (v) + 16), TABLE_ENTRY16(E, b, (v) + 32), TABLE_ENTRY16(E, b, (v) + 48)
+#define TABLE(E, b) { TABLE_ENTRY64(E, b, 0), TABLE_ENTRY64(E, b, 64), TABLE_ENTRY64(E, b, 128), TABLE_ENTRY64(E, b, 192) }
+
+/**
+ * @brief Combined sbox_layer and pbox_layer for each byte of the state
+ * 
+ * Both layers work on the bytes of the state independently and their results are only ORed together, so
+ * sp_table[b][v] is the contribution of byte b with value v to the new state. The tables are computed by the
+ * compiler from the macros above.
+ */
+static const uint64_t sp_table[CRYPTO_IN_SIZE][256] = {
+	TABLE(SP_ENTRY, 0), TABLE(SP_ENTRY, 1), TABLE(SP_ENTRY, 2), TABLE(SP_ENTRY, 3),
+	TABLE(SP_ENTRY, 4), TABLE(SP_ENTRY, 5), TABLE(SP_ENTRY, 6), TABLE(SP_ENTRY, 7),
+};
+
+/**
+ * @brief inv_pbox_layer for each byte of the state
+ * 
+ * The inverse S-box cannot be merged into these tables, because each of its nibbles gathers bits of 4 bytes.
+ */
+static const uint64_t ip_table[CRYPTO_IN_SIZE][256] = {
+	TABLE(IP_ENTRY, 0), TABLE(IP_ENTRY, 1), TABLE(IP_ENTRY, 2), TABLE(IP_ENTRY, 3),
+	TABLE(IP_ENTRY, 4), TABLE(IP_ENTRY, 5), TABLE(IP_ENTRY, 6), TABLE(IP_ENTRY, 7),
+};
+
+/**
+ * @brief inv_sbox_layer of one byte
+ */
+static const uint8_t sbox_inv_table[256] = TABLE(SBOX_INV_ENTRY, 0);
+
+/**
+ * @brief sbox_layer and pbox_layer of a 64-bit state with 8 table lookups
+ * 
+ * @param s state, bit i is bit i % 8 of byte i / 8
+ * 
+ * @return new state
+ */
+static uint64_t sp_layer(uint64_t s)
+{
+	INSTRUMENT_BEGIN();
+	
+	uint64_t t = sp_table[0][s & 0xFF] ^ sp_table[1][(s >> 8) & 0xFF] ^
+	             sp_table[2][(s >> 16) & 0xFF] ^ sp_table[3][(s >> 24) & 0xFF] ^
+	             sp_table[4][(s >> 32) & 0xFF] ^ sp_table[5][(s >> 40) & 0xFF] ^
+	             sp_table[6][(s >> 48) & 0xFF] ^ sp_table[7][s >> 56];
+	
+	INSTRUMENT_END(INSTRUMENT_SBOX_LAYER);
+	
+	return t;
+}
+
+/**
+ * @brief inv_pbox_layer and inv_sbox_layer of a 64-bit state with 16 table lookups
+ * 
+ * @param s state
+ * 
+ * @return old state
+ */
+static uint64_t inv_sp_layer(uint64_t s)
+{
+	INSTRUMENT_BEGIN();
+	
+	uint64_t t = ip_table[0][s & 0xFF] ^ ip_table[1][(s >> 8) & 0xFF] ^
+	             ip_table[2][(s >> 16) & 0xFF] ^ ip_table[3][(s >> 24) & 0xFF] ^
+	             ip_table[4][(s >> 32) & 0xFF] ^ ip_table[5][(s >> 40) & 0xFF] ^
+	             ip_table[6][(s >> 48) & 0xFF] ^ ip_table[7][s >> 56];
+
+	t = (uint64_t)sbox_inv_table[t & 0xFF] | (uint64_t)sbox_inv_table[(t >> 8) & 0xFF] << 8 |
+	    (uint64_t)sbox_inv_table[(t >> 16) & 0xFF] << 16 | (uint64_t)sbox_inv_table[(t >> 24) & 0xFF] << 24 |
+	    (uint64_t)sbox_inv_table[(t >> 32) & 0xFF] << 32 | (uint64_t)sbox_inv_table[(t >> 40) & 0xFF] << 40 |
+	    (uint64_t)sbox_inv_table[(t >> 48) & 0xFF] << 48 | (uint64_t)sbox_inv_table[t >> 56] << 56;
+	
+	INSTRUMENT_END(INSTRUMENT_SBOX_LAYER);
+	
+	return t;
+}
+#endif
+
+/**
+ * @brief Key register in native words.
+ * 
+ * The round key is the leftmost 64 bits, which are always hi. lo has the remaining 16 bits of an 80-bit key
+ * or 64 bits of a 128-bit key, so each step of the key schedule is a few shifts instead of one per byte.
+ */
+typedef struct
+{
+	uint64_t hi;
+	uint64_t lo;
+} key_reg_t;
+
+/**
+ * @brief Load a key register from bytes, little endian like the state.
+ * 
+ * @param k Output: key register
+ * @param key key bytes
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ */
+static void load_key(key_reg_t *k, const uint8_t *key, uint8_t key_size)
+{
+	k->lo = 0;
+	memcpy(&k->lo, key, key_size - CRYPTO_IN_SIZE);
+	memcpy(&k->hi, key + key_size - CRYPTO_IN_SIZE, CRYPTO_IN_SIZE);
+}
+
+/**
+ * @brief Store a key register as bytes, the inverse of load_key.
+ * 
+ * @param k key register
+ * @param key Output: key bytes
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ */
+static void store_key(const key_reg_t *k, uint8_t *key, uint8_t key_size)
+{
+	memcpy(key, &k->lo, key_size - CRYPTO_IN_SIZE);
+	memcpy(key + key_size - CRYPTO_IN_SIZE, &k->hi, CRYPTO_IN_SIZE);
+}
+
+/**
+ * @brief S-box on the most significant nibbles of the key register.
+ * 
+ * With OPTIMIZATION_NIBBLE_SLICE it uses sbox_planes with one bit per nibble in each plane, so the key never indexes a
+ * table either.
+ * 
+ * @param hi leftmost 64 bits of the key register
+ * @param nibbles 1 for an 80-bit key, 2 for a 128-bit key
+ * 
+ * @return hi with the nibbles replaced
+ */
+static uint64_t key_sbox(uint64_t hi, uint8_t nibbles)
+{
+#ifdef OPTIMIZATION_NIBBLE_SLICE
+	// Lowest bit of the nibbles, and one bit per nibble in a plane
+	uint8_t low = 64 - 4 * nibbles;
+	uint64_t m = nibbles == 2 ? 0x11 : 0x01;
+	uint64_t x0 = hi >> low, x1 = hi >> (low + 1), x2 = hi >> (low + 2), x3 = hi >> (low + 3);
+	
+	sbox_planes(&x0, &x1, &x2, &x3);
+	
+	return (hi & (((uint64_t)1 << low) - 1)) | (x0 & m) << low | (x1 & m) << (low + 1) | (x2 & m) << (low + 2) | (x3 & m) << (low + 3);
+#else
+	if (nibbles == 2)
+	{
+		return (hi & 0x00FFFFFFFFFFFFFFULL) | (uint64_t)sbox[hi >> 60] << 60 | (uint64_t)sbox[(hi >> 56) & 0xF] << 56;
+	}
+	
+	return (hi & 0x0FFFFFFFFFFFFFFFULL) | (uint64_t)sbox[hi >> 60] << 60;
+#endif
+}
+
+/**
+ * @brief Undo key_sbox.
+ * 
+ * @param hi leftmost 64 bits of the key register
+ * @param nibbles 1 for an 80-bit key, 2 for a 128-bit key
+ * 
+ * @return hi with the nibbles replaced
+ */
+static uint64_t inv_key_sbox(uint64_t hi, uint8_t nibbles)
+{
+#ifdef OPTIMIZATION_NIBBLE_SLICE
+	uint8_t low = 64 - 4 * nibbles;
+	uint64_t m = nibbles == 2 ? 0x11 : 0x01;
+	uint64_t x0 = hi >> low, x1 = hi >> (low + 1), x2 = hi >> (low + 2), x3 = hi >> (low + 3);
+	
+	inv_sbox_planes(&x0, &x1, &x2, &x3);
+	
+	return (hi & (((uint64_t)1 << low) - 1)) | (x0 & m) << low | (x1 & m) << (low + 1) | (x2 & m) << (low + 2) | (x3 & m) << (low + 3);
+#else
+	if (nibbles == 2)
+	{
+		return (hi & 0x00FFFFFFFFFFFFFFULL) | (uint64_t)sbox_inv[hi >> 60] << 60 | (uint64_t)sbox_inv[(hi >> 56) & 0xF] << 56;
+	}
+	
+	return (hi & 0x0FFFFFFFFFFFFFFFULL) | (uint64_t)sbox_inv[hi >> 60] << 60;
+#endif
+}
+
+/**
+ * @brief Perform next key schedule step.
+ * 
+ * @param k Key register to be updated
+ * @param r Round counter
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ */
+static void update_round_key(key_reg_t *k, const uint8_t r, uint8_t key_size)
+{
+	INSTRUMENT_BEGIN();
+	
+	const uint64_t hi = k->hi;
+	const uint64_t lo = k->lo;
+	
+	if(key_size == CRYPTO_KEY_SIZE_128)
+	{
+		// rotate left by 61 bit
+		k->hi = lo >> 3 | hi << 61;
+		k->lo = hi >> 3 | lo << 61;
+		
+		// perform sbox lookup on the two nibbles of MSbits
+		k->hi = key_sbox(k->hi, 2);
+		
+		// XOR round counter k66 ... k62
+		k->lo ^= (uint64_t)r << 62;
+		k->hi ^= r >> 2;
+	}
+	else
+	{
+		// rotate right by 19 bit, lo is the low 16 bits
+		k->hi = hi >> 19 | lo << 45 | hi << 61;
+		k->lo = (uint16_t)(hi >> 3);
+		
+		// perform sbox lookup on MSbits
+		k->hi = key_sbox(k->hi, 1);
+		
+		// XOR round counter k19 ... k15
+		k->lo ^= (uint16_t)(r << 15);
+		k->hi ^= r >> 1;
+	}
+	
+	INSTRUMENT_END(INSTRUMENT_UPDATE_ROUND_KEY);
+}
+
+/**
+ * @brief Undo update_round_key
+ * 
+ * @param k Key register to be updated
+ * @param r Round counter that was passed to update_round_key
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ */
+static void inv_update_round_key(key_reg_t *k, const uint8_t r, uint8_t key_size)
+{
+	INSTRUMENT_BEGIN();
+	
+	if(key_size == CRYPTO_KEY_SIZE_128)
+	{
+		// XOR round counter k66 ... k62
+		k->lo ^= (uint64_t)r << 62;
+		k->hi ^= r >> 2;
+		
+		// perform sbox_inv lookup on the two nibbles of MSbits
+		k->hi = inv_key_sbox(k->hi, 2);
+		
+		const uint64_t hi = k->hi;
+		const uint64_t lo = k->lo;
+		
+		// rotate right by 61 bit
+		k->hi = hi >> 61 | lo << 3;
+		k->lo = lo >> 61 | hi << 3;
+	}
+	else
+	{
+		// XOR round counter k19 ... k15
+		k->lo ^= (uint16_t)(r << 15);
+		k->hi ^= r >> 1;
+		
+		// perform sbox_inv lookup on MSbits
+		k->hi = inv_key_sbox(k->hi, 1);
+		
+		const uint64_t hi = k->hi;
+		const uint64_t lo = k->lo;
+		
+		// rotate left by 19 bit
+		k->hi = hi << 19 | lo << 3 | hi >> 61;
+		k->lo = (uint16_t)(hi >> 45);
+	}
+	
+	INSTRUMENT_END(INSTRUMENT_UPDATE_ROUND_KEY);
+}
+
+/**
+ * @brief Run the key schedule forward once, see crypto_decryption_key.
+ * 
+ * @param key Input: key, Output: key register after the last round
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ */
+static void decryption_key(uint8_t *key, uint8_t key_size)
+{
+	key_reg_t k;
+	
+	load_key(&k, key, key_size);
+	
+	for(uint8_t i = 1; i <= 31; i++)
+	{
+		update_round_key(&k, i, key_size);
+	}
+	
+	store_key(&k, key, key_size);
+}
+
+/**
+ * @brief Decrypt one block in place, see crypto_func_decrypt.
+ * 
+ * @param ct Input: ciphertext, Output: plaintext
+ * @param key Input: result of decryption_key, Output: key
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ */
+static void decrypt(uint8_t ct[CRYPTO_IN_SIZE], uint8_t *key, uint8_t key_size)
+{
+	uint8_t i = 0;
+	key_reg_t k;
+	
+	load_key(&k, key, key_size);
+	
+#if defined(OPTIMIZATION_NIBBLE_SLICE) || defined(OPTIMIZATION_SP_TABLE)
+	uint64_t s;
+	
+	memcpy(&s, ct, CRYPTO_IN_SIZE);
+	
+	for(i = 31; i >= 1; i--)
+	{
+#ifdef OPTIMIZATION_NIBBLE_SLICE
+		s = inv_nibble_sp_layer(s ^ k.hi);
+#else
+		s = inv_sp_layer(s ^ k.hi);
+#endif
+		inv_update_round_key(&k, i, key_size);
+	}
+	
+	s ^= k.hi;
+	
+	memcpy(ct, &s, CRYPTO_IN_SIZE);
+#else
+	for(i = 31; i >= 1; i--)
+	{
+		add_round_key(ct, (uint8_t *)&k.hi);
+		inv_pbox_layer(ct);
+		inv_sbox_layer(ct);
+		inv_update_round_key(&k, i, key_size);
+	}
+	
+	add_round_key(ct, (uint8_t *)&k.hi);
+#endif
+	
+	store_key(&k, key, key_size);
+}
+
+/**
+ * @brief Encrypt one block in place, see crypto_func.
+ * 
+ * @param pt Input: plaintext, Output: ciphertext
+ * @param key Input: key, Output: key register after the last round
+ * @param key_size CRYPTO_KEY_SIZE or CRYPTO_KEY_SIZE_128
+ */
+static void encrypt(uint8_t pt[CRYPTO_IN_SIZE], uint8_t *key, uint8_t key_size)
+{
+	uint8_t i = 0;
+	key_reg_t k;
+	
+	load_key(&k, key, key_size);
+	
+#if defined(OPTIMIZATION_NIBBLE_SLICE) || defined(OPTIMIZATION_SP_TABLE)
+	// The state as one word, little endian like the bit numbering of GETBIT.
+	uint64_t s;
+	
+	memcpy(&s, pt, CRYPTO_IN_SIZE);
+	
+	for(i = 1; i <= 31; i++)
+	{
+#ifdef OPTIMIZATION_NIBBLE_SLICE
+		s = nibble_sp_layer(s ^ k.hi);
+#else
+		s = sp_layer(s ^ k.hi);
+#endif
+		update_round_key(&k, i, key_size);
+	}
+	
+	s ^= k.hi;
+	
+	memcpy(pt, &s, CRYPTO_IN_SIZE);
+#else
+	for(i = 1; i <= 31; i++)
+	{
+		add_round_key(pt, (uint8_t *)&k.hi);
+		sbox_layer(pt);
+		pbox_layer(pt);
+		update_round_key(&k, i, key_size);
+	}
+	
+	add_round_key(pt, (uint8_t *)&k.hi);
+#endif
+	
+	store_key(&k, key, key_size);
+}
+
+void crypto_decryption_key(uint8_t key[CRYPTO_KEY_SIZE])
+{
+	decryption_key(key, CRYPTO_KEY_SIZE);
+}
+
+void crypto_decryption_key_128(uint8_t key[CRYPTO_KEY_SIZE_128])
+{
+	decryption_key(key, CRYPTO_KEY_SIZE_128);
+}
+
+void crypto_func_decrypt(uint8_t ct[CRYPTO_IN_SIZE], uint8_t key[CRYPTO_KEY_SIZE])
+{
+	decrypt(ct, key, CRYPTO_KEY_SIZE);
+}
+
+void crypto_func_decrypt_128(uint8_t ct[CRYPTO_IN_SIZE], uint8_t key[CRYPTO_KEY_SIZE_128])
+{
+	decrypt(ct, key, CRYPTO_KEY_SIZE_128);
+}
+
+void crypto_func(uint8_t pt[CRYPTO_IN_SIZE], uint8_t key[CRYPTO_KEY_SIZE])
+{
+	encrypt(pt, key, CRYPTO_KEY_SIZE);
+}
+
+void crypto_func_128(uint8_t pt[CRYPTO_IN_SIZE], uint8_t key[CRYPTO_KEY_SIZE_128])
+{
+	encrypt(pt, key, CRYPTO_KEY_SIZE_128);
+}
@@ -1,15 +1,57 @@
-#ifndef __CRYPTO_H
-#define __CRYPTO_H
-
-#include <stdint.h>
-#include <string.h>
-
-// Define basic parameters
-#define CRYPTO_IN_SIZE  8 	// Present has 64-bit blocks
-#define CRYPTO_KEY_SIZE 10  // Present has 80-bit key
-#define CRYPTO_OUT_SIZE 8   // Present has 64-bit blocks
-
-// The function to test
-void crypto_func(uint8_t pt[CRYPTO_IN_SIZE], uint8_t key[CRYPTO_KEY_SIZE]);
-
+#ifndef __CRYPTO_H
+#define __CRYPTO_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Define basic parameters
+#define CRYPTO_IN_SIZE  8 	// Present has 64-bit blocks
+#define CRYPTO_KEY_SIZE 10  // Present has 80-bit key
+#define CRYPTO_KEY_SIZE_128 16  // or a 128-bit key with PRESENT-128
+#define CRYPTO_OUT_SIZE 8   // Present has 64-bit blocks
+
+// The function to test
+void crypto_func(uint8_t pt[CRYPTO_IN_SIZE], uint8_t key[CRYPTO_KEY_SIZE]);
+
+/**
+ * @brief Run the key schedule forward once, which turns a key into the key register decryption starts from.
+ * 
+ * @param key Input: key, Output: key register after the last round
+ */
+void crypto_decryption_key(uint8_t key[CRYPTO_KEY_SIZE]);
+
+/**
+ * @brief Decrypt one block in place.
+ * 
+ * The round keys are derived backwards from the key register after the last round, so the forward key schedule
+ * does not run for each block. Like crypto_func updates the key register in place, this one leaves the original key in it.
+ * 
+ * @param ct Input: ciphertext, Output: plaintext
+ * @param key Input: result of crypto_decryption_key, Output: key
+ */
+void crypto_func_decrypt(uint8_t ct[CRYPTO_IN_SIZE], uint8_t key[CRYPTO_KEY_SIZE]);
+
+/**
+ * @brief crypto_func with the 128-bit key schedule of PRESENT-128. The rounds are the same.
+ * 
+ * @param pt Input: plaintext, Output: ciphertext
+ * @param key Input: key, Output: key register after the last round
+ */
+void crypto_func_128(uint8_t pt[CRYPTO_IN_SIZE], uint8_t key[CRYPTO_KEY_SIZE_128]);
+
+/**
+ * @brief crypto_decryption_key for PRESENT-128.
+ * 
+ * @param key Input: key, Output: key register after the last round
+ */
+void crypto_decryption_key_128(uint8_t key[CRYPTO_KEY_SIZE_128]);
+
+/**
+ * @brief crypto_func_decrypt for PRESENT-128.
+ * 
+ * @param ct Input: ciphertext, Output: plaintext
+ * @param key Input: result of crypto_decryption_key_128, Output: key
+ */
+void crypto_func_decrypt_128(uint8_t ct[CRYPTO_IN_SIZE], uint8_t key[CRYPTO_KEY_SIZE_128]);
+
 #endif
\ No newline at end of file
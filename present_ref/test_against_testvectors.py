@@ -1,95 +1,178 @@
-#!/usr/bin/python
-import serial
-import time
-import sys
-
-BLOCK_SIZE = 8
-KEY_SIZE = 10
-CPU_FREQUENCY = 125e6
-
-BAUDRATE = 9600
-
-if len(sys.argv) != 2:
-    sys.exit("Usage: python3 ./test_against_testvectors.py [COMPORT, e.g. /dev/ttySX on WSL]")
-
-COM_PORT = sys.argv[1]
-
-ser = serial.Serial(COM_PORT, BAUDRATE, timeout=1)
-
-tv_pt = [
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	
-    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,	
-    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,	
-    0x45, 0x84, 0x22, 0x7B, 0x38, 0xC1, 0x79, 0x55,
-]
-
-tv_key = [
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	
-    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	
-    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-    0x3c, 0xf4, 0x00, 0xd8, 0x28, 0xf1, 0x08, 0x7a, 0x60, 0x26,
-]
-
-tv_ct = [
-    0x45, 0x84, 0x22, 0x7B, 0x38, 0xC1, 0x79, 0x55,
-    0x49, 0x50, 0x94, 0xF5, 0xC0, 0x46, 0x2C, 0xE7,
-    0x7B, 0x41, 0x68, 0x2F, 0xC7, 0xFF, 0x12, 0xA1,
-    0xD2, 0x10, 0x32, 0x21, 0xD3, 0xDC, 0x33, 0x33,
-    0xd0, 0x44, 0x6a, 0x0a, 0xc9, 0x13, 0x35, 0xd4,
-]
-
-TV_COUNT = int(len(tv_pt) / BLOCK_SIZE)
-
-def unpack_le(s):
-    return sum((s[i]) << (8 * i) for i in range(len(s)))
-
-debug = False
-
-print("[+] Using com port " + COM_PORT)
-
-for tv in range(TV_COUNT):
-    
-    print("== Testvector " + str(tv))
-    
-    # Initial command
-    buf = str.encode("e")
-    
-    # Assemble key and plaintext
-    buf += bytes(tv_key[tv*KEY_SIZE:(tv+1)*KEY_SIZE])
-    buf += bytes(tv_pt[tv*BLOCK_SIZE:(tv+1)*BLOCK_SIZE])
-   
-    if debug:
-        print("[i] TX: " + buf.hex())
-
-    # Do operation
-    ser.write(buf)
-
-    # Get answer
-    rx = ser.read(8 + BLOCK_SIZE)
-
-    # duration in CPU cycles and seconds
-    duration = unpack_le(rx[BLOCK_SIZE:])
-
-    if debug:
-        print("[i] RX: " + rx.hex())
-    
-    print("[+] Cycle count = " + str(duration) + " = " + str(duration/CPU_FREQUENCY) + " s")
-    
-    # Check result
-    r_ref = bytes(tv_ct[tv*BLOCK_SIZE:(tv+1)*BLOCK_SIZE])
-    r_comp = rx[:BLOCK_SIZE]
-    
-    if r_ref == r_comp:
-        print("[OK] Result correct: " + ''.join('{:02x} '.format((x)) for x in r_comp).upper())
-    else:
-        print ("[FAILED]")
-        print ("Got  : " + ''.join('{:02x} '.format((x)) for x in r_comp).upper())
-        print ("Exp't: " + ''.join('{:02x} '.format((x)) for x in r_ref).upper())
-     
-    print()
-	
-    time.sleep(0.1)
-
-ser.close()
+#!/usr/bin/python
+import serial
+import time
+import sys
+
+BLOCK_SIZE = 8
+KEY_SIZE = 10
+CPU_FREQUENCY = 125e6
+
+BAUDRATE = 9600
+
+if len(sys.argv) != 2:
+    sys.exit("Usage: python3 ./test_against_testvectors.py [COMPORT, e.g. /dev/ttySX on WSL]")
+
+COM_PORT = sys.argv[1]
+
+ser = serial.Serial(COM_PORT, BAUDRATE, timeout=1)
+
+tv_pt = [
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,	
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,	
+    0x45, 0x84, 0x22, 0x7B, 0x38, 0xC1, 0x79, 0x55,
+]
+
+tv_key = [
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x3c, 0xf4, 0x00, 0xd8, 0x28, 0xf1, 0x08, 0x7a, 0x60, 0x26,
+]
+
+tv_ct = [
+    0x45, 0x84, 0x22, 0x7B, 0x38, 0xC1, 0x79, 0x55,
+    0x49, 0x50, 0x94, 0xF5, 0xC0, 0x46, 0x2C, 0xE7,
+    0x7B, 0x41, 0x68, 0x2F, 0xC7, 0xFF, 0x12, 0xA1,
+    0xD2, 0x10, 0x32, 0x21, 0xD3, 0xDC, 0x33, 0x33,
+    0xd0, 0x44, 0x6a, 0x0a, 0xc9, 0x13, 0x35, 0xd4,
+]
+
+# PRESENT-128: 3 keys
+tv_key_128 = [
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xef, 0xcd, 0xab, 0x89, 0x67, 0x45, 0x23, 0x01, 0xef, 0xcd, 0xab, 0x89, 0x67, 0x45, 0x23, 0x01,
+]
+
+# PRESENT-128: 3 pt
+tv_pt_128 = [
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xef, 0xcd, 0xab, 0x89, 0x67, 0x45, 0x23, 0x01,
+]
+
+# PRESENT-128: 9 ct, tv_ct_128[key][pt]
+tv_ct_128 = [
+    0xaf, 0x00, 0x69, 0x2e, 0x2a, 0x70, 0xdb, 0x96,
+    0x63, 0xd5, 0xed, 0xe5, 0xe5, 0x19, 0x60, 0x3c,
+    0xe4, 0x0c, 0x00, 0x5b, 0x67, 0xd8, 0x60, 0x35,
+    0xd8, 0xa5, 0x72, 0x02, 0x71, 0x8c, 0x23, 0x13,
+    0xb4, 0xe5, 0x18, 0x42, 0xbd, 0x9f, 0x8d, 0x62,
+    0x13, 0xb8, 0xe2, 0xd3, 0x5b, 0x9f, 0x3e, 0x75,
+    0xe9, 0x1e, 0xdc, 0x37, 0xa9, 0xbc, 0xdb, 0x6f,
+    0x13, 0x21, 0x40, 0xea, 0x55, 0x9f, 0x77, 0x21,
+    0xd6, 0x1d, 0x67, 0x5e, 0x68, 0x28, 0x9d, 0x0e,
+]
+
+KEY_SIZE_128 = 16
+
+TV_COUNT = int(len(tv_pt) / BLOCK_SIZE)
+
+def unpack_le(s):
+    return sum((s[i]) << (8 * i) for i in range(len(s)))
+
+debug = False
+
+print("[+] Using com port " + COM_PORT)
+
+# Encrypt the plaintexts, then decrypt the ciphertexts back
+for cmd, tv_in, tv_out in (("e", tv_pt, tv_ct), ("d", tv_ct, tv_pt)):
+    for tv in range(TV_COUNT):
+    
+        print("== Testvector " + str(tv) + (" (decryption)" if cmd == "d" else ""))
+    
+        # Initial command
+        buf = str.encode(cmd)
+    
+        # Assemble key and input
+        buf += bytes(tv_key[tv*KEY_SIZE:(tv+1)*KEY_SIZE])
+        buf += bytes(tv_in[tv*BLOCK_SIZE:(tv+1)*BLOCK_SIZE])
+   
+        if debug:
+            print("[i] TX: " + buf.hex())
+
+        # Do operation
+        ser.write(buf)
+
+        # Get answer
+        rx = ser.read(8 + BLOCK_SIZE)
+
+        # duration in CPU cycles and seconds
+        duration = unpack_le(rx[BLOCK_SIZE:])
+
+        if debug:
+            print("[i] RX: " + rx.hex())
+    
+        print("[+] Cycle count = " + str(duration) + " = " + str(duration/CPU_FREQUENCY) + " s")
+    
+        # Check result
+        r_ref = bytes(tv_out[tv*BLOCK_SIZE:(tv+1)*BLOCK_SIZE])
+        r_comp = rx[:BLOCK_SIZE]
+    
+        if r_ref == r_comp:
+            print("[OK] Result correct: " + ''.join('{:02x} '.format((x)) for x in r_comp).upper())
+        else:
+            print ("[FAILED]")
+            print ("Got  : " + ''.join('{:02x} '.format((x)) for x in r_comp).upper())
+            print ("Exp't: " + ''.join('{:02x} '.format((x)) for x in r_ref).upper())
+     
+        print()
+	
+        time.sleep(0.1)
+
+# PRESENT-128: select the key size with 'K', which answers with the key size in effect
+ser.write(str.encode("K") + bytes([KEY_SIZE_128]))
+if ser.read(1) != bytes([KEY_SIZE_128]):
+    sys.exit("[FAILED] PRESENT-128 not selected")
+
+for cmd in ("e", "d"):
+    for k in range(3):
+        for p in range(3):
+            print("== PRESENT-128, key " + str(k) + ", pt " + str(p) + (" (decryption)" if cmd == "d" else ""))
+
+            ct = bytes(tv_ct_128[(k*3 + p)*BLOCK_SIZE:(k*3 + p + 1)*BLOCK_SIZE])
+            pt = bytes(tv_pt_128[p*BLOCK_SIZE:(p+1)*BLOCK_SIZE])
+
+            ser.write(str.encode(cmd) + bytes(tv_key_128[k*KEY_SIZE_128:(k+1)*KEY_SIZE_128]) + (pt if cmd == "e" else ct))
+
+            rx = ser.read(8 + BLOCK_SIZE)
+
+            duration = unpack_le(rx[BLOCK_SIZE:])
+            print("[+] Cycle count = " + str(duration) + " = " + str(duration/CPU_FREQUENCY) + " s")
+
+            r_ref = ct if cmd == "e" else pt
+            r_comp = rx[:BLOCK_SIZE]
+
+            if r_ref == r_comp:
+                print("[OK] Result correct: " + ''.join('{:02x} '.format((x)) for x in r_comp).upper())
+            else:
+                print ("[FAILED]")
+                print ("Got  : " + ''.join('{:02x} '.format((x)) for x in r_comp).upper())
+                print ("Exp't: " + ''.join('{:02x} '.format((x)) for x in r_ref).upper())
+
+            print()
+
+# Back to PRESENT-80
+ser.write(str.encode("K") + bytes([KEY_SIZE]))
+ser.read(1)
+
+# Cycles per stage since the start, only with firmware built with PRESENT_INSTRUMENT
+INSTRUMENT_STAGES = ["enslice", "add_round_key", "sbox_layer", "pbox_layer", "update_round_key", "barrier", "unslice"]
+
+ser.write(str.encode("I"))
+stages = ser.read(1)[0]
+
+if stages != 0:
+    print("== Cycles per stage")
+    print("{:16} {:>10} {:>12} {:>8} {:>8} {:>8} {:>8}".format("stage", "count", "total", "min", "median", "p99", "max"))
+
+for s in range(stages):
+    rx = ser.read(6 * 8)
+    fields = [unpack_le(rx[i*8:(i+1)*8]) for i in range(6)]
+    name = INSTRUMENT_STAGES[s] if s < len(INSTRUMENT_STAGES) else str(s)
+    print("{:16} {:>10} {:>12} {:>8} {:>8} {:>8} {:>8}".format(name, *fields))
+
+ser.close()